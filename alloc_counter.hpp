@@ -0,0 +1,30 @@
+#ifndef ALLOC_COUNTER_HPP
+#define ALLOC_COUNTER_HPP
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+// テストプログラム専用: グローバルなoperator newを置き換え、ヒープ確保の回数を数える
+// 1つのプログラムにつき1つの翻訳単位からのみincludeすること
+
+inline std::atomic<std::size_t> allocation_count{0};
+
+void *operator new(std::size_t size) {
+  allocation_count.fetch_add(1, std::memory_order_relaxed);
+  if (void *p = std::malloc(size == 0 ? 1 : size)) {
+    return p;
+  }
+  throw std::bad_alloc();
+}
+
+// mallocとの対応をコンパイラに誤検知されないよう、インライン展開させない
+__attribute__((noinline)) void operator delete(void *p) noexcept {
+  std::free(p);
+}
+
+__attribute__((noinline)) void operator delete(void *p, std::size_t) noexcept {
+  std::free(p);
+}
+
+#endif
@@ -0,0 +1,126 @@
+/**
+ * @brief SHA1, SHA256, SHA512の速度を計測し、CSVまたはJSONで出力する
+ * @note  使い方: bench [-a 1|256|512] [-m MAXSIZE] [-t SECONDS] [-f csv|json]
+ *                      [-c BASELINE.csv] [-r PERCENT] [-k ITERATIONS]
+ *        -aを省略すると全てのアルゴリズムを、メッセージ長は0 BからMAXSIZE
+ *        (既定は1 GiB)までを、使用可能な全てのバックエンドで計測する
+ *        -a 256, -a 512ではPBKDF2-HMAC-SHA256/SHA512も、反復回数ITERATIONS
+ *        (既定は1000)で計測する
+ *        -cを指定すると、1回の呼び出しがベースラインよりPERCENT%(既定は10%)
+ *        を超えて遅くなった計測を標準エラー出力に表示し、終了コード1を返す
+ */
+
+#include "bench.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+
+namespace {
+
+int usage(const char *prog) {
+  std::fprintf(stderr,
+               "usage: %s [-a 1|256|512] [-m MAXSIZE] [-t SECONDS] "
+               "[-f csv|json] [-c BASELINE.csv] [-r PERCENT] "
+               "[-k ITERATIONS]\n",
+               prog);
+  return 2;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  int bits = 0;
+  BenchConfig config;
+  bool json = false;
+  const char *baseline = nullptr;
+  double threshold = 0.1;
+  int i = 1;
+  for (; i + 1 < argc && argv[i][0] == '-'; i += 2) {
+    if (std::strcmp(argv[i], "-a") == 0) {
+      bits = std::atoi(argv[i + 1]);
+    } else if (std::strcmp(argv[i], "-m") == 0) {
+      config.max_size = std::strtoull(argv[i + 1], nullptr, 0);
+    } else if (std::strcmp(argv[i], "-t") == 0) {
+      config.min_time = std::atof(argv[i + 1]);
+    } else if (std::strcmp(argv[i], "-f") == 0) {
+      if (std::strcmp(argv[i + 1], "json") == 0) {
+        json = true;
+      } else if (std::strcmp(argv[i + 1], "csv") != 0) {
+        return usage(argv[0]);
+      }
+    } else if (std::strcmp(argv[i], "-c") == 0) {
+      baseline = argv[i + 1];
+    } else if (std::strcmp(argv[i], "-r") == 0) {
+      threshold = std::atof(argv[i + 1]) / 100;
+    } else if (std::strcmp(argv[i], "-k") == 0) {
+      config.kdf_iterations =
+          static_cast<std::uint32_t>(std::strtoul(argv[i + 1], nullptr, 0));
+    } else {
+      return usage(argv[0]);
+    }
+  }
+  if (i != argc || (bits != 0 && bits != 1 && bits != 256 && bits != 512)) {
+    return usage(argv[0]);
+  }
+
+  std::vector<BenchResult> base;
+  if (baseline != nullptr) {
+    std::ifstream in(baseline);
+    if (!in) {
+      std::fprintf(stderr, "%s: cannot open %s\n", argv[0], baseline);
+      return EXIT_FAILURE;
+    }
+    base = parse_csv(in);
+  }
+
+  std::vector<std::uint8_t> data(config.max_size);
+  for (std::size_t k = 0; k < data.size(); k++) {
+    data[k] = static_cast<std::uint8_t>(k * 131 + 7);
+  }
+
+  std::vector<BenchResult> results;
+  auto run = [&](auto &&r) {
+    results.insert(results.end(), r.begin(), r.end());
+  };
+  if (bits == 0 || bits == 1) {
+    run(bench_algorithm<SHA1>("sha1", data.data(), config));
+  }
+  if (bits == 0 || bits == 256) {
+    run(bench_algorithm<SHA256>("sha256", data.data(), config));
+    run(bench_pbkdf2<SHA256>("pbkdf2-sha256", config));
+  }
+  if (bits == 0 || bits == 512) {
+    run(bench_algorithm<SHA512>("sha512", data.data(), config));
+    run(bench_pbkdf2<SHA512>("pbkdf2-sha512", config));
+  }
+
+  if (json) {
+    std::printf("[\n");
+    for (std::size_t k = 0; k < results.size(); k++) {
+      std::printf("  %s%s\n", format_json(results[k]).c_str(),
+                  k + 1 < results.size() ? "," : "");
+    }
+    std::printf("]\n");
+  } else {
+    std::printf("%s\n", bench_csv_header);
+    for (auto &&r : results) {
+      std::printf("%s\n", format_csv(r).c_str());
+    }
+  }
+
+  if (baseline == nullptr) {
+    return EXIT_SUCCESS;
+  }
+  const auto regressions = compare_results(base, results, threshold);
+  for (auto &&x : regressions) {
+    std::fprintf(stderr,
+                 "REGRESSION %s %s %s %llu: %.1f ns -> %.1f ns (+%.1f%%)\n",
+                 x.current.algorithm.c_str(), x.current.api.c_str(),
+                 x.current.backend.c_str(),
+                 static_cast<unsigned long long>(x.current.size),
+                 x.baseline.ns_per_call(), x.current.ns_per_call(),
+                 x.slowdown() * 100);
+  }
+  return regressions.empty() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
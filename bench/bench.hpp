@@ -0,0 +1,446 @@
+/**
+ * @brief SHA1, SHA256, SHA512の速度をアルゴリズム、API、バックエンド、
+ *        メッセージ長ごとに計測する
+ *        PBKDF2-HMAC-SHA256/SHA512は、1秒あたりの反復回数を計測する
+ * @note  1件の計測は、経過時間がmin_timeを超えるまで回数を倍々に増やして行う
+ *        サイクル数はTSC(x86のrdtsc)で数える。TSCは定格周波数で進むので、
+ *        ターボブーストが効く環境ではコアのサイクル数と一致しない
+ * @note  batch(hash_many())は、1回の呼び出しで処理するbyte数がbatch_bytesを
+ *        超えないよう、メッセージ長が大きいほどメッセージの数を減らす
+ *        (batch_bytesより長いメッセージは計測しない)
+ *        SHA1はhash_many()を持たないので、batchの行はない
+ * @note  スカラーの圧縮関数は、ラウンドごとの関数(round<t>など)が全て
+ *        インライン展開されていることを前提とする
+ *        (呼び出しが残ると変数がメモリを経由し、数十%遅くなる)
+ *        make check-inlineで、benchに呼び出しが残っていないことを確かめる
+ */
+
+#ifndef BENCH_HPP
+#define BENCH_HPP
+
+#include "../pbkdf2.hpp"
+#include "../sha1/sha1.hpp"
+#include "../sha256/sha256.hpp"
+#include "../sha512/sha512.hpp"
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <istream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief 1件の計測結果
+ */
+struct BenchResult {
+  std::string algorithm;   // sha1, sha256, sha512, pbkdf2-sha256, ...
+  std::string api;         // oneshot, stream, batch, derive, derive_many
+  std::string backend;     // backend_name()
+  std::uint64_t size = 0;  // 1メッセージのbyte数(pbkdf2はパスワードの数)
+  std::uint64_t bytes = 0; // 1回の呼び出しで処理するbyte数
+  std::uint64_t iterations = 0;
+  double seconds = 0;
+  double cycles = 0;
+  std::uint64_t kdf_iterations = 0; // 1回の呼び出しのPBKDF2の反復回数の合計
+
+  /**
+   * @brief  スループット(GB/s, 1GB = 10^9 byte)
+   */
+  double gbps() const {
+    return seconds > 0 ? bytes * iterations / seconds / 1e9 : 0;
+  }
+
+  /**
+   * @brief  1byteあたりのサイクル数(メッセージ長が0なら0)
+   */
+  double cycles_per_byte() const {
+    return bytes > 0 ? cycles / (bytes * iterations) : 0;
+  }
+
+  /**
+   * @brief  1秒あたりのPBKDF2の反復回数(全てのパスワードの合計)
+   */
+  double kdf_iterations_per_second() const {
+    return seconds > 0 ? kdf_iterations * iterations / seconds : 0;
+  }
+
+  /**
+   * @brief  1回の呼び出しにかかった時間(ns)。回帰の判定に使う
+   */
+  double ns_per_call() const {
+    return iterations > 0 ? seconds * 1e9 / iterations : 0;
+  }
+
+  /**
+   * @brief  ベースラインと突き合わせるためのキー
+   */
+  std::tuple<std::string, std::string, std::string, std::uint64_t>
+  key() const {
+    return {algorithm, api, backend, size};
+  }
+};
+
+/**
+ * @brief 計測の設定
+ */
+struct BenchConfig {
+  /**< @brief 計測するメッセージ長の上限(byte) */
+  std::uint64_t max_size = std::uint64_t(1) << 30;
+
+  /**< @brief 1件あたりの最短の計測時間(秒) */
+  double min_time = 0.1;
+
+  /**< @brief streamで1回のupdate()に渡すbyte数(ブロック境界に揃えない) */
+  std::size_t stream_chunk = 1000;
+
+  /**< @brief batchで1回のhash_many()に渡すメッセージの数(の上限) */
+  std::size_t batch_count = 64;
+
+  /**< @brief batchで1回のhash_many()に渡すbyte数の上限 */
+  std::uint64_t batch_bytes = std::uint64_t(256) << 20;
+
+  /**< @brief PBKDF2の反復回数(1つのパスワードあたり) */
+  std::uint32_t kdf_iterations = 1000;
+};
+
+/**
+ * @brief  batchで1回のhash_many()に渡すメッセージの数
+ * @return メッセージ長sizeのn個がbatch_bytesを超えない範囲で、batch_count以下
+ *         1個でもbatch_bytesを超えるなら0(計測しない)
+ */
+inline std::size_t bench_batch_count(std::uint64_t size,
+                                     const BenchConfig &config) {
+  if (size == 0) {
+    return config.batch_count;
+  }
+  return static_cast<std::size_t>(std::min<std::uint64_t>(
+      config.batch_count, config.batch_bytes / size));
+}
+
+/**
+ * @brief  計測するメッセージ長(0 B, 64 B, 256 B, ..., 1 GiB)
+ */
+inline std::vector<std::uint64_t> bench_sizes(std::uint64_t max_size) {
+  std::vector<std::uint64_t> sizes;
+  for (std::uint64_t n : {std::uint64_t(0), std::uint64_t(64),
+                          std::uint64_t(256), std::uint64_t(1) << 10,
+                          std::uint64_t(4) << 10, std::uint64_t(64) << 10,
+                          std::uint64_t(1) << 20, std::uint64_t(16) << 20,
+                          std::uint64_t(256) << 20, std::uint64_t(1) << 30}) {
+    if (n <= max_size) {
+      sizes.push_back(n);
+    }
+  }
+  return sizes;
+}
+
+/**
+ * @brief  TSCを読む(x86以外では0)
+ */
+inline std::uint64_t read_cycles() {
+#ifdef SHA_X86
+  return __rdtsc();
+#else
+  return 0;
+#endif
+}
+
+/**
+ * @brief  f()を経過時間がmin_timeを超えるまで繰り返し、回数と時間を記録する
+ * @note   回数は倍々に増やし、最後の1回の計測だけを結果とする
+ */
+template <class F> void measure(BenchResult &r, double min_time, F &&f) {
+  using clock = std::chrono::steady_clock;
+  for (std::uint64_t n = 1;; n *= 2) {
+    const auto start = clock::now();
+    const std::uint64_t c0 = read_cycles();
+    for (std::uint64_t i = 0; i < n; i++) {
+      f();
+    }
+    const std::uint64_t c1 = read_cycles();
+    const double sec =
+        std::chrono::duration<double>(clock::now() - start).count();
+    if (sec >= min_time || n >= (std::uint64_t(1) << 32)) {
+      r.iterations = n;
+      r.seconds = sec;
+      r.cycles = static_cast<double>(c1 - c0);
+      return;
+    }
+  }
+}
+
+/**
+ * @brief 計算結果を捨てられないようにするための書き込み先
+ */
+inline volatile std::uint8_t bench_sink;
+
+/**
+ * @brief hash_many()を持つハッシュクラスか判定する
+ */
+template <class Hasher, class = void> struct has_hash_many : std::false_type {};
+
+template <class Hasher>
+struct has_hash_many<
+    Hasher, std::void_t<decltype(Hasher::hash_many(
+                std::size_t(), std::declval<const void *const *>(),
+                std::declval<const std::size_t *>(),
+                std::declval<typename Hasher::digest_type *>()))>>
+    : std::true_type {};
+
+/**
+ * @brief  1つのアルゴリズムを、使用可能な全てのバックエンドで計測する
+ * @param  const char* name アルゴリズム名
+ * @param  const std::uint8_t* data 計測に使うメッセージ(max_size byte)
+ * @note   計測の後、バックエンドは元に戻す
+ */
+template <class Hasher>
+std::vector<BenchResult> bench_algorithm(const char *name,
+                                         const std::uint8_t *data,
+                                         const BenchConfig &config) {
+  std::vector<BenchResult> results;
+  const auto sizes = bench_sizes(config.max_size);
+
+  const Backend original = Hasher::backend();
+  for (Backend b :
+       {Backend::Scalar, Backend::SHANI, Backend::AVX2, Backend::AVX512}) {
+    if (!Hasher::set_backend(b)) {
+      continue;
+    }
+    for (std::uint64_t size : sizes) {
+      BenchResult r{name, "oneshot", backend_name(b), size, size};
+      measure(r, config.min_time, [&] {
+        bench_sink = Hasher().hash(data, size)[0];
+      });
+      results.push_back(r);
+
+      r = BenchResult{name, "stream", backend_name(b), size, size};
+      measure(r, config.min_time, [&] {
+        Hasher ctx;
+        for (std::uint64_t off = 0; off < size; off += config.stream_chunk) {
+          ctx.update(data + off,
+                     std::min<std::uint64_t>(config.stream_chunk, size - off));
+        }
+        bench_sink = ctx.finalize()[0];
+      });
+      results.push_back(r);
+    }
+  }
+  Hasher::set_backend(original);
+
+  if constexpr (has_hash_many<Hasher>::value) {
+    const Backend batch = Hasher::batch_backend();
+    std::vector<const void *> ptrs(config.batch_count, data);
+    std::vector<typename Hasher::digest_type> M(config.batch_count);
+    for (Backend b : {Backend::Scalar, Backend::AVX2, Backend::AVX512}) {
+      if (!Hasher::set_batch_backend(b)) {
+        continue;
+      }
+      for (std::uint64_t size : sizes) {
+        const std::size_t count = bench_batch_count(size, config);
+        if (count == 0) {
+          continue;
+        }
+        const std::vector<std::size_t> len(count, size);
+        BenchResult r{name, "batch", backend_name(b), size, size * count};
+        measure(r, config.min_time, [&] {
+          Hasher::hash_many(count, ptrs.data(), len.data(), M.data());
+          bench_sink = M[0][0];
+        });
+        results.push_back(r);
+      }
+    }
+    Hasher::set_batch_backend(batch);
+  }
+  return results;
+}
+
+/**
+ * @brief  PBKDF2-HMACを、1つのパスワードの場合(derive)は使用可能な全ての
+ *         バックエンドで、複数のパスワードの場合(derive_many)は全ての
+ *         hash_many()のバックエンドで計測する
+ * @param  const char* name アルゴリズム名(pbkdf2-sha256など)
+ * @note   derive_manyのパスワードの数は、最も多いレーン数(Hasher::max_lanes)
+ *         導出する鍵は1ブロック(digest_size byte)とする
+ *         計測の後、バックエンドは元に戻す
+ */
+template <class Hasher>
+std::vector<BenchResult> bench_pbkdf2(const char *name,
+                                      const BenchConfig &config) {
+  using KDF = PBKDF2<Hasher>;
+  std::vector<BenchResult> results;
+  const std::size_t n = Hasher::max_lanes;
+  const std::uint32_t c = std::max<std::uint32_t>(config.kdf_iterations, 1);
+  const char salt[] = "benchmark salt";
+  std::vector<std::string> pw(n);
+  std::vector<const void *> P(n);
+  std::vector<std::size_t> L(n);
+  std::vector<std::array<std::uint8_t, Hasher::digest_size>> dk(n);
+  std::vector<std::uint8_t *> D(n);
+  for (std::size_t i = 0; i < n; i++) {
+    pw[i] = "password" + std::to_string(i);
+    P[i] = pw[i].data();
+    L[i] = pw[i].size();
+    D[i] = dk[i].data();
+  }
+
+  const Backend original = Hasher::backend();
+  for (Backend b :
+       {Backend::Scalar, Backend::SHANI, Backend::AVX2, Backend::AVX512}) {
+    if (!Hasher::set_backend(b)) {
+      continue;
+    }
+    BenchResult r{name, "derive", backend_name(b), 1, 0};
+    r.kdf_iterations = c;
+    measure(r, config.min_time, [&] {
+      KDF::derive(P[0], L[0], salt, sizeof(salt) - 1, c, D[0], dk[0].size());
+      bench_sink = dk[0][0];
+    });
+    results.push_back(r);
+  }
+  Hasher::set_backend(original);
+
+  const Backend batch = Hasher::batch_backend();
+  for (Backend b : {Backend::Scalar, Backend::AVX2, Backend::AVX512}) {
+    if (!Hasher::set_batch_backend(b)) {
+      continue;
+    }
+    BenchResult r{name, "derive_many", backend_name(b), n, 0};
+    r.kdf_iterations = std::uint64_t(c) * n;
+    measure(r, config.min_time, [&] {
+      KDF::derive_many(n, P.data(), L.data(), salt, sizeof(salt) - 1, c,
+                       D.data(), dk[0].size());
+      bench_sink = dk[0][0];
+    });
+    results.push_back(r);
+  }
+  Hasher::set_batch_backend(batch);
+  return results;
+}
+
+/**< @brief CSVの見出し行 */
+inline constexpr const char *bench_csv_header =
+    "algorithm,api,backend,size,bytes,iterations,seconds,cycles,gbps,"
+    "cycles_per_byte,ns_per_call,kdf_iterations,kdf_iterations_per_second";
+
+/**
+ * @brief  計測結果をCSVの1行(改行なし)にする
+ */
+inline std::string format_csv(const BenchResult &r) {
+  char buf[512];
+  std::snprintf(buf, sizeof(buf),
+                "%s,%s,%s,%llu,%llu,%llu,%.9g,%.9g,%.6g,%.6g,%.6g,%llu,%.6g",
+                r.algorithm.c_str(), r.api.c_str(), r.backend.c_str(),
+                static_cast<unsigned long long>(r.size),
+                static_cast<unsigned long long>(r.bytes),
+                static_cast<unsigned long long>(r.iterations), r.seconds,
+                r.cycles, r.gbps(), r.cycles_per_byte(), r.ns_per_call(),
+                static_cast<unsigned long long>(r.kdf_iterations),
+                r.kdf_iterations_per_second());
+  return buf;
+}
+
+/**
+ * @brief  計測結果をJSONのオブジェクト1つにする
+ */
+inline std::string format_json(const BenchResult &r) {
+  char buf[512];
+  std::snprintf(buf, sizeof(buf),
+                "{\"algorithm\": \"%s\", \"api\": \"%s\", \"backend\": \"%s\", "
+                "\"size\": %llu, \"bytes\": %llu, \"iterations\": %llu, "
+                "\"seconds\": %.9g, \"cycles\": %.9g, \"gbps\": %.6g, "
+                "\"cycles_per_byte\": %.6g, \"ns_per_call\": %.6g, "
+                "\"kdf_iterations\": %llu, "
+                "\"kdf_iterations_per_second\": %.6g}",
+                r.algorithm.c_str(), r.api.c_str(), r.backend.c_str(),
+                static_cast<unsigned long long>(r.size),
+                static_cast<unsigned long long>(r.bytes),
+                static_cast<unsigned long long>(r.iterations), r.seconds,
+                r.cycles, r.gbps(), r.cycles_per_byte(), r.ns_per_call(),
+                static_cast<unsigned long long>(r.kdf_iterations),
+                r.kdf_iterations_per_second());
+  return buf;
+}
+
+/**
+ * @brief  format_csv()で書き出したCSV(見出し行を含む)を読み込む
+ * @note   見出し行と、列の数が合わない行は読み飛ばす
+ *         kdf_iterationsの列がない以前の形式(11列)も読める
+ */
+inline std::vector<BenchResult> parse_csv(std::istream &in) {
+  std::vector<BenchResult> results;
+  std::string line;
+  while (std::getline(in, line)) {
+    std::vector<std::string> f;
+    std::stringstream ss(line);
+    for (std::string x; std::getline(ss, x, ',');) {
+      f.push_back(x);
+    }
+    if ((f.size() != 11 && f.size() != 13) || f[0] == "algorithm") {
+      continue;
+    }
+    BenchResult r;
+    r.algorithm = f[0];
+    r.api = f[1];
+    r.backend = f[2];
+    r.size = std::stoull(f[3]);
+    r.bytes = std::stoull(f[4]);
+    r.iterations = std::stoull(f[5]);
+    r.seconds = std::stod(f[6]);
+    r.cycles = std::stod(f[7]);
+    r.kdf_iterations = f.size() > 11 ? std::stoull(f[11]) : 0;
+    results.push_back(r);
+  }
+  return results;
+}
+
+/**
+ * @brief ベースラインより遅くなった計測
+ */
+struct BenchRegression {
+  BenchResult baseline;
+  BenchResult current;
+
+  /**
+   * @brief  1回の呼び出しにかかる時間の増加率(0.1なら10%遅い)
+   */
+  double slowdown() const {
+    return current.ns_per_call() / baseline.ns_per_call() - 1;
+  }
+};
+
+/**
+ * @brief  ベースラインと比べて、1回の呼び出しがthresholdを超えて遅くなった
+ *         計測を返す
+ * @param  double threshold 許容する増加率(0.1なら10%まで)
+ * @note   ベースラインにない計測は比べない
+ */
+inline std::vector<BenchRegression>
+compare_results(const std::vector<BenchResult> &baseline,
+                const std::vector<BenchResult> &current, double threshold) {
+  std::map<decltype(BenchResult().key()), BenchResult> base;
+  for (auto &&r : baseline) {
+    base[r.key()] = r;
+  }
+  std::vector<BenchRegression> regressions;
+  for (auto &&r : current) {
+    const auto it = base.find(r.key());
+    if (it == base.end() || it->second.ns_per_call() <= 0) {
+      continue;
+    }
+    BenchRegression x{it->second, r};
+    if (x.slowdown() > threshold) {
+      regressions.push_back(x);
+    }
+  }
+  return regressions;
+}
+
+#endif // end of BENCH_HPP
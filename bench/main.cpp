@@ -0,0 +1,174 @@
+/**
+ * @brief benchのテストプログラム
+ */
+
+#define CATCH_CONFIG_MAIN // This tells Catch to provide a main() - only do this
+                          // in one cpp file
+#include "../matcher.hpp"
+#include "bench.hpp"
+#include <sstream>
+
+namespace {
+
+BenchResult make_result(const char *api, std::uint64_t size, double seconds) {
+  return BenchResult{"sha256", api, "scalar", size, size, 1000, seconds, 0};
+}
+
+} // namespace
+
+TEST_CASE("Bench-Sizes", "[bench]") {
+  const auto all = bench_sizes(std::uint64_t(1) << 30);
+  REQUIRE(all.front() == 0);
+  REQUIRE(all.back() == std::uint64_t(1) << 30);
+  REQUIRE(std::is_sorted(all.begin(), all.end()));
+  REQUIRE(bench_sizes(4096).back() == 4096);
+  REQUIRE(bench_sizes(0).size() == 1);
+}
+
+TEST_CASE("Bench-Derived", "[bench]") {
+  BenchResult r{"sha1", "oneshot", "scalar", 1000, 1000, 2000, 0.5, 4e6};
+  REQUIRE(r.gbps() == Approx(0.004));
+  REQUIRE(r.cycles_per_byte() == Approx(2.0));
+  REQUIRE(r.ns_per_call() == Approx(250000));
+
+  // 0 byteのメッセージでもゼロ除算しない
+  BenchResult e{"sha1", "oneshot", "scalar", 0, 0, 100, 0.1, 1000};
+  REQUIRE(e.cycles_per_byte() == 0);
+  REQUIRE(e.gbps() == 0);
+}
+
+TEST_CASE("Bench-CSV", "[bench]") {
+  const std::vector<BenchResult> rs = {
+      make_result("oneshot", 64, 0.25),
+      make_result("batch", 1 << 20, 1.5),
+  };
+  std::stringstream ss;
+  ss << bench_csv_header << "\n";
+  for (auto &&r : rs) {
+    ss << format_csv(r) << "\n";
+  }
+  const auto back = parse_csv(ss);
+  REQUIRE(back.size() == rs.size());
+  for (std::size_t i = 0; i < rs.size(); i++) {
+    REQUIRE(back[i].key() == rs[i].key());
+    REQUIRE(back[i].iterations == rs[i].iterations);
+    REQUIRE(back[i].ns_per_call() == Approx(rs[i].ns_per_call()));
+  }
+
+  const std::string json = format_json(rs[0]);
+  REQUIRE(json.front() == '{');
+  REQUIRE(json.find("\"api\": \"oneshot\"") != std::string::npos);
+  REQUIRE(json.find("\"size\": 64") != std::string::npos);
+}
+
+TEST_CASE("Bench-Compare", "[bench]") {
+  const std::vector<BenchResult> base = {
+      make_result("oneshot", 64, 1.0),
+      make_result("stream", 64, 1.0),
+      make_result("batch", 64, 1.0),
+  };
+  const std::vector<BenchResult> cur = {
+      make_result("oneshot", 64, 1.05), // 5%遅い(許容範囲)
+      make_result("stream", 64, 1.5),   // 50%遅い
+      make_result("batch", 64, 0.5),    // 速くなった
+      make_result("batch", 128, 9.0),   // ベースラインにない
+  };
+  const auto x = compare_results(base, cur, 0.1);
+  REQUIRE(x.size() == 1);
+  REQUIRE(x[0].current.api == "stream");
+  REQUIRE(x[0].slowdown() == Approx(0.5));
+  REQUIRE(compare_results(base, cur, 0.6).empty());
+}
+
+TEST_CASE("Bench-Run", "[bench]") {
+  BenchConfig config;
+  config.max_size = 256;
+  config.min_time = 0.001;
+  config.batch_count = 4;
+  std::vector<std::uint8_t> data(config.max_size, 0x61);
+
+  const auto original = SHA256::backend();
+  const auto batch = SHA256::batch_backend();
+  const auto rs = bench_algorithm<SHA256>("sha256", data.data(), config);
+  REQUIRE(SHA256::backend() == original);
+  REQUIRE(SHA256::batch_backend() == batch);
+
+  // 全てのバックエンド x メッセージ長 x API
+  const std::size_t sizes = bench_sizes(config.max_size).size();
+  std::size_t expected = 0;
+  for (Backend b :
+       {Backend::Scalar, Backend::SHANI, Backend::AVX2, Backend::AVX512}) {
+    expected += SHA256::supports(b) ? 2 * sizes : 0;
+    expected += SHA256::supports_batch(b) ? sizes : 0;
+  }
+  REQUIRE(rs.size() == expected);
+  for (auto &&r : rs) {
+    REQUIRE(r.iterations > 0);
+    REQUIRE(r.seconds >= config.min_time);
+    REQUIRE(r.bytes == r.size * (r.api == "batch" ? 4 : 1));
+  }
+
+  // batchのbyte数を抑えると、長いメッセージほど数が減り、収まらなければ除く
+  config.batch_bytes = 512;
+  std::size_t batch_rows = 0;
+  for (auto &&r : bench_algorithm<SHA256>("sha256", data.data(), config)) {
+    if (r.api == "batch") {
+      REQUIRE(r.bytes == r.size * bench_batch_count(r.size, config));
+      REQUIRE(r.bytes <= config.batch_bytes);
+      batch_rows++;
+    }
+  }
+  REQUIRE(bench_batch_count(0, config) == 4);
+  REQUIRE(bench_batch_count(64, config) == 4);
+  REQUIRE(bench_batch_count(256, config) == 2);
+  REQUIRE(bench_batch_count(1024, config) == 0);
+  REQUIRE(batch_rows > 0);
+
+  // SHA1はhash_many()を持たないのでbatchは計測しない
+  for (auto &&r : bench_algorithm<SHA1>("sha1", data.data(), config)) {
+    REQUIRE(r.api != "batch");
+  }
+}
+
+TEST_CASE("Bench-PBKDF2", "[bench]") {
+  BenchConfig config;
+  config.min_time = 0.001;
+  config.kdf_iterations = 10;
+
+  const auto original = SHA256::backend();
+  const auto batch = SHA256::batch_backend();
+  const auto rs = bench_pbkdf2<SHA256>("pbkdf2-sha256", config);
+  REQUIRE(SHA256::backend() == original);
+  REQUIRE(SHA256::batch_backend() == batch);
+
+  // 1つのパスワードは全てのバックエンド、複数はhash_many()のバックエンド
+  std::size_t expected = 0;
+  for (Backend b :
+       {Backend::Scalar, Backend::SHANI, Backend::AVX2, Backend::AVX512}) {
+    expected += SHA256::supports(b) ? 1 : 0;
+    expected += SHA256::supports_batch(b) ? 1 : 0;
+  }
+  REQUIRE(rs.size() == expected);
+  for (auto &&r : rs) {
+    REQUIRE(r.seconds >= config.min_time);
+    REQUIRE(r.kdf_iterations == r.size * config.kdf_iterations);
+    REQUIRE(r.kdf_iterations_per_second() > 0);
+    REQUIRE(r.size == (r.api == "derive" ? 1 : SHA256::max_lanes));
+  }
+
+  // 反復回数の列もCSVを往復する(列のない以前の形式も読める)
+  std::stringstream ss;
+  ss << bench_csv_header << "\n" << format_csv(rs.back()) << "\n";
+  ss << "sha256,oneshot,scalar,64,64,1000,0.25,0,0,0,0\n";
+  const auto back = parse_csv(ss);
+  REQUIRE(back.size() == 2);
+  REQUIRE(back[0].key() == rs.back().key());
+  REQUIRE(back[0].kdf_iterations == rs.back().kdf_iterations);
+  REQUIRE(back[1].kdf_iterations == 0);
+  REQUIRE(format_json(rs.back()).find("\"kdf_iterations_per_second\": ") !=
+          std::string::npos);
+
+  for (auto &&r : bench_pbkdf2<SHA512>("pbkdf2-sha512", config)) {
+    REQUIRE(r.kdf_iterations_per_second() > 0);
+  }
+}
@@ -8,6 +8,7 @@
 
 #include <climits>
 #include <cstdint>
+#include <cstring>
 #include <limits>
 #include <type_traits>
 
@@ -26,6 +27,9 @@ template <class Integer> constexpr Integer rotl(Integer x, std::uint32_t n) {
  * @brief ビットの右ローテーション
  * @param Integer x   ローテーション対象の値(符号なし整数)
  * @param uint32_t n  シフトする値
+ * @note  GCC/Clangはこの形を回転命令として認識する
+ *        BMI2を有効にした関数(target("bmi2"))に展開されると、フラグを壊さない
+ *        3オペランドのrorxになる
  */
 template <class Integer> constexpr Integer rotr(Integer x, std::uint32_t n) {
   static_assert(std::is_unsigned_v<Integer>,
@@ -64,4 +68,81 @@ constexpr Integer maj(Integer x, Integer y, Integer z) {
   return (x & y) ^ (y & z) ^ (z & x);
 }
 
+/**
+ * @brief 定数式として評価されているか判定する
+ * @note  C++20のstd::is_constant_evaluated()に相当する
+ *        GCC 9/Clang 9以降はC++17でも組み込み関数として使える
+ */
+constexpr bool is_constant_evaluated() noexcept {
+#if defined(__GNUC__) || defined(__clang__)
+  return __builtin_is_constant_evaluated();
+#else
+  return false;
+#endif
+}
+
+/**
+ * @brief ビッグエンディアンで格納された32-bit wordを読み込む
+ * @note  1byteずつシフトせず、1回のロードとbyte swapで済ませる
+ *        定数式の中ではmemcpyが使えないので、1byteずつ組み立てる
+ */
+constexpr std::uint32_t load_be32(const std::uint8_t *p) {
+  if (is_constant_evaluated()) {
+    return (std::uint32_t(p[0]) << 24) | (std::uint32_t(p[1]) << 16) |
+           (std::uint32_t(p[2]) << 8) | std::uint32_t(p[3]);
+  }
+  std::uint32_t x = 0;
+  std::memcpy(&x, p, sizeof(x));
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+  x = __builtin_bswap32(x);
+#endif
+  return x;
+}
+
+/**
+ * @brief ビッグエンディアンで格納された64-bit wordを読み込む
+ */
+constexpr std::uint64_t load_be64(const std::uint8_t *p) {
+  if (is_constant_evaluated()) {
+    return (std::uint64_t(load_be32(p)) << 32) | load_be32(p + 4);
+  }
+  std::uint64_t x = 0;
+  std::memcpy(&x, p, sizeof(x));
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+  x = __builtin_bswap64(x);
+#endif
+  return x;
+}
+
+/**
+ * @brief 32-bit wordをビッグエンディアンで書き込む
+ */
+constexpr void store_be32(std::uint8_t *p, std::uint32_t x) {
+  if (is_constant_evaluated()) {
+    for (int i = 0; i < 4; i++) {
+      p[i] = static_cast<std::uint8_t>(x >> (24 - 8 * i));
+    }
+    return;
+  }
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+  x = __builtin_bswap32(x);
+#endif
+  std::memcpy(p, &x, sizeof(x));
+}
+
+/**
+ * @brief 64-bit wordをビッグエンディアンで書き込む
+ */
+constexpr void store_be64(std::uint8_t *p, std::uint64_t x) {
+  if (is_constant_evaluated()) {
+    store_be32(p, static_cast<std::uint32_t>(x >> 32));
+    store_be32(p + 4, static_cast<std::uint32_t>(x));
+    return;
+  }
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+  x = __builtin_bswap64(x);
+#endif
+  std::memcpy(p, &x, sizeof(x));
+}
+
 #endif // end of BIT_HPP
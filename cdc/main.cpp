@@ -0,0 +1,145 @@
+/**
+ * @brief content-defined chunkingのテストプログラム
+ */
+
+#define CATCH_CONFIG_MAIN // This tells Catch to provide a main() - only do this
+                          // in one cpp file
+#include "../chunker.hpp"
+#include "../matcher.hpp"
+#include <random>
+
+namespace {
+
+std::vector<std::uint8_t> random_bytes(std::size_t n, std::uint64_t seed) {
+  std::mt19937_64 rng(seed);
+  std::vector<std::uint8_t> v(n);
+  for (auto &&b : v) {
+    b = static_cast<std::uint8_t>(rng());
+  }
+  return v;
+}
+
+/**
+ * @brief  索引が入力全体を隙間なく覆い、各ダイジェストが正しいか確かめる
+ */
+void check_index(const std::vector<Chunk> &index,
+                 const std::vector<std::uint8_t> &data,
+                 const CdcConfig &config) {
+  std::uint64_t pos = 0;
+  for (std::size_t i = 0; i < index.size(); i++) {
+    const Chunk &c = index[i];
+    REQUIRE(c.offset == pos);
+    REQUIRE(c.length <= config.max_size);
+    if (i + 1 < index.size()) {
+      REQUIRE(c.length >= config.min_size);
+    }
+    REQUIRE(c.digest == SHA256().hash(data.data() + c.offset, c.length));
+    pos += c.length;
+  }
+  REQUIRE(pos == data.size());
+}
+
+bool same_index(const std::vector<Chunk> &a, const std::vector<Chunk> &b) {
+  if (a.size() != b.size()) {
+    return false;
+  }
+  for (std::size_t i = 0; i < a.size(); i++) {
+    if (a[i].offset != b[i].offset || a[i].length != b[i].length ||
+        a[i].digest != b[i].digest) {
+      return false;
+    }
+  }
+  return true;
+}
+
+} // namespace
+
+TEST_CASE("CDC-Index") {
+  const CdcConfig config;
+  const auto data = random_bytes(std::size_t(4) << 20, 1);
+  const auto index = chunk_index(data.data(), data.size(), config);
+  check_index(index, data, config);
+
+  // 平均長の前後に収まる
+  const double avg = static_cast<double>(data.size()) / index.size();
+  CHECK(avg > config.avg_size / 2);
+  CHECK(avg < config.avg_size * 2);
+
+  // 空の入力にはチャンクがない
+  CHECK(chunk_index(data.data(), 0).empty());
+
+  // 全て同じ値の入力は最大長で切れる
+  const std::vector<std::uint8_t> zeros(200000, 0);
+  const auto z = chunk_index(zeros.data(), zeros.size(), config);
+  check_index(z, zeros, config);
+}
+
+TEST_CASE("CDC-Streaming") {
+  // update()の区切り方によらず同じ索引になる
+  const CdcConfig config{512, 2048, 8192};
+  const auto data = random_bytes(1 << 20, 2);
+  const auto expected = chunk_index(data.data(), data.size(), config);
+  check_index(expected, data, config);
+
+  for (std::size_t piece : {1, 777, 4096, 100000}) {
+    ChunkIndexer indexer(config);
+    for (std::size_t off = 0; off < data.size(); off += piece) {
+      indexer.update(data.data() + off, std::min(piece, data.size() - off));
+    }
+    INFO("piece = " << piece);
+    CHECK(same_index(indexer.finalize(), expected));
+  }
+}
+
+TEST_CASE("CDC-Batch-Backends") {
+  const Backend original = SHA256::batch_backend();
+  const auto data = random_bytes(1 << 20, 3);
+  SHA256::set_batch_backend(Backend::Scalar);
+  const auto expected = chunk_index(data.data(), data.size());
+  for (Backend b : {Backend::AVX2, Backend::AVX512}) {
+    if (SHA256::set_batch_backend(b)) {
+      CHECK(same_index(chunk_index(data.data(), data.size()), expected));
+    }
+  }
+  SHA256::set_batch_backend(original);
+}
+
+TEST_CASE("CDC-Rechunk") {
+  const CdcConfig config;
+  const auto base_data = random_bytes(std::size_t(2) << 20, 4);
+  const auto base = chunk_index(base_data.data(), base_data.size(), config);
+
+  struct Edit {
+    std::size_t first;
+    std::size_t removed;
+    std::size_t inserted;
+  };
+  const std::size_t n = base_data.size();
+  for (Edit e : {Edit{n / 2, 0, 100}, Edit{n / 2, 5000, 0},
+                 Edit{n / 3, 300, 300}, Edit{0, 0, 1}, Edit{0, 10, 0},
+                 Edit{n, 0, 50000}, Edit{n - 10, 10, 0}}) {
+    std::vector<std::uint8_t> data(base_data.begin(),
+                                   base_data.begin() + e.first);
+    const auto ins = random_bytes(e.inserted, e.first + e.inserted);
+    data.insert(data.end(), ins.begin(), ins.end());
+    data.insert(data.end(), base_data.begin() + e.first + e.removed,
+                base_data.end());
+    INFO("first = " << e.first << ", removed = " << e.removed
+                    << ", inserted = " << e.inserted);
+
+    const auto expected = chunk_index(data.data(), data.size(), config);
+    const auto index =
+        rechunk_index(base, data.data(), data.size(), e.first,
+                      e.first + e.removed, e.first + e.inserted, config);
+    CHECK(same_index(index, expected));
+
+    // 変化したのは変更された領域に触れるチャンクだけ
+    std::size_t changed = 0;
+    for (auto &&c : expected) {
+      changed += std::none_of(base.begin(), base.end(), [&](const Chunk &b) {
+        return b.digest == c.digest;
+      });
+    }
+    CHECK(changed <= 3 + e.inserted / config.min_size);
+  }
+}
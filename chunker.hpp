@@ -0,0 +1,322 @@
+/**
+ * @brief 内容で境界を決める分割(content-defined chunking)と、チャンクごとのSHA256
+ * @note  FastCDC(Gearハッシュ、最小長までの読み飛ばし、正規化した2つのマスク)
+ *          fp = (fp << 1) + gear[b]
+ *          fpの上位ビットが全て0になった位置でチャンクを切る
+ *          平均長より手前では1つ多く、先では1つ少ないビットを調べ、長さを平均に寄せる
+ *        fpはチャンクの先頭で0に戻すので、境界はそのチャンクの内容だけで決まる
+ *        そのため、入力の一部を書き換えても、前後のチャンクの境界とダイジェストは
+ *        変わらない(rechunk_index()は変化したチャンクだけを計算し直す)
+ *        入力の中に収まるチャンクはコピーせずにSHA256::hash_many()のSIMDレーンへ
+ *        まとめて渡し、update()の境界をまたぐチャンクだけを逐次計算する
+ */
+
+#ifndef CHUNKER_HPP
+#define CHUNKER_HPP
+
+#include "sha256/sha256.hpp"
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * @brief チャンクの長さの設定(byte)
+ * @note  出力形式の一部(同じ設定で分割しなければ境界は一致しない)
+ */
+struct CdcConfig {
+  /**< @brief 最小長(この手前では境界を探さない) */
+  std::size_t min_size = 2048;
+
+  /**< @brief 平均長(2の冪) */
+  std::size_t avg_size = 8192;
+
+  /**< @brief 最大長(ここで必ず切る) */
+  std::size_t max_size = 65536;
+};
+
+/**
+ * @brief チャンクの索引の1項目
+ */
+struct Chunk {
+  /**< @brief 入力の先頭からの位置 */
+  std::uint64_t offset;
+
+  /**< @brief チャンクのbyte数 */
+  std::uint32_t length;
+
+  /**< @brief チャンクのSHA256 */
+  SHA256::digest_type digest;
+};
+
+/**< @brief Gearハッシュの表(splitmix64で生成した256個の乱数) */
+inline constexpr std::array<std::uint64_t, 256> gear_table = [] {
+  std::array<std::uint64_t, 256> g{};
+  std::uint64_t x = 0;
+  for (auto &&v : g) {
+    x += 0x9e3779b97f4a7c15;
+    std::uint64_t z = x;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+    v = z ^ (z >> 31);
+  }
+  return g;
+}();
+
+/**
+ * @brief チャンクの境界を探す(入力を何回かに分けて渡せる)
+ */
+class Chunker {
+public:
+  explicit Chunker(const CdcConfig &config = CdcConfig())
+      : min_size(config.min_size), avg_size(config.avg_size),
+        max_size(std::max(config.max_size, config.min_size + 1)) {
+    std::size_t bits = 0;
+    while ((std::size_t(1) << (bits + 1)) <= avg_size) {
+      bits++;
+    }
+    mask_s = ~std::uint64_t(0) << (64 - (bits + 1));
+    mask_l = ~std::uint64_t(0) << (64 - (bits > 1 ? bits - 1 : 1));
+  }
+
+  /**
+   * @brief  次の境界を探す
+   * @param  std::size_t& used 読み進めたbyte数(境界があれば、そこまで)
+   * @return 境界が見つかったか(見つからなければ、続きを次の呼び出しで探す)
+   */
+  bool find(const std::uint8_t *p, std::size_t n, std::size_t &used) {
+    // p[i]はチャンクのbegin + i byte目
+    const std::size_t begin = pos;
+    const std::size_t mid = std::min(n, avg_size - std::min(avg_size, begin));
+    const std::size_t end = std::min(n, max_size - begin);
+
+    // 最小長までは境界を探さない
+    std::size_t i = std::min(n, min_size - std::min(min_size, begin));
+
+    // 平均長までは厳しいマスク、その先は緩いマスクで探し、最大長で必ず切る
+    for (; i < mid; i++) {
+      fp = (fp << 1) + gear_table[p[i]];
+      if ((fp & mask_s) == 0) {
+        return cut(i + 1, used);
+      }
+    }
+    for (; i < end; i++) {
+      fp = (fp << 1) + gear_table[p[i]];
+      if ((fp & mask_l) == 0) {
+        return cut(i + 1, used);
+      }
+    }
+    if (end == max_size - begin) {
+      return cut(end, used);
+    }
+    pos = begin + n;
+    used = n;
+    return false;
+  }
+
+  /**
+   * @brief  チャンクの途中の状態を捨て、次の入力をチャンクの先頭とする
+   */
+  void reset() {
+    pos = 0;
+    fp = 0;
+  }
+
+private:
+  bool cut(std::size_t i, std::size_t &used) {
+    used = i;
+    reset();
+    return true;
+  }
+
+  std::size_t min_size;
+  std::size_t avg_size;
+  std::size_t max_size;
+  std::uint64_t mask_s;
+  std::uint64_t mask_l;
+
+  /**< @brief 現在のチャンクの読み進めたbyte数 */
+  std::size_t pos = 0;
+
+  /**< @brief Gearハッシュ */
+  std::uint64_t fp = 0;
+};
+
+/**
+ * @brief 入力を分割し、チャンクの索引(位置, 長さ, SHA256)を作る
+ * @note  update()に渡した領域に収まるチャンクは、update()から戻る前に
+ *        まとめてhash_many()で計算する(領域はコピーしない)
+ *        update()の境界をまたぐチャンクは、SHA256のコンテキストに逐次取り込む
+ */
+class ChunkIndexer {
+public:
+  /**
+   * @param  std::uint64_t offset 最初のチャンクの入力での位置
+   */
+  explicit ChunkIndexer(const CdcConfig &config = CdcConfig(),
+                        std::uint64_t offset = 0)
+      : chunker(config), start(offset) {}
+
+  /**
+   * @brief  入力の続きを分割する
+   */
+  void update(const void *data, std::size_t len) {
+    const auto *p = static_cast<const std::uint8_t *>(data);
+    while (len > 0) {
+      std::size_t n;
+      const bool cut = chunker.find(p, len, n);
+      if (!cut || partial > 0) {
+        // update()をまたぐチャンク
+        ctx.update(p, n);
+        partial += n;
+        if (cut) {
+          push(partial).digest = ctx.finalize();
+          ctx.init();
+          partial = 0;
+        }
+      } else {
+        pending_data.push_back(p);
+        pending_len.push_back(n);
+        pending_index.push_back(index.size());
+        push(n);
+      }
+      p += n;
+      len -= n;
+    }
+    flush();
+  }
+
+  /**
+   * @brief  入力の終わりまでを最後のチャンクとし、索引を返す
+   */
+  std::vector<Chunk> finalize() {
+    if (partial > 0) {
+      push(partial).digest = ctx.finalize();
+      partial = 0;
+    }
+    return std::move(index);
+  }
+
+private:
+  Chunk &push(std::size_t n) {
+    index.push_back(Chunk{start, static_cast<std::uint32_t>(n), {}});
+    start += n;
+    return index.back();
+  }
+
+  /**
+   * @brief  保留したチャンクをSIMDレーンに並べて計算する
+   */
+  void flush() {
+    digests.resize(pending_data.size());
+    SHA256::hash_many(pending_data.size(), pending_data.data(),
+                      pending_len.data(), digests.data());
+    for (std::size_t i = 0; i < digests.size(); i++) {
+      index[pending_index[i]].digest = digests[i];
+    }
+    pending_data.clear();
+    pending_len.clear();
+    pending_index.clear();
+  }
+
+  Chunker chunker;
+  std::vector<Chunk> index;
+
+  /**< @brief 次のチャンクの位置 */
+  std::uint64_t start;
+
+  /**< @brief update()をまたぐチャンクのコンテキストと、取り込んだbyte数 */
+  SHA256 ctx;
+  std::size_t partial = 0;
+
+  /**< @brief 計算を保留しているチャンク(update()の領域を指す) */
+  std::vector<const void *> pending_data;
+  std::vector<std::size_t> pending_len;
+  std::vector<std::size_t> pending_index;
+  std::vector<SHA256::digest_type> digests;
+};
+
+/**
+ * @brief  入力全体を分割し、チャンクの索引を作る
+ * @note   ファイルはMappedFileでマップして渡せば、コピーせずに済む
+ */
+inline std::vector<Chunk> chunk_index(const void *data, std::size_t len,
+                                      const CdcConfig &config = CdcConfig()) {
+  ChunkIndexer indexer(config);
+  indexer.update(data, len);
+  return indexer.finalize();
+}
+
+/**
+ * @brief  入力の一部が変わった後の索引を、変化したチャンクだけを計算して作る
+ * @param  const std::vector<Chunk>& base 変更前の入力の索引
+ * @param  const void* data               変更後の入力
+ * @param  std::uint64_t first            変更された領域の先頭
+ * @param  std::uint64_t base_end         変更前の入力での、変更された領域の終わり
+ * @param  std::uint64_t end              変更後の入力での、変更された領域の終わり
+ * @note   firstより前で終わるチャンクはそのまま使う。変更された領域の後で、
+ *         変更前と同じ位置(長さの差だけずらした位置)に境界が見つかれば、
+ *         そこから先も位置をずらしてそのまま使う
+ *         結果はchunk_index(data, len)と一致する
+ */
+inline std::vector<Chunk> rechunk_index(const std::vector<Chunk> &base,
+                                        const void *data, std::size_t len,
+                                        std::uint64_t first,
+                                        std::uint64_t base_end,
+                                        std::uint64_t end,
+                                        const CdcConfig &config = CdcConfig()) {
+  const auto *p = static_cast<const std::uint8_t *>(data);
+
+  // 変更された領域より前で終わるチャンク
+  // 最後のチャンクは入力の終わりで切っただけなので、続きがあれば伸びうる
+  std::size_t k = 0;
+  while (k + 1 < base.size() && base[k].offset + base[k].length <= first) {
+    k++;
+  }
+  std::vector<Chunk> index(base.begin(), base.begin() + k);
+  std::uint64_t pos = k > 0 ? base[k - 1].offset + base[k - 1].length : 0;
+
+  // 変更された領域の後で、変更前の境界と揃うまで分割し直す
+  Chunker chunker(config);
+  std::vector<const void *> ptr;
+  std::vector<std::size_t> lens;
+  const std::size_t head = index.size();
+  bool synced = false;
+  while (pos < len && !synced) {
+    std::size_t n;
+    if (!chunker.find(p + pos, len - pos, n)) {
+      n = len - pos;
+    }
+    ptr.push_back(p + pos);
+    lens.push_back(n);
+    index.push_back(Chunk{pos, static_cast<std::uint32_t>(n), {}});
+    pos += n;
+
+    // 変更前の入力でのこの境界の位置
+    if (pos >= end) {
+      const std::uint64_t b = pos - end + base_end;
+      while (k < base.size() && base[k].offset + base[k].length < b) {
+        k++;
+      }
+      synced = k < base.size() && base[k].offset + base[k].length == b;
+    }
+  }
+  std::vector<SHA256::digest_type> digests(ptr.size());
+  SHA256::hash_many(ptr.size(), ptr.data(), lens.data(), digests.data());
+  for (std::size_t i = 0; i < digests.size(); i++) {
+    index[head + i].digest = digests[i];
+  }
+
+  // 残りは位置をずらしてそのまま使う
+  if (synced) {
+    for (k++; k < base.size(); k++) {
+      Chunk c = base[k];
+      c.offset = c.offset - base_end + end;
+      index.push_back(c);
+    }
+  }
+  return index;
+}
+
+#endif // end of CHUNKER_HPP
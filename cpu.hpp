@@ -0,0 +1,118 @@
+/**
+ * @brief CPUの機能判定と圧縮関数の実装(バックエンド)の選択
+ * @note  x86以外、あるいはGCC/Clang以外ではスカラー実装のみが選択される
+ */
+
+#ifndef CPU_HPP
+#define CPU_HPP
+
+#include <cstdlib>
+#include <cstring>
+#include <initializer_list>
+
+#if (defined(__x86_64__) || defined(__i386__)) &&                             \
+    (defined(__GNUC__) || defined(__clang__))
+#define SHA_X86
+#include <cpuid.h>
+#include <immintrin.h>
+#endif
+
+/**
+ * @brief 圧縮関数の実装の種類
+ */
+enum class Backend {
+  Scalar, /**< 移植性のあるC++による実装 */
+  SHANI,  /**< Intel SHA extensions(sha256rnds2, sha1rnds4, ...)による実装 */
+  AVX2,   /**< AVX2(およびBMI2)による実装 */
+  AVX512, /**< AVX-512による実装 */
+};
+
+/**
+ * @brief 実行中のCPUが持つ機能
+ */
+struct CPUFeatures {
+  bool ssse3 = false;
+  bool sse41 = false;
+  bool sha = false;
+  bool avx2 = false;
+  bool bmi2 = false;
+  bool avx512f = false;
+};
+
+/**
+ * @brief CPUIDを一度だけ発行し、CPUの機能を判定する
+ */
+inline const CPUFeatures &cpu_features() {
+  static const CPUFeatures features = [] {
+    CPUFeatures f;
+#ifdef SHA_X86
+    unsigned int eax, ebx, ecx, edx;
+    bool ymm = false; // OSがYMMレジスタの退避に対応しているか
+    bool zmm = false; // OSがZMMレジスタの退避に対応しているか
+    if (__get_cpuid(1, &eax, &ebx, &ecx, &edx)) {
+      f.ssse3 = (ecx & bit_SSSE3) != 0;
+      f.sse41 = (ecx & bit_SSE4_1) != 0;
+      if ((ecx & bit_OSXSAVE) != 0) {
+        unsigned int xcr0_lo, xcr0_hi;
+        __asm__("xgetbv" : "=a"(xcr0_lo), "=d"(xcr0_hi) : "c"(0));
+        ymm = (xcr0_lo & 0x06) == 0x06;
+        zmm = ymm && (xcr0_lo & 0xe0) == 0xe0;
+      }
+    }
+    if (__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx)) {
+      f.sha = (ebx & bit_SHA) != 0;
+      f.avx2 = ymm && (ebx & bit_AVX2) != 0;
+      f.bmi2 = (ebx & bit_BMI2) != 0;
+      f.avx512f = zmm && (ebx & bit_AVX512F) != 0;
+    }
+#endif
+    return f;
+  }();
+  return features;
+}
+
+/**
+ * @brief バックエンドの名前を返す
+ */
+inline const char *backend_name(Backend b) {
+  switch (b) {
+  case Backend::Scalar:
+    return "scalar";
+  case Backend::SHANI:
+    return "shani";
+  case Backend::AVX2:
+    return "avx2";
+  case Backend::AVX512:
+    return "avx512";
+  }
+  return "unknown";
+}
+
+/**
+ * @brief  名前からバックエンドを求める
+ * @return 該当するバックエンドがなければfalse
+ */
+inline bool backend_from_name(const char *name, Backend &b) {
+  for (Backend x :
+       {Backend::Scalar, Backend::SHANI, Backend::AVX2, Backend::AVX512}) {
+    if (std::strcmp(name, backend_name(x)) == 0) {
+      b = x;
+      return true;
+    }
+  }
+  return false;
+}
+
+/**
+ * @brief  環境変数で強制されたバックエンドを取得する
+ * @param  const char* var 環境変数名
+ *         圧縮関数はSHA_BACKEND, 複数メッセージの一括計算はSHA_BATCH_BACKEND
+ * @note   例えば SHA_BACKEND=scalar ./main のように使う
+ * @return 指定がない、あるいは不正な名前であればfalse
+ */
+inline bool requested_backend(Backend &b, const char *var = "SHA_BACKEND") {
+  const char *name = std::getenv(var);
+  return name != nullptr && backend_from_name(name, b);
+}
+
+#endif // end of CPU_HPP
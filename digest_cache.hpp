@@ -0,0 +1,533 @@
+/**
+ * @brief ファイルのハッシュ値を(デバイス, inode, 大きさ, 更新時刻, アルゴリズム)を
+ *        キーとしてディスクに残し、変わっていないファイルの再計算を省く
+ * @note  ファイル形式(追記のみ、ホストのバイト順)
+ *          ヘッダ(64byte): magic "SHADCACH", version, record_size
+ *          レコード(112byte)の並び: dev, ino, size, mtime_ns, algorithm,
+ *                                   length, digest[64], check
+ *        checkはレコードの残りのFNV-1a(64-bit)で、書きかけのレコードを読み飛ばす
+ *        同じ(dev, ino, algorithm)のレコードは後のものが優先される
+ * @note  並行して使う場合
+ *          読み込み: 開いた時点のファイルをmmapして索引を作り、以後ロックしない
+ *                    (追記中の末尾はcheckで、置き換えは古いinodeのまま読める)
+ *          追記    : flock(LOCK_EX)の下でレコード単位に書き足す
+ *          整理    : 最新のレコードだけを別のファイルに書き、renameで置き換える
+ *                    追記する側は、ロックを取った後にパスのinodeを確かめ、
+ *                    置き換えられていれば開き直す
+ * @note  更新時刻の解像度の範囲内で書き換えられたファイル(racy)を誤って
+ *        キャッシュしないよう、更新時刻がracy_window以内のファイルは記録しない
+ *        また計算の前後でキーが変わったファイルも記録しない
+ */
+
+#ifndef DIGEST_CACHE_HPP
+#define DIGEST_CACHE_HPP
+
+#include "sha1/sha1.hpp"
+#include "sha2/sha2.hpp"
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <mutex>
+#include <string>
+#include <system_error>
+#include <unordered_map>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/**
+ * @brief キャッシュのキーとするアルゴリズムの番号(shasum -aと同じ表記)
+ */
+template <class Hasher> struct CacheAlgorithm;
+template <> struct CacheAlgorithm<SHA1> {
+  static constexpr std::uint32_t id = 1;
+};
+template <> struct CacheAlgorithm<SHA224> {
+  static constexpr std::uint32_t id = 224;
+};
+template <> struct CacheAlgorithm<SHA256> {
+  static constexpr std::uint32_t id = 256;
+};
+template <> struct CacheAlgorithm<SHA384> {
+  static constexpr std::uint32_t id = 384;
+};
+template <> struct CacheAlgorithm<SHA512> {
+  static constexpr std::uint32_t id = 512;
+};
+template <> struct CacheAlgorithm<SHA512_224> {
+  static constexpr std::uint32_t id = 512224;
+};
+template <> struct CacheAlgorithm<SHA512_256> {
+  static constexpr std::uint32_t id = 512256;
+};
+
+class DigestCache {
+public:
+  /**< @brief 記録できるハッシュ値の最大のbyte数 */
+  static constexpr std::size_t max_digest_size = 64;
+
+  /**< @brief 更新時刻が現在からこの範囲内(ns)のファイルは記録しない */
+  static constexpr std::int64_t racy_window = 2000000000;
+
+  /**< @brief 追記を溜めておくレコード数 */
+  static constexpr std::size_t flush_records = 512;
+
+  /**< @brief 開いたときに整理する条件(レコード数が有効なものの2倍を超える) */
+  static constexpr std::size_t compact_min_records = 1024;
+
+  /**
+   * @brief  キャッシュのファイルを開き(なければ作り)、索引を作る
+   * @param  const std::string& path キャッシュのファイルのパス
+   * @param  bool rehash             真ならlookup()は常に失敗する(記録はする)
+   * @note   開けなければstd::system_errorを送出する
+   *         形式の異なるファイルは空のキャッシュとして作り直す
+   */
+  explicit DigestCache(const std::string &path, bool rehash = false)
+      : path(path), rehash(rehash) {
+    open();
+    try {
+      load();
+    } catch (const std::system_error &) {
+      ::close(fd);
+      throw;
+    }
+    if (records >= compact_min_records && records > 2 * index.size()) {
+      try {
+        compact();
+      } catch (const std::system_error &) {
+        // 整理できなくても(ディレクトリに書けないなど)、そのまま使える
+      }
+    }
+  }
+
+  DigestCache(const DigestCache &) = delete;
+  DigestCache &operator=(const DigestCache &) = delete;
+
+  ~DigestCache() {
+    flush();
+    unmap();
+    ::close(fd);
+  }
+
+  /**
+   * @brief  記録されたハッシュ値を探す
+   * @param  const struct stat& st ファイルのstat()の結果
+   * @param  std::uint8_t* digest  ハッシュ値の書き込み先(len byte)
+   * @return (dev, ino, size, mtime, algorithm)が一致する記録があればtrue
+   * @note   開いた時点の記録だけを探す。複数のスレッドから呼び出してよい
+   */
+  bool lookup(const struct stat &st, std::uint32_t algorithm,
+              std::uint8_t *digest, std::size_t len) const {
+    if (!rehash) {
+      const Key k = key_of(st);
+      const auto it = index.find(Slot{k.dev, k.ino, algorithm});
+      if (it != index.end() && it->second->size == k.size &&
+          it->second->mtime_ns == k.mtime_ns && it->second->length == len) {
+        std::memcpy(digest, it->second->digest, len);
+        hit_count++;
+        return true;
+      }
+    }
+    miss_count++;
+    return false;
+  }
+
+  /**
+   * @brief  ハッシュ値を記録する(flush_records個ごとにファイルへ書き足す)
+   * @note   更新時刻が新しすぎる(racy_window以内)ファイルは記録しない
+   *         複数のスレッドから呼び出してよい
+   */
+  void insert(const struct stat &st, std::uint32_t algorithm,
+              const std::uint8_t *digest, std::size_t len) {
+    const Key k = key_of(st);
+    if (len > max_digest_size || k.mtime_ns + racy_window > now_ns()) {
+      return;
+    }
+    Record r{};
+    r.dev = k.dev;
+    r.ino = k.ino;
+    r.size = k.size;
+    r.mtime_ns = k.mtime_ns;
+    r.algorithm = algorithm;
+    r.length = static_cast<std::uint32_t>(len);
+    std::memcpy(r.digest, digest, len);
+    r.check = checksum(r);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    pending.push_back(r);
+    if (pending.size() >= flush_records) {
+      append();
+    }
+  }
+
+  /**
+   * @brief  溜めておいたレコードをファイルに書き足す
+   * @return 書き込みに失敗すればfalse(溜めておいたレコードは捨てる)
+   */
+  bool flush() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return append();
+  }
+
+  /**
+   * @brief  最新のレコードだけを残したファイルに置き換える
+   * @note   失敗すればstd::system_errorを送出する
+   */
+  void compact() {
+    std::lock_guard<std::mutex> lock(mutex);
+    append();
+    lock_current();
+
+    // ロックしている間は誰も追記しないので、全体を読み直してから書き出す
+    std::vector<Record> live;
+    try {
+      DigestCache snapshot(fd, path);
+      live.reserve(snapshot.index.size());
+      for (auto &&e : snapshot.index) {
+        live.push_back(*e.second);
+      }
+    } catch (const std::system_error &) {
+      ::flock(fd, LOCK_UN);
+      throw;
+    }
+    replace(live);
+  }
+
+  /**< @brief 索引にある(有効な)記録の個数 */
+  std::size_t size() const { return index.size(); }
+
+  /**< @brief lookup()が成功した回数 */
+  std::uint64_t hits() const { return hit_count; }
+
+  /**< @brief lookup()が失敗した回数 */
+  std::uint64_t misses() const { return miss_count; }
+
+private:
+  struct Header {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t record_size;
+    std::uint8_t reserved[48];
+  };
+
+  struct Record {
+    std::uint64_t dev;
+    std::uint64_t ino;
+    std::uint64_t size;
+    std::int64_t mtime_ns;
+    std::uint32_t algorithm;
+    std::uint32_t length;
+    std::uint8_t digest[max_digest_size];
+    std::uint64_t check;
+  };
+  static_assert(sizeof(Header) == 64 && sizeof(Record) == 112);
+
+  struct Key {
+    std::uint64_t dev;
+    std::uint64_t ino;
+    std::uint64_t size;
+    std::int64_t mtime_ns;
+  };
+
+  /**< @brief 索引のキー(ファイルの実体とアルゴリズム) */
+  struct Slot {
+    std::uint64_t dev;
+    std::uint64_t ino;
+    std::uint32_t algorithm;
+
+    bool operator==(const Slot &rhs) const {
+      return dev == rhs.dev && ino == rhs.ino && algorithm == rhs.algorithm;
+    }
+  };
+
+  struct SlotHash {
+    std::size_t operator()(const Slot &s) const {
+      std::uint64_t h = s.ino * 0x9e3779b97f4a7c15;
+      h ^= (s.dev + s.algorithm) * 0xbf58476d1ce4e5b9;
+      return static_cast<std::size_t>(h ^ (h >> 31));
+    }
+  };
+
+  /**
+   * @brief  compact()で、ロックしているファイル全体を読み直すためのもの
+   */
+  DigestCache(int descriptor, const std::string &path)
+      : path(path), fd(::dup(descriptor)) {
+    if (fd < 0) {
+      throw std::system_error(errno, std::generic_category(), path);
+    }
+    try {
+      load();
+    } catch (const std::system_error &) {
+      ::close(fd);
+      throw;
+    }
+  }
+
+  static Key key_of(const struct stat &st) {
+    return Key{static_cast<std::uint64_t>(st.st_dev),
+               static_cast<std::uint64_t>(st.st_ino),
+               static_cast<std::uint64_t>(st.st_size),
+               static_cast<std::int64_t>(st.st_mtim.tv_sec) * 1000000000 +
+                   st.st_mtim.tv_nsec};
+  }
+
+  static std::int64_t now_ns() {
+    struct timespec ts;
+    ::clock_gettime(CLOCK_REALTIME, &ts);
+    return static_cast<std::int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+  }
+
+  static Header header() {
+    Header h{};
+    std::memcpy(h.magic, "SHADCACH", 8);
+    h.version = 1;
+    h.record_size = sizeof(Record);
+    return h;
+  }
+
+  static std::uint64_t checksum(const Record &r) {
+    const auto *p = reinterpret_cast<const std::uint8_t *>(&r);
+    std::uint64_t h = 0xcbf29ce484222325;
+    for (std::size_t i = 0; i < offsetof(Record, check); i++) {
+      h = (h ^ p[i]) * 0x100000001b3;
+    }
+    return h;
+  }
+
+  static bool write_all(int fd, const void *data, std::size_t len) {
+    const auto *p = static_cast<const std::uint8_t *>(data);
+    while (len > 0) {
+      const ssize_t n = ::write(fd, p, len);
+      if (n < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        return false;
+      }
+      p += n;
+      len -= static_cast<std::size_t>(n);
+    }
+    return true;
+  }
+
+  void open() {
+    fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (fd < 0) {
+      throw std::system_error(errno, std::generic_category(), path);
+    }
+  }
+
+  /**
+   * @brief  開いた時点のファイルをマップし、レコードの索引を作る
+   */
+  void load() {
+    struct stat st;
+    if (::fstat(fd, &st) < 0) {
+      throw std::system_error(errno, std::generic_category(), path);
+    }
+    if (st.st_size < static_cast<off_t>(sizeof(Header))) {
+      return;
+    }
+    len = static_cast<std::size_t>(st.st_size);
+    void *p = ::mmap(nullptr, len, PROT_READ, MAP_SHARED, fd, 0);
+    if (p == MAP_FAILED) {
+      len = 0;
+      throw std::system_error(errno, std::generic_category(), path);
+    }
+    addr = static_cast<const std::uint8_t *>(p);
+
+    if (!valid_header(addr)) {
+      // 形式が異なれば、空のキャッシュとみなす(次の追記で作り直す)
+      return;
+    }
+    const auto *r = reinterpret_cast<const Record *>(addr + sizeof(Header));
+    records = (len - sizeof(Header)) / sizeof(Record);
+    index.reserve(records);
+    for (std::size_t i = 0; i < records; i++) {
+      if (r[i].length <= max_digest_size && r[i].check == checksum(r[i])) {
+        index[Slot{r[i].dev, r[i].ino, r[i].algorithm}] = &r[i];
+      }
+    }
+  }
+
+  void unmap() {
+    if (addr != nullptr) {
+      ::munmap(const_cast<std::uint8_t *>(addr), len);
+      addr = nullptr;
+    }
+  }
+
+  /**
+   * @brief  パスが指している現在のファイルを開き、排他ロックを取る
+   * @note   ロックを待つ間にcompact()で置き換えられていれば開き直す
+   */
+  void lock_current() {
+    for (;;) {
+      while (::flock(fd, LOCK_EX) < 0) {
+        if (errno != EINTR) {
+          throw std::system_error(errno, std::generic_category(), path);
+        }
+      }
+      struct stat a, b;
+      if (::fstat(fd, &a) == 0 && ::stat(path.c_str(), &b) == 0 &&
+          a.st_dev == b.st_dev && a.st_ino == b.st_ino) {
+        return;
+      }
+      const int old = fd;
+      open();
+      ::close(old);
+    }
+  }
+
+  static bool valid_header(const void *p) {
+    const Header h = header();
+    return std::memcmp(p, &h, offsetof(Header, reserved)) == 0;
+  }
+
+  /**
+   * @brief  ヘッダとレコードだけからなるファイルを作り、パスを置き換える
+   * @note   lock_current()で排他ロックを取った状態で呼び、ロックは外れる
+   *         置き換えた後は新しいファイルに追記する
+   *         (索引は古いファイルのマップを指したまま使い続ける)
+   */
+  void replace(const std::vector<Record> &live) {
+    const std::string tmp = path + ".tmp." + std::to_string(::getpid());
+    const int out =
+        ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (out < 0) {
+      const int err = errno;
+      ::flock(fd, LOCK_UN);
+      throw std::system_error(err, std::generic_category(), tmp);
+    }
+    const Header h = header();
+    bool ok = write_all(out, &h, sizeof(h)) &&
+              write_all(out, live.data(), live.size() * sizeof(Record)) &&
+              ::fsync(out) == 0;
+    int err = errno;
+    ok = ::close(out) == 0 && ok;
+    if (ok && ::rename(tmp.c_str(), path.c_str()) != 0) {
+      err = errno;
+      ok = false;
+    }
+    if (!ok) {
+      ::unlink(tmp.c_str());
+      ::flock(fd, LOCK_UN);
+      throw std::system_error(err, std::generic_category(), path);
+    }
+    // 古いファイルを閉じてロックを外すと、待っていた追記は置き換えに気づく
+    const int old = fd;
+    open();
+    ::close(old);
+    records = live.size();
+  }
+
+  /**
+   * @brief  溜めておいたレコードを書き足す(mutexを取った状態で呼ぶ)
+   */
+  bool append() {
+    if (pending.empty()) {
+      return true;
+    }
+    std::vector<Record> batch;
+    batch.swap(pending);
+    try {
+      lock_current();
+      struct stat st;
+      Header h;
+      if (::fstat(fd, &st) < 0) {
+        ::flock(fd, LOCK_UN);
+        return false;
+      }
+      if (st.st_size != 0 &&
+          (::pread(fd, &h, sizeof(h), 0) != static_cast<ssize_t>(sizeof(h)) ||
+           !valid_header(&h))) {
+        // 書きかけのヘッダ、あるいは形式の異なるファイルは置き換える
+        // (その場で切り詰めると、マップしている他のプロセスを壊す)
+        replace(batch);
+        return true;
+      }
+
+      std::vector<std::uint8_t> buf;
+      if (st.st_size == 0) {
+        h = header();
+        buf.assign(reinterpret_cast<const std::uint8_t *>(&h),
+                   reinterpret_cast<const std::uint8_t *>(&h + 1));
+      } else {
+        // 書きかけのレコードがあれば、その残りを埋めて境界を揃える
+        const std::size_t rest =
+            (static_cast<std::size_t>(st.st_size) - sizeof(Header)) %
+            sizeof(Record);
+        buf.assign(rest == 0 ? 0 : sizeof(Record) - rest, 0);
+      }
+      const auto *p = reinterpret_cast<const std::uint8_t *>(batch.data());
+      buf.insert(buf.end(), p, p + batch.size() * sizeof(Record));
+      const bool ok = write_all(fd, buf.data(), buf.size());
+      ::flock(fd, LOCK_UN);
+      records += batch.size();
+      return ok;
+    } catch (const std::system_error &) {
+      return false;
+    }
+  }
+
+  std::string path;
+  bool rehash = false;
+  int fd = -1;
+
+  /**< @brief 開いた時点のファイルのマップ(索引はここを指す) */
+  const std::uint8_t *addr = nullptr;
+  std::size_t len = 0;
+
+  /**< @brief ファイルのレコード数(無効なもの、古いものを含む) */
+  std::size_t records = 0;
+
+  std::unordered_map<Slot, const Record *, SlotHash> index;
+
+  std::mutex mutex;
+  std::vector<Record> pending;
+
+  mutable std::atomic<std::uint64_t> hit_count{0};
+  mutable std::atomic<std::uint64_t> miss_count{0};
+};
+
+/**
+ * @brief  キャッシュを使ってファイルのハッシュ値を求める
+ * @param  DigestCache* cache      キャッシュ(nullptrなら常に計算する)
+ * @param  const std::string& path ファイルのパス(通常のファイル以外は常に計算する)
+ * @param  Compute&& compute       ハッシュ値を計算する関数
+ * @note   計算の前後でファイルのキーが変われば記録しない
+ */
+template <class Hasher, class Compute>
+typename Hasher::digest_type hash_cached(DigestCache *cache,
+                                         const std::string &path,
+                                         Compute &&compute) {
+  constexpr std::uint32_t id = CacheAlgorithm<Hasher>::id;
+  struct stat before;
+  if (cache == nullptr || ::stat(path.c_str(), &before) != 0 ||
+      !S_ISREG(before.st_mode)) {
+    return compute();
+  }
+  typename Hasher::digest_type M;
+  if (cache->lookup(before, id, M.data(), M.size())) {
+    return M;
+  }
+  M = compute();
+  struct stat after;
+  if (::stat(path.c_str(), &after) == 0 && after.st_dev == before.st_dev &&
+      after.st_ino == before.st_ino && after.st_size == before.st_size &&
+      after.st_mtim.tv_sec == before.st_mtim.tv_sec &&
+      after.st_mtim.tv_nsec == before.st_mtim.tv_nsec) {
+    cache->insert(before, id, M.data(), M.size());
+  }
+  return M;
+}
+
+#endif // end of DIGEST_CACHE_HPP
@@ -0,0 +1,623 @@
+/**
+ * @brief 複数のバッファを先行して読み込み、ディスクのI/Oとハッシュ計算を重ねる
+ * @note  Linuxのio_uring(liburingは使わず、システムコールを直接呼ぶ)でdepth個の
+ *        バッファの読み込みを常に発行しておき、読み終えたバッファをファイルの順に
+ *        hasher.update()へ渡して、計算を終えたバッファで次の区間を読む
+ *        io_uringが使えない(古いカーネル、無効化されている)場合や、パイプなどの
+ *        通常のファイルでない場合は、読み込み用のスレッドがread()でバッファを埋める
+ *        O_DIRECTを指定するとページキャッシュを経由せずに読む(NVMeの帯域を出す)
+ *        O_DIRECTに対応しないファイルシステムでは通常の読み込みに戻る
+ * @note  終端はread()が0を返したところとする。fstat()の大きさは先読みする範囲を
+ *        決めるだけに使うので、大きさが0と報告される/procや/sysのファイル、
+ *        読んでいる間に伸び縮みするファイルも、最後まで読む
+ */
+
+#ifndef FILE_PIPELINE_HPP
+#define FILE_PIPELINE_HPP
+
+#include <algorithm>
+#include <cerrno>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+/**
+ * @brief 読み込みの方式
+ */
+enum class ReadEngine {
+  Auto,    /**< 使えればio_uring、それ以外は読み込み用のスレッド */
+  IoUring, /**< io_uring(使えなければ読み込み用のスレッド) */
+  Thread,  /**< 読み込み用のスレッドとread() */
+};
+
+/**
+ * @brief  読み込みの方式の名前
+ */
+inline const char *engine_name(ReadEngine e) {
+  switch (e) {
+  case ReadEngine::IoUring:
+    return "io_uring";
+  case ReadEngine::Thread:
+    return "thread";
+  default:
+    return "auto";
+  }
+}
+
+/**
+ * @brief FilePipelineの設定
+ */
+struct PipelineConfig {
+  /**< @brief 1つのバッファの大きさ(FilePipeline::alignmentの倍数に切り上げる) */
+  std::size_t buffer_size = std::size_t(1) << 20;
+
+  /**< @brief 同時に読み込むバッファの数 */
+  std::size_t depth = 4;
+
+  /**< @brief O_DIRECTで開き、ページキャッシュを経由せずに読むか */
+  bool direct = false;
+
+  /**< @brief 読み込みの方式 */
+  ReadEngine engine = ReadEngine::Auto;
+};
+
+/**
+ * @brief  pread()と同じ形の関数で、区間をn byteまで、あるいは終端まで埋める
+ * @param  Read&& read     read(p, n, off)で読み込み、byte数(失敗したら-errno)を返す
+ * @param  Unaligned&& unaligned 位置がalignの倍数でなくなった後に使う読み込み
+ *         (O_DIRECTで短く返った残りを、O_DIRECTでない方で読むためのもの)
+ * @param  std::uint8_t* p 区間の先頭(have byteは読み込み済み)
+ * @param  std::uint64_t off 区間の先頭のファイル上の位置
+ * @param  std::size_t align p, n, offの境界(p + have, n - have, off + haveが全て
+ *         alignの倍数である間はreadを使う)
+ * @return 区間の先頭から読み込めたbyte数(nに満たなければ終端、失敗したら-errno)
+ * @note   p, n, offはalignの倍数であること
+ */
+template <class Read, class Unaligned>
+long long read_range(Read &&read, Unaligned &&unaligned, std::uint8_t *p,
+                     std::size_t n, std::uint64_t off, std::size_t have,
+                     std::size_t align) {
+  while (have < n) {
+    const long long r = have % align == 0
+                            ? read(p + have, n - have, off + have)
+                            : unaligned(p + have, n - have, off + have);
+    if (r == -EINTR) {
+      continue;
+    }
+    if (r <= 0) {
+      return r < 0 ? r : static_cast<long long>(have);
+    }
+    have += static_cast<std::size_t>(r);
+  }
+  return static_cast<long long>(have);
+}
+
+/**
+ * @brief 読み込みだけを行う最小限のio_uring
+ * @note  提出キュー(SQ)と完了キュー(CQ)をmmapし、io_uring_setupと
+ *        io_uring_enterをsyscall()で呼び出す
+ *        IORING_OP_READV(Linux 5.1以降)だけを使う
+ */
+class IoUring {
+public:
+  /**
+   * @param  unsigned entries キューの長さ
+   * @note   作れなければstd::system_errorを送出する
+   */
+  explicit IoUring(unsigned entries) {
+    io_uring_params p;
+    std::memset(&p, 0, sizeof(p));
+    fd = static_cast<int>(::syscall(__NR_io_uring_setup, entries, &p));
+    if (fd < 0) {
+      throw std::system_error(errno, std::generic_category(), "io_uring");
+    }
+
+    sq_len = p.sq_off.array + p.sq_entries * sizeof(std::uint32_t);
+    cq_len = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+      sq_len = cq_len = std::max(sq_len, cq_len);
+    }
+    sqes_len = p.sq_entries * sizeof(io_uring_sqe);
+    sq_ptr = map(sq_len, IORING_OFF_SQ_RING);
+    cq_ptr = (p.features & IORING_FEAT_SINGLE_MMAP)
+                 ? sq_ptr
+                 : map(cq_len, IORING_OFF_CQ_RING);
+    sqes = static_cast<io_uring_sqe *>(map(sqes_len, IORING_OFF_SQES));
+    if (sq_ptr == nullptr || cq_ptr == nullptr || sqes == nullptr) {
+      const int err = errno;
+      release();
+      throw std::system_error(err, std::generic_category(), "io_uring");
+    }
+
+    auto *sq = static_cast<std::uint8_t *>(sq_ptr);
+    auto *cq = static_cast<std::uint8_t *>(cq_ptr);
+    sq_tail = reinterpret_cast<unsigned *>(sq + p.sq_off.tail);
+    sq_mask = *reinterpret_cast<unsigned *>(sq + p.sq_off.ring_mask);
+    sq_array = reinterpret_cast<unsigned *>(sq + p.sq_off.array);
+    cq_head = reinterpret_cast<unsigned *>(cq + p.cq_off.head);
+    cq_tail = reinterpret_cast<unsigned *>(cq + p.cq_off.tail);
+    cq_mask = *reinterpret_cast<unsigned *>(cq + p.cq_off.ring_mask);
+    cqes = reinterpret_cast<io_uring_cqe *>(cq + p.cq_off.cqes);
+  }
+
+  IoUring(const IoUring &) = delete;
+  IoUring &operator=(const IoUring &) = delete;
+
+  ~IoUring() { release(); }
+
+  /**
+   * @brief  実行中のカーネルでio_uringが使えるか判定する(結果は保存する)
+   */
+  static bool supported() {
+    static const bool ok = [] {
+      try {
+        IoUring ring(1);
+        return true;
+      } catch (const std::system_error &) {
+        return false;
+      }
+    }();
+    return ok;
+  }
+
+  /**
+   * @brief  読み込みを1つ提出キューに積む(submit()まで発行しない)
+   * @param  std::uint64_t user_data 完了時にreap()へ渡される値
+   * @note   iovは完了するまで有効であること
+   */
+  void readv(int file, const iovec *iov, std::uint64_t off,
+             std::uint64_t user_data) {
+    const unsigned tail = *sq_tail;
+    const unsigned i = tail & sq_mask;
+    io_uring_sqe &e = sqes[i];
+    std::memset(&e, 0, sizeof(e));
+    e.opcode = IORING_OP_READV;
+    e.fd = file;
+    e.addr = reinterpret_cast<std::uint64_t>(iov);
+    e.len = 1;
+    e.off = off;
+    e.user_data = user_data;
+    sq_array[i] = i;
+    __atomic_store_n(sq_tail, tail + 1, __ATOMIC_RELEASE);
+    pending++;
+  }
+
+  /**
+   * @brief  積んだ読み込みを発行し、少なくともmin_complete個の完了を待つ
+   */
+  void submit(unsigned min_complete = 0) {
+    for (;;) {
+      const long r = ::syscall(__NR_io_uring_enter, fd, pending, min_complete,
+                               min_complete > 0 ? IORING_ENTER_GETEVENTS : 0,
+                               nullptr, 0);
+      if (r >= 0) {
+        pending -= static_cast<unsigned>(r);
+        return;
+      }
+      if (errno != EINTR) {
+        throw std::system_error(errno, std::generic_category(), "io_uring");
+      }
+    }
+  }
+
+  /**
+   * @brief  完了キューの全ての完了についてf(user_data, res)を呼び出す
+   * @note   resは読み込んだbyte数、失敗した場合は-errno
+   */
+  template <class F> void reap(F &&f) {
+    unsigned head = *cq_head;
+    const unsigned tail = __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE);
+    for (; head != tail; head++) {
+      const io_uring_cqe &c = cqes[head & cq_mask];
+      f(c.user_data, c.res);
+    }
+    __atomic_store_n(cq_head, head, __ATOMIC_RELEASE);
+  }
+
+private:
+  /**
+   * @brief  キューをマップする(失敗したらnullptr)
+   */
+  void *map(std::size_t len, off_t offset) {
+    void *p = ::mmap(nullptr, len, PROT_READ | PROT_WRITE,
+                     MAP_SHARED | MAP_POPULATE, fd, offset);
+    return p != MAP_FAILED ? p : nullptr;
+  }
+
+  void release() {
+    if (sqes != nullptr) {
+      ::munmap(sqes, sqes_len);
+    }
+    if (cq_ptr != nullptr && cq_ptr != sq_ptr) {
+      ::munmap(cq_ptr, cq_len);
+    }
+    if (sq_ptr != nullptr) {
+      ::munmap(sq_ptr, sq_len);
+    }
+    ::close(fd);
+  }
+
+  int fd = -1;
+  void *sq_ptr = nullptr;
+  void *cq_ptr = nullptr;
+  io_uring_sqe *sqes = nullptr;
+  std::size_t sq_len = 0;
+  std::size_t cq_len = 0;
+  std::size_t sqes_len = 0;
+  unsigned *sq_tail = nullptr;
+  unsigned sq_mask = 0;
+  unsigned *sq_array = nullptr;
+  unsigned *cq_head = nullptr;
+  unsigned *cq_tail = nullptr;
+  unsigned cq_mask = 0;
+  io_uring_cqe *cqes = nullptr;
+
+  /**< @brief 積んだがまだ発行していない読み込みの数 */
+  unsigned pending = 0;
+};
+
+/**
+ * @brief 先行読み込みでファイルをハッシュ関数へ渡すパイプライン
+ */
+class FilePipeline {
+public:
+  /**< @brief バッファの境界と大きさの単位(O_DIRECTの要件) */
+  static constexpr std::size_t alignment = 4096;
+
+  /**
+   * @brief  ファイルを開き、読み込みの方式とバッファを決める
+   * @param  const std::string& path ファイルのパス
+   * @note   開けなければstd::system_errorを送出する
+   */
+  explicit FilePipeline(const std::string &path,
+                        const PipelineConfig &config = PipelineConfig())
+      : name(path),
+        buffer_size(std::max<std::size_t>(
+            (config.buffer_size + alignment - 1) / alignment * alignment,
+            alignment)),
+        depth(std::max<std::size_t>(config.depth, 2)) {
+    if (config.direct) {
+      fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC | O_DIRECT);
+      use_direct = fd >= 0;
+    }
+    if (fd < 0) {
+      fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    }
+    if (fd < 0) {
+      throw std::system_error(errno, std::generic_category(), path);
+    }
+    struct stat st;
+    if (::fstat(fd, &st) < 0) {
+      const int err = errno;
+      ::close(fd);
+      throw std::system_error(err, std::generic_category(), path);
+    }
+    regular = S_ISREG(st.st_mode);
+    len = regular ? static_cast<std::uint64_t>(st.st_size) : 0;
+
+    use_engine = config.engine != ReadEngine::Thread && regular &&
+                         IoUring::supported()
+                     ? ReadEngine::IoUring
+                     : ReadEngine::Thread;
+    if (!use_direct) {
+      ::posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    }
+    buffers.reset(static_cast<std::uint8_t *>(
+        std::aligned_alloc(alignment, buffer_size * depth)));
+    if (buffers == nullptr) {
+      ::close(fd);
+      throw std::bad_alloc();
+    }
+  }
+
+  FilePipeline(const FilePipeline &) = delete;
+  FilePipeline &operator=(const FilePipeline &) = delete;
+
+  ~FilePipeline() {
+    ::close(fd);
+    if (unaligned_fd >= 0) {
+      ::close(unaligned_fd);
+    }
+  }
+
+  /**
+   * @brief  実際に使う読み込みの方式(IoUringまたはThread)
+   */
+  ReadEngine engine() const { return use_engine; }
+
+  /**
+   * @brief  O_DIRECTで開けたか判定する
+   */
+  bool direct() const { return use_direct; }
+
+  /**
+   * @brief  ファイルを終端まで読み込み、ファイルの順にhasher.update()に渡す
+   * @return 読み込んだbyte数
+   * @note   読み込みに失敗するとstd::system_errorを送出する
+   */
+  template <class Hasher> std::uint64_t feed(Hasher &hasher) {
+    return use_engine == ReadEngine::IoUring ? feed_uring(hasher)
+                                             : feed_thread(hasher);
+  }
+
+private:
+  struct Free {
+    void operator()(std::uint8_t *p) const { std::free(p); }
+  };
+
+  std::uint8_t *buffer(std::size_t i) {
+    return buffers.get() + i * buffer_size;
+  }
+
+  /**
+   * @brief  バッファpを、offからn byteまたは終端まで埋める(have byteは読み込み済み)
+   * @return 読み込んだbyte数(失敗したら-errno)
+   * @note   O_DIRECTで短く返り、境界に揃わなくなった残りは
+   *         O_DIRECTでなく開き直したファイルディスクリプタで読む
+   */
+  long long read_full(std::uint8_t *p, std::size_t n, std::uint64_t off,
+                      std::size_t have = 0) {
+    const auto at = [](int file) {
+      return [file](std::uint8_t *q, std::size_t m,
+                    std::uint64_t pos) -> long long {
+        if (file < 0) {
+          return -errno;
+        }
+        const ssize_t r = ::pread(file, q, m, static_cast<off_t>(pos));
+        return r < 0 ? -errno : r;
+      };
+    };
+    if (!use_direct) {
+      return read_range(at(fd), at(fd), p, n, off, have, 1);
+    }
+    return read_range(
+        at(fd),
+        [&](std::uint8_t *q, std::size_t m, std::uint64_t pos) {
+          return at(reopen())(q, m, pos);
+        },
+        p, n, off, have, alignment);
+  }
+
+  /**
+   * @brief  O_DIRECTでなく開き直したファイルディスクリプタ(失敗したら-1)
+   * @note   パスが変わっていても同じファイルを開くよう、/proc/self/fdを使う
+   */
+  int reopen() {
+    if (unaligned_fd < 0) {
+      const std::string self = "/proc/self/fd/" + std::to_string(fd);
+      unaligned_fd = ::open(self.c_str(), O_RDONLY | O_CLOEXEC);
+      if (unaligned_fd < 0) {
+        unaligned_fd = ::open(name.c_str(), O_RDONLY | O_CLOEXEC);
+      }
+    }
+    return unaligned_fd;
+  }
+
+  /**
+   * @brief  ファイルの現在位置からn byteまたは終端まで読み込む(パイプなど)
+   * @return 読み込んだbyte数(失敗したら-errno)
+   */
+  long long read_stream(std::uint8_t *p, std::size_t n) {
+    const auto next = [this](std::uint8_t *q, std::size_t m,
+                             std::uint64_t) -> long long {
+      const ssize_t r = ::read(fd, q, m);
+      return r < 0 ? -errno : r;
+    };
+    return read_range(next, next, p, n, 0, 0, 1);
+  }
+
+  /**
+   * @brief  io_uringでdepth個の区間を読み込みながら計算する
+   * @note   完了は順不同に届くので、次に計算するバッファが揃うまで待つ
+   *         先読みはfstat()の大きさを含む区間までとし、それより先(伸びたファイル、
+   *         大きさが0の/procのファイル)は1つずつ読む
+   *         短く返ったバッファは同期的に埋め、埋まらなければ終端とする
+   *         失敗したら発行済みの読み込みが全て完了するのを待ってから送出する
+   */
+  template <class Hasher> std::uint64_t feed_uring(Hasher &hasher) {
+    IoUring ring(static_cast<unsigned>(depth));
+    std::vector<iovec> iov(depth);
+    std::vector<std::uint64_t> offset(depth);
+    std::vector<long long> result(depth);
+    std::vector<char> done(depth);
+    std::vector<char> busy(depth); // 発行してから計算を終えるまで
+    std::size_t inflight = 0;
+    std::uint64_t next = 0;
+
+    // 発行済みのバッファは、計算する順に連続した区間を読んでいる
+    const auto issue = [&](std::size_t i, std::uint64_t off) {
+      iov[i] = iovec{buffer(i), buffer_size};
+      offset[i] = off;
+      done[i] = false;
+      busy[i] = true;
+      ring.readv(fd, &iov[i], off, i);
+      inflight++;
+    };
+    const auto complete = [&](std::uint64_t i, std::int32_t res) {
+      result[i] = res;
+      done[i] = true;
+      inflight--;
+    };
+
+    for (std::size_t i = 0; i < depth && next <= len; i++) {
+      issue(i, next);
+      next += buffer_size;
+    }
+    ring.submit();
+
+    std::uint64_t total = 0;
+    int error = 0;
+    for (std::size_t i = 0;; i = (i + 1) % depth) {
+      // 先読みしていなければ(fstat()の大きさより先)、ここで発行する
+      if (!busy[i]) {
+        issue(i, next);
+        next += buffer_size;
+        ring.submit();
+      }
+
+      // 次に計算するバッファが揃うまで待ち、割り込まれた読み込みは発行し直す
+      for (;;) {
+        while (!done[i]) {
+          ring.submit(1);
+          ring.reap(complete);
+        }
+        if (result[i] != -EINTR && result[i] != -EAGAIN) {
+          break;
+        }
+        issue(i, offset[i]);
+      }
+      if (result[i] < 0) {
+        error = static_cast<int>(-result[i]);
+        break;
+      }
+
+      // 短く返ったら、残りを同期的に読む(埋まらなければ終端)
+      auto n = static_cast<std::size_t>(result[i]);
+      if (n < buffer_size) {
+        const long long r = read_full(buffer(i), buffer_size, offset[i], n);
+        if (r < 0) {
+          error = static_cast<int>(-r);
+          break;
+        }
+        n = static_cast<std::size_t>(r);
+      }
+      hasher.update(buffer(i), n);
+      total += n;
+      busy[i] = false;
+      if (n < buffer_size) {
+        break;
+      }
+      if (next <= len) {
+        issue(i, next);
+        next += buffer_size;
+        ring.submit();
+      }
+    }
+
+    // 発行済みの読み込みがバッファに書き込まなくなるまで待つ
+    while (inflight > 0) {
+      ring.submit(1);
+      ring.reap(complete);
+    }
+    if (error != 0) {
+      throw std::system_error(error, std::generic_category(), name);
+    }
+    return total;
+  }
+
+  /**
+   * @brief  読み込み用のスレッドがバッファを順に埋め、呼び出し元が計算する
+   * @note   バッファがbuffer_sizeに満たなければ終端とする
+   */
+  template <class Hasher> std::uint64_t feed_thread(Hasher &hasher) {
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::vector<std::size_t> filled(depth);
+    std::size_t produced = 0;
+    std::size_t consumed = 0;
+    bool stop = false;
+    int error = 0;
+
+    std::thread reader([&] {
+      for (std::size_t k = 0;; k++) {
+        {
+          std::unique_lock<std::mutex> lock(mutex);
+          cv.wait(lock, [&] { return k - consumed < depth || stop; });
+          if (stop) {
+            return;
+          }
+        }
+        const std::size_t i = k % depth;
+        const long long r =
+            regular ? read_full(buffer(i), buffer_size, k * buffer_size)
+                    : read_stream(buffer(i), buffer_size);
+        {
+          std::lock_guard<std::mutex> lock(mutex);
+          if (r < 0) {
+            error = static_cast<int>(-r);
+          } else {
+            filled[i] = static_cast<std::size_t>(r);
+            produced = k + 1;
+          }
+        }
+        cv.notify_all();
+        if (r < static_cast<long long>(buffer_size)) {
+          return;
+        }
+      }
+    });
+
+    std::uint64_t total = 0;
+    for (std::size_t k = 0;; k++) {
+      std::size_t n;
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        cv.wait(lock, [&] { return produced > k || error != 0; });
+        if (produced <= k) {
+          break;
+        }
+        n = filled[k % depth];
+      }
+      hasher.update(buffer(k % depth), n);
+      total += n;
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        consumed = k + 1;
+      }
+      cv.notify_all();
+      if (n < buffer_size) {
+        break;
+      }
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      stop = true;
+    }
+    cv.notify_all();
+    reader.join();
+    if (error != 0) {
+      throw std::system_error(error, std::generic_category(), name);
+    }
+    return total;
+  }
+
+  std::string name;
+  std::size_t buffer_size;
+  std::size_t depth;
+  int fd = -1;
+  int unaligned_fd = -1; // O_DIRECTで短く返った残りを読むためのもの
+  bool use_direct = false;
+  bool regular = false;
+  std::uint64_t len = 0; // fstat()の大きさ(先読みの範囲にだけ使う)
+  ReadEngine use_engine = ReadEngine::Thread;
+  std::unique_ptr<std::uint8_t, Free> buffers;
+};
+
+/**
+ * @brief  ファイルをFilePipelineで読み込み、hasherに渡す
+ * @return 読み込んだbyte数
+ */
+template <class Hasher>
+std::uint64_t feed_pipeline(Hasher &hasher, const std::string &path,
+                            const PipelineConfig &config = PipelineConfig()) {
+  return FilePipeline(path, config).feed(hasher);
+}
+
+#endif // end of FILE_PIPELINE_HPP
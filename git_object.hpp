@@ -0,0 +1,384 @@
+/**
+ * @brief gitのオブジェクトID(SHA1)を、gitを使わずに求める
+ * @note  オブジェクトIDは SHA1("<type> <size>\0" || content)
+ *        ヘッダを先にSHA1へ取り込み、続けて内容を流し込むので、
+ *        ヘッダと内容を1つのバッファに連結しない(大きなファイルもmmapのまま)
+ *        ディレクトリのtreeは、ファイルのblobをスレッドプールで並列に求めてから
+ *        葉から順に組み立てる(git add -A; git write-treeと同じ値)
+ * @note  gitと異なる点
+ *          .gitignore、改行コードの変換(autocrlf)、フィルタは適用しない
+ *          (git hash-object --no-filtersと同じく、ファイルの内容そのまま)
+ *          .gitという名前のものは読み飛ばし、入れ子のリポジトリ(submodule)も
+ *          通常のディレクトリとして扱う
+ */
+
+#ifndef GIT_OBJECT_HPP
+#define GIT_OBJECT_HPP
+
+#include "mapped_file.hpp"
+#include "sha1/sha1.hpp"
+#include "stream_hasher.hpp"
+#include "work_stealing_pool.hpp"
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+/**< @brief gitのオブジェクトID */
+using GitObjectId = SHA1::digest_type;
+
+/**
+ * @brief treeの項目の種類(gitのファイルモード)
+ */
+enum class GitMode : std::uint32_t {
+  File = 0100644,       /**< 通常のファイル */
+  Executable = 0100755, /**< 実行可能なファイル */
+  Symlink = 0120000,    /**< シンボリックリンク(リンク先のパスがblob) */
+  Tree = 040000,        /**< ディレクトリ */
+};
+
+/**
+ * @brief ヘッダ"<type> <size>\0"に続けて内容を流し込み、オブジェクトIDを求める
+ */
+class GitObjectHasher {
+public:
+  /**
+   * @param  std::string_view type オブジェクトの種類("blob", "tree"など)
+   * @param  std::uint64_t size    内容のbyte数
+   */
+  GitObjectHasher(std::string_view type, std::uint64_t size) : expected(size) {
+    char header[32];
+    std::memcpy(header, type.data(), type.size());
+    header[type.size()] = ' ';
+    char *end = std::to_chars(header + type.size() + 1, header + sizeof(header),
+                              size)
+                    .ptr;
+    *end++ = '\0';
+    ctx.update(header, static_cast<std::size_t>(end - header));
+  }
+
+  /**
+   * @brief  内容の続きを取り込む
+   */
+  void update(const void *data, std::size_t len) {
+    ctx.update(data, len);
+    fed += len;
+  }
+
+  /**
+   * @brief  ヘッダで宣言したbyte数をちょうど取り込んだか
+   */
+  bool complete() const { return fed == expected; }
+
+  GitObjectId finalize() { return ctx.finalize(); }
+
+private:
+  SHA1 ctx;
+  std::uint64_t expected;
+  std::uint64_t fed = 0;
+};
+
+/**
+ * @brief  メモリ上の内容のオブジェクトIDを求める
+ */
+inline GitObjectId git_object_id(std::string_view type, const void *data,
+                                 std::size_t len) {
+  GitObjectHasher hasher(type, len);
+  hasher.update(data, len);
+  return hasher.finalize();
+}
+
+/**
+ * @brief  メモリ上の内容のblobのオブジェクトIDを求める(git hash-object)
+ */
+inline GitObjectId git_blob_id(const void *data, std::size_t len) {
+  return git_object_id("blob", data, len);
+}
+
+/**
+ * @brief  ファイルのblobのオブジェクトIDを求める(git hash-object FILE)
+ * @param  std::uint64_t* size 内容のbyte数の書き込み先(nullptrなら書かない)
+ * @note   通常のファイルはfstat()で大きさを得てから、mmapあるいはread()で
+ *         内容を流し込む。パイプなどは一度メモリに読み込んでから計算する
+ *         開けない、読めない、あるいは読んでいる間に大きさが変わった場合は
+ *         std::system_errorを送出する
+ */
+inline GitObjectId git_blob_file(const std::string &path,
+                                 std::uint64_t *size = nullptr) {
+  StreamBuffer &buffer = thread_stream_buffer();
+  const MappedFile file(path, buffer.size() + 1);
+  struct stat st;
+  if (::fstat(file.descriptor(), &st) < 0) {
+    throw std::system_error(errno, std::generic_category(), path);
+  }
+  if (!S_ISREG(st.st_mode)) {
+    struct Text {
+      void update(const void *data, std::size_t len) {
+        s.append(static_cast<const char *>(data), len);
+      }
+      std::string s;
+    } text;
+    feed_descriptor(text, file.descriptor(), path, buffer.data(),
+                    buffer.size());
+    if (size != nullptr) {
+      *size = text.s.size();
+    }
+    return git_blob_id(text.s.data(), text.s.size());
+  }
+
+  GitObjectHasher hasher("blob", static_cast<std::uint64_t>(st.st_size));
+  if (file.mapped()) {
+    file.feed(hasher);
+  } else {
+    feed_stream(hasher, file.descriptor(), buffer, path);
+  }
+  if (!hasher.complete()) {
+    throw std::system_error(EIO, std::generic_category(),
+                            path + " (changed while reading)");
+  }
+  if (size != nullptr) {
+    *size = static_cast<std::uint64_t>(st.st_size);
+  }
+  return hasher.finalize();
+}
+
+/**
+ * @brief treeの1項目
+ */
+struct GitTreeEntry {
+  GitMode mode;
+  std::string name;
+  GitObjectId id;
+};
+
+/**
+ * @brief  treeの項目の順序(gitと同じく、ディレクトリは名前の後に'/'があるとみなす)
+ */
+inline bool git_tree_less(const GitTreeEntry &a, const GitTreeEntry &b) {
+  const std::size_t n = std::min(a.name.size(), b.name.size());
+  const int c = std::memcmp(a.name.data(), b.name.data(), n);
+  if (c != 0) {
+    return c < 0;
+  }
+  const auto next = [n](const GitTreeEntry &e) -> unsigned char {
+    return n < e.name.size()          ? e.name[n]
+           : e.mode == GitMode::Tree ? '/'
+                                     : '\0';
+  };
+  return next(a) < next(b);
+}
+
+/**
+ * @brief  treeのオブジェクトIDを求める
+ * @note   内容 "<mode(8進数)> <name>\0<20byteのID>" ... を連結せずに流し込む
+ */
+inline GitObjectId git_tree_id(std::vector<GitTreeEntry> entries) {
+  std::sort(entries.begin(), entries.end(), git_tree_less);
+  std::vector<std::string> modes(entries.size());
+  std::uint64_t size = 0;
+  for (std::size_t i = 0; i < entries.size(); i++) {
+    char buf[8];
+    const auto r = std::to_chars(
+        buf, buf + sizeof(buf), static_cast<std::uint32_t>(entries[i].mode), 8);
+    modes[i].assign(buf, r.ptr);
+    size += modes[i].size() + 1 + entries[i].name.size() + 1 +
+            entries[i].id.size();
+  }
+
+  GitObjectHasher hasher("tree", size);
+  for (std::size_t i = 0; i < entries.size(); i++) {
+    hasher.update(modes[i].data(), modes[i].size());
+    hasher.update(" ", 1);
+    hasher.update(entries[i].name.data(), entries[i].name.size() + 1);
+    hasher.update(entries[i].id.data(), entries[i].id.size());
+  }
+  return hasher.finalize();
+}
+
+/**
+ * @brief git_tree()の集計
+ */
+struct GitTreeStats {
+  std::uint64_t files = 0;
+  std::uint64_t bytes = 0;
+  std::vector<std::string> errors; // 読めなかったファイルやディレクトリ
+};
+
+/**
+ * @brief ディレクトリのtreeのオブジェクトIDを求める
+ * @note  ディレクトリの走査とblobの計算を1つずつ仕事として
+ *        ワークスティーリング方式のスレッドプールに分配し、全て終わってから
+ *        treeを葉から順に組み立てる
+ *        空のディレクトリ(項目のないtree)はgitと同じく含めない
+ */
+class GitTreeBuilder {
+public:
+  explicit GitTreeBuilder(WorkStealingPool &pool) : pool(pool) {}
+
+  /**
+   * @brief  ディレクトリ以下のtreeのオブジェクトIDを求める
+   * @note   読めなかったものはstats.errorsに残し、treeからは除く
+   */
+  GitObjectId build(const std::string &root, GitTreeStats &stats) {
+    Node top{root, {}};
+    pool.submit([this, &top] { walk(top); });
+    pool.wait();
+
+    stats.files = files;
+    stats.bytes = bytes;
+    std::sort(errors.begin(), errors.end());
+    stats.errors = std::move(errors);
+    errors.clear();
+    files = 0;
+    bytes = 0;
+    GitObjectId id;
+    tree(top, id);
+    return id;
+  }
+
+private:
+  struct Node;
+
+  /**
+   * @brief 走査中の項目(ディレクトリなら子のNodeを持つ)
+   */
+  struct Item {
+    GitTreeEntry entry;
+    std::unique_ptr<Node> dir;
+    bool ok = false;
+  };
+
+  struct Node {
+    std::string path;
+    std::vector<Item> items;
+  };
+
+  /**
+   * @brief  ディレクトリを1段だけ走査し、項目ごとの仕事を投入する
+   * @note   全ての項目を並べてから投入するので、仕事はItemを直接指してよい
+   */
+  void walk(Node &node) {
+    namespace fs = std::filesystem;
+    std::error_code ec;
+    fs::directory_iterator it(node.path, ec);
+    for (; !ec && it != fs::directory_iterator(); it.increment(ec)) {
+      std::string name = it->path().filename().string();
+      const fs::file_status st = it->symlink_status(ec);
+      if (ec) {
+        // 走査の途中で消えたファイルなど、その項目だけをtreeから除く
+        fail(node.path + "/" + name, ec.message());
+        ec.clear();
+        continue;
+      }
+      if (name == ".git") {
+        continue;
+      }
+      Item item;
+      item.entry.name = std::move(name);
+      if (fs::is_directory(st)) {
+        item.entry.mode = GitMode::Tree;
+        item.dir.reset(new Node{node.path + "/" + item.entry.name, {}});
+      } else if (fs::is_symlink(st)) {
+        item.entry.mode = GitMode::Symlink;
+      } else if (fs::is_regular_file(st)) {
+        item.entry.mode =
+            (st.permissions() & fs::perms::owner_exec) != fs::perms::none
+                ? GitMode::Executable
+                : GitMode::File;
+      } else {
+        continue; // デバイス、パイプ、ソケットはgitも扱わない
+      }
+      node.items.push_back(std::move(item));
+    }
+    if (ec) {
+      fail(node.path, ec.message());
+      node.items.clear();
+      return;
+    }
+
+    for (auto &&item : node.items) {
+      Item *p = &item;
+      if (p->dir != nullptr) {
+        pool.submit([this, p] { walk(*p->dir); });
+      } else {
+        pool.submit([this, &node, p] { blob(node, *p); });
+      }
+    }
+  }
+
+  /**
+   * @brief  ファイル、あるいはシンボリックリンクのblobを求める
+   */
+  void blob(const Node &node, Item &item) {
+    const std::string path = node.path + "/" + item.entry.name;
+    try {
+      std::uint64_t size;
+      if (item.entry.mode == GitMode::Symlink) {
+        const std::string target = std::filesystem::read_symlink(path);
+        item.entry.id = git_blob_id(target.data(), target.size());
+        size = target.size();
+      } else {
+        item.entry.id = git_blob_file(path, &size);
+      }
+      item.ok = true;
+      files++;
+      bytes += size;
+    } catch (const std::system_error &e) {
+      // std::filesystem::filesystem_errorも含む
+      fail(path, e.code().message());
+    }
+  }
+
+  /**
+   * @brief  子から順にtreeを組み立てる
+   * @return 項目が1つもなければ(空のディレクトリ)false
+   *         gitと同じく、親のtreeにも含めない
+   */
+  bool tree(Node &node, GitObjectId &id) {
+    std::vector<GitTreeEntry> entries;
+    for (auto &&item : node.items) {
+      if (item.dir != nullptr) {
+        item.ok = tree(*item.dir, item.entry.id);
+      }
+      if (item.ok) {
+        entries.push_back(item.entry);
+      }
+    }
+    const bool found = !entries.empty();
+    id = git_tree_id(std::move(entries));
+    return found;
+  }
+
+  void fail(const std::string &path, const std::string &message) {
+    std::lock_guard<std::mutex> lock(mutex);
+    errors.push_back(path + ": " + message);
+  }
+
+  WorkStealingPool &pool;
+  std::atomic<std::uint64_t> files{0};
+  std::atomic<std::uint64_t> bytes{0};
+
+  std::mutex mutex;
+  std::vector<std::string> errors;
+};
+
+/**
+ * @brief  ディレクトリのtreeのオブジェクトIDを求める
+ */
+inline GitObjectId git_tree(WorkStealingPool &pool, const std::string &root,
+                            GitTreeStats &stats) {
+  return GitTreeBuilder(pool).build(root, stats);
+}
+
+#endif // end of GIT_OBJECT_HPP
@@ -0,0 +1,82 @@
+/**
+ * @brief gitのオブジェクトIDを表示する
+ * @note  使い方: gitobj [-j THREADS] [-v] PATH...
+ *        ファイルはblobのID(git hash-object PATHと同じ)を、
+ *        ディレクトリはそれを根とするtreeのID(git add -A; git write-treeと同じ)を
+ *        引数の順に1行ずつ表示する
+ *        -vを指定すると、ディレクトリごとに処理したファイル数と速度を
+ *        標準エラー出力に表示する
+ */
+
+#include "../git_object.hpp"
+#include "../hex.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+namespace {
+
+int usage(const char *prog) {
+  std::fprintf(stderr, "usage: %s [-j THREADS] [-v] PATH...\n", prog);
+  return 2;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  std::size_t threads = 0;
+  bool verbose = false;
+  int i = 1;
+  for (; i < argc && argv[i][0] == '-'; i++) {
+    if (std::strcmp(argv[i], "-v") == 0) {
+      verbose = true;
+    } else if (std::strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+      threads = static_cast<std::size_t>(std::atol(argv[++i]));
+    } else {
+      return usage(argv[0]);
+    }
+  }
+  if (i == argc) {
+    return usage(argv[0]);
+  }
+
+  WorkStealingPool pool(threads);
+  int status = EXIT_SUCCESS;
+  for (; i < argc; i++) {
+    std::error_code ec;
+    if (!std::filesystem::is_directory(argv[i], ec)) {
+      try {
+        std::printf("%s\n", to_hex(git_blob_file(argv[i])).c_str());
+      } catch (const std::system_error &e) {
+        std::fprintf(stderr, "%s: %s\n", argv[0], e.what());
+        status = EXIT_FAILURE;
+      }
+      continue;
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    GitTreeStats stats;
+    const GitObjectId id = git_tree(pool, argv[i], stats);
+    const double sec = std::chrono::duration<double>(
+                           std::chrono::steady_clock::now() - start)
+                           .count();
+    for (auto &&e : stats.errors) {
+      std::fprintf(stderr, "%s: %s\n", argv[0], e.c_str());
+    }
+    if (!stats.errors.empty()) {
+      status = EXIT_FAILURE;
+      continue;
+    }
+    std::printf("%s\n", to_hex(id).c_str());
+    if (verbose) {
+      std::fprintf(stderr,
+                   "%s: %llu files, %llu bytes in %.3f s (%.3f GB/s) "
+                   "with %zu threads\n",
+                   argv[i], static_cast<unsigned long long>(stats.files),
+                   static_cast<unsigned long long>(stats.bytes), sec,
+                   stats.bytes / sec / 1e9, pool.size());
+    }
+  }
+  return status;
+}
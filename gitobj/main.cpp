@@ -0,0 +1,140 @@
+/**
+ * @brief gitのオブジェクトIDのテストプログラム
+ * @note  期待する値はgit hash-object, git write-tree(git 2.39)で求めたもの
+ */
+
+#define CATCH_CONFIG_MAIN // This tells Catch to provide a main() - only do this
+                          // in one cpp file
+#include "../git_object.hpp"
+#include "../matcher.hpp"
+#include <cstdlib>
+#include <fstream>
+
+namespace fs = std::filesystem;
+
+/**
+ * @brief テスト用の一時ディレクトリ(スコープを抜けると削除される)
+ */
+class TempDir {
+public:
+  TempDir() {
+    const char *dir = std::getenv("TMPDIR");
+    path = std::string(dir != nullptr ? dir : "/tmp") + "/gitobj.XXXXXX";
+    REQUIRE(::mkdtemp(&path[0]) != nullptr);
+  }
+
+  ~TempDir() { fs::remove_all(path); }
+
+  void write(const std::string &rel, const std::string &data) const {
+    fs::create_directories(fs::path(path + "/" + rel).parent_path());
+    std::ofstream(path + "/" + rel, std::ios::binary) << data;
+  }
+
+  std::string path;
+};
+
+/**
+ * @brief  i * 7 + 3 (mod 256)をn byte並べた内容
+ */
+std::string pattern(std::size_t n) {
+  std::string s(n, '\0');
+  for (std::size_t i = 0; i < n; i++) {
+    s[i] = static_cast<char>(i * 7 + 3);
+  }
+  return s;
+}
+
+TEST_CASE("Git-Blob") {
+  SECTION("Memory") {
+    CHECK_THAT(git_blob_id("", 0),
+               expect("e69de29bb2d1d6434b8b29ae775ad8c2e48c5391"));
+    CHECK_THAT(git_blob_id("hello world\n", 12),
+               expect("3b18e512dba79e4c8300dd08aeb37f8e728b8dad"));
+    CHECK_THAT(git_object_id("tree", "", 0),
+               expect("4b825dc642cb6eb9a060e54bf8d69288fbee4904"));
+  }
+
+  SECTION("Streaming") {
+    // 内容をどのように区切って渡しても同じ値になる
+    const std::string big = pattern(300000);
+    for (std::size_t piece : {1, 63, 64, 65, 4096, 300000}) {
+      GitObjectHasher hasher("blob", big.size());
+      CHECK_FALSE(hasher.complete());
+      for (std::size_t off = 0; off < big.size(); off += piece) {
+        hasher.update(big.data() + off, std::min(piece, big.size() - off));
+      }
+      CHECK(hasher.complete());
+      CHECK_THAT(hasher.finalize(),
+                 expect("4ec738efed941b2cf3a54052eac92671263013f9"));
+    }
+  }
+
+  SECTION("File") {
+    // 小さなファイルはread()、大きなファイルはmmapで読む
+    TempDir dir;
+    dir.write("h", "hello world\n");
+    dir.write("big", pattern(300000));
+    std::uint64_t size;
+    CHECK_THAT(git_blob_file(dir.path + "/h", &size),
+               expect("3b18e512dba79e4c8300dd08aeb37f8e728b8dad"));
+    CHECK(size == 12);
+    CHECK_THAT(git_blob_file(dir.path + "/big", &size),
+               expect("4ec738efed941b2cf3a54052eac92671263013f9"));
+    CHECK(size == 300000);
+    CHECK_THROWS_AS(git_blob_file(dir.path + "/missing"), std::system_error);
+  }
+}
+
+TEST_CASE("Git-Tree-Order") {
+  // ディレクトリ"a"は"a/"として並べるので、"a.b"(0x2e)の後、"a0"の前
+  const GitObjectId id{};
+  std::vector<GitTreeEntry> entries = {{GitMode::File, "a0", id},
+                                       {GitMode::Tree, "a", id},
+                                       {GitMode::File, "a.b", id},
+                                       {GitMode::File, "a-c", id}};
+  std::sort(entries.begin(), entries.end(), git_tree_less);
+  CHECK(entries[0].name == "a-c");
+  CHECK(entries[1].name == "a.b");
+  CHECK(entries[2].name == "a");
+  CHECK(entries[3].name == "a0");
+
+  CHECK_THAT(git_tree_id({}),
+             expect("4b825dc642cb6eb9a060e54bf8d69288fbee4904"));
+}
+
+TEST_CASE("Git-Write-Tree") {
+  TempDir dir;
+  dir.write("h", "hello world\n");
+  dir.write("a/empty", "");
+  dir.write("a/b/big", pattern(300000));
+  dir.write("a.b", "x");
+  dir.write("a-c", "y");
+  dir.write("c/run.sh", "run\n");
+  fs::permissions(dir.path + "/c/run.sh", fs::perms::owner_exec,
+                  fs::perm_options::add);
+  fs::create_symlink("../h", dir.path + "/c/link");
+  // 空のディレクトリと.gitは含めない
+  fs::create_directories(dir.path + "/empty/x");
+  dir.write(".git/config", "[core]\n");
+
+  // スレッド数によらず同じ値になること
+  const std::size_t threads = GENERATE(1, 4);
+  INFO("threads = " << threads);
+  WorkStealingPool pool(threads);
+  GitTreeStats stats;
+  CHECK_THAT(git_tree(pool, dir.path, stats),
+             expect("7ddfdc4fd03f9e9fc6eea29cb786f965b9e5c097"));
+  CHECK(stats.errors.empty());
+  CHECK(stats.files == 7);
+  CHECK(stats.bytes == 12 + 300000 + 1 + 1 + 4 + 4);
+
+  CHECK_THAT(git_tree(pool, dir.path + "/a", stats),
+             expect("ee93cfcd73bc054c5ebc233cd92e773da9eb032f"));
+  CHECK_THAT(git_tree(pool, dir.path + "/c", stats),
+             expect("ee2a682522aca54b3b21773b61fe739a9490ed25"));
+  CHECK_THAT(git_tree(pool, dir.path + "/empty", stats),
+             expect("4b825dc642cb6eb9a060e54bf8d69288fbee4904"));
+
+  git_tree(pool, dir.path + "/missing", stats);
+  CHECK(stats.errors.size() == 1);
+}
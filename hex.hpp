@@ -0,0 +1,120 @@
+/**
+ * @brief ハッシュ値の16進数表記
+ * @note  from_hex()はAVX2があれば32文字(16byte)ずつまとめて変換する
+ *        (検証リストの読み込みなど、数百万個のハッシュ値を読むときに効く)
+ */
+
+#ifndef HEX_HPP
+#define HEX_HPP
+
+#include "cpu.hpp"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+/**
+ * @brief  ハッシュ値を小文字の16進数文字列にする
+ */
+template <std::size_t N>
+std::string to_hex(const std::array<std::uint8_t, N> &digest) {
+  static constexpr char digits[] = "0123456789abcdef";
+  std::string s(2 * N, '0');
+  for (std::size_t i = 0; i < N; i++) {
+    s[2 * i] = digits[digest[i] >> 4];
+    s[2 * i + 1] = digits[digest[i] & 0x0f];
+  }
+  return s;
+}
+
+/**< @brief 文字から4-bitの値への表(16進数の数字でなければ0xff) */
+inline constexpr std::array<std::uint8_t, 256> hex_table = [] {
+  std::array<std::uint8_t, 256> t{};
+  for (std::size_t c = 0; c < 256; c++) {
+    t[c] = c >= '0' && c <= '9'   ? c - '0'
+           : c >= 'a' && c <= 'f' ? c - 'a' + 10
+           : c >= 'A' && c <= 'F' ? c - 'A' + 10
+                                  : 0xff;
+  }
+  return t;
+}();
+
+/**
+ * @brief  16進数の2n文字をn byteにする(スカラー版)
+ * @return 16進数の数字でない文字があればfalse
+ */
+inline bool from_hex_scalar(const char *s, std::size_t n, std::uint8_t *out) {
+  std::uint8_t bad = 0;
+  for (std::size_t i = 0; i < n; i++) {
+    const std::uint8_t hi = hex_table[static_cast<unsigned char>(s[2 * i])];
+    const std::uint8_t lo = hex_table[static_cast<unsigned char>(s[2 * i + 1])];
+    bad |= hi | lo;
+    out[i] = static_cast<std::uint8_t>(hi << 4 | lo);
+  }
+  return (bad & 0xf0) == 0;
+}
+
+#ifdef SHA_X86
+/**
+ * @brief  from_hex_scalar()のAVX2版(32文字ずつ変換し、端数はスカラー版に任せる)
+ */
+__attribute__((target("avx2"))) inline bool
+from_hex_avx2(const char *s, std::size_t n, std::uint8_t *out) {
+  const __m256i zero = _mm256_set1_epi8('0' - 1);
+  const __m256i nine = _mm256_set1_epi8('9' + 1);
+  const __m256i a = _mm256_set1_epi8('a' - 1);
+  const __m256i f = _mm256_set1_epi8('f' + 1);
+  const __m256i lower = _mm256_set1_epi8(0x20);
+  // 隣り合う2文字(上位, 下位)を hi * 16 + lo の16-bitにまとめる
+  const __m256i weight = _mm256_set1_epi16(0x0110);
+
+  std::size_t i = 0;
+  for (; i + 16 <= n; i += 16) {
+    const __m256i c =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(s + 2 * i));
+    // 0x80以上の文字は符号付きの比較で負となり、どちらにも当てはまらない
+    const __m256i digit = _mm256_and_si256(_mm256_cmpgt_epi8(c, zero),
+                                           _mm256_cmpgt_epi8(nine, c));
+    const __m256i l = _mm256_or_si256(c, lower);
+    const __m256i alpha =
+        _mm256_and_si256(_mm256_cmpgt_epi8(l, a), _mm256_cmpgt_epi8(f, l));
+    if (_mm256_movemask_epi8(_mm256_or_si256(digit, alpha)) != -1) {
+      return false;
+    }
+    const __m256i v = _mm256_blendv_epi8(
+        _mm256_sub_epi8(l, _mm256_set1_epi8('a' - 10)),
+        _mm256_sub_epi8(c, _mm256_set1_epi8('0')), digit);
+    const __m256i w = _mm256_maddubs_epi16(v, weight);
+    // packusは128-bitのレーンごとに詰めるので、2つのレーンの下位を寄せる
+    const __m256i p = _mm256_permute4x64_epi64(_mm256_packus_epi16(w, w), 0x08);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i),
+                     _mm256_castsi256_si128(p));
+  }
+  return from_hex_scalar(s + 2 * i, n - i, out + i);
+}
+#endif
+
+/**
+ * @brief  16進数の2n文字をn byteにする(大文字と小文字のどちらも受け付ける)
+ * @return 16進数の数字でない文字があればfalse(outの内容は不定)
+ */
+inline bool from_hex(const char *s, std::size_t n, std::uint8_t *out) {
+#ifdef SHA_X86
+  if (cpu_features().avx2) {
+    return from_hex_avx2(s, n, out);
+  }
+#endif
+  return from_hex_scalar(s, n, out);
+}
+
+/**
+ * @brief  16進数文字列をハッシュ値にする
+ * @return 長さが2Nでない、あるいは16進数の数字でない文字があればfalse
+ */
+template <std::size_t N>
+bool from_hex(std::string_view hex, std::array<std::uint8_t, N> &digest) {
+  return hex.size() == 2 * N && from_hex(hex.data(), N, digest.data());
+}
+
+#endif // end of HEX_HPP
@@ -0,0 +1,205 @@
+/**
+ * @brief 鍵ブロックを圧縮した状態(midstate)を使い回すHMAC
+ * @note  RFC 2104: HMAC(K, m) = H((K0 ^ opad) || H((K0 ^ ipad) || m))
+ *        K0 ^ ipad, K0 ^ opadはどちらも1ブロックなので、鍵ごとに一度だけ圧縮し、
+ *        その状態をコピーしてメッセージを計算する(1メッセージあたり2回の圧縮を省く)
+ */
+
+#ifndef HMAC_HPP
+#define HMAC_HPP
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <utility>
+
+/**
+ * @brief  2つのbyte列を、内容によらない時間で比較する
+ * @note   MACの検証で、一致したbyte数が処理時間から漏れないようにする
+ */
+inline bool constant_time_equal(const std::uint8_t *a, const std::uint8_t *b,
+                                std::size_t n) {
+  std::uint8_t diff = 0;
+  for (std::size_t i = 0; i < n; i++) {
+    diff |= a[i] ^ b[i];
+  }
+  return diff == 0;
+}
+
+/**
+ * @brief 接頭辞を取り込んだ状態からのhash_many()を持つハッシュクラスか判定する
+ */
+template <class Hasher, class = void> struct has_prefixed_hash_many {
+  static constexpr bool value = false;
+};
+
+template <class Hasher>
+struct has_prefixed_hash_many<
+    Hasher, std::void_t<decltype(Hasher::hash_many(
+                std::size_t(), std::declval<const void *const *>(),
+                std::declval<const std::size_t *>(),
+                std::declval<typename Hasher::digest_type *>(),
+                std::declval<const Hasher &>()))>> {
+  static constexpr bool value = true;
+};
+
+/**
+ * @tparam Hasher SHA1, SHA256, SHA512などのハッシュクラス
+ *         コピーするとハッシュ計算の途中状態が複製されること
+ */
+template <class Hasher> class HMAC {
+public:
+  using digest_type = typename Hasher::digest_type;
+
+  static constexpr std::size_t block_size = Hasher::block_size;
+  static constexpr std::size_t digest_size = Hasher::digest_size;
+
+  /**
+   * @param  const void* key      鍵の先頭
+   * @param  std::size_t keylen  鍵のbyte数
+   */
+  HMAC(const void *key, std::size_t keylen) { rekey(key, keylen); }
+
+  /**
+   * @brief  鍵を差し替え、内側と外側の状態を計算し直す
+   */
+  void rekey(const void *key, std::size_t keylen) {
+    const auto ipad = key_block(key, keylen, 0x36);
+    inner.init();
+    inner.update(ipad.data(), block_size);
+    const auto opad = key_block(key, keylen, 0x5c);
+    outer.init();
+    outer.update(opad.data(), block_size);
+    init();
+  }
+
+  /**
+   * @brief  K0 ^ pad(内側なら0x36, 外側なら0x5c)の1ブロックを求める
+   * @note   ブロック長より長い鍵は、先にハッシュ値に置き換える
+   *         圧縮関数を直接呼び出す呼び出し側(PBKDF2など)のためにも公開する
+   */
+  static std::array<std::uint8_t, block_size>
+  key_block(const void *key, std::size_t keylen, std::uint8_t pad) {
+    std::array<std::uint8_t, block_size> K0{};
+    if (keylen > block_size) {
+      Hasher h;
+      h.update(key, keylen);
+      h.finalize(K0.data());
+    } else {
+      const auto *p = static_cast<const std::uint8_t *>(key);
+      std::copy(p, p + keylen, K0.begin());
+    }
+    for (auto &&b : K0) {
+      b ^= pad;
+    }
+    return K0;
+  }
+
+  /**
+   * @brief  1つのメッセージの計算を始める(内側の状態をコピーするだけ)
+   */
+  void init() { ctx = inner; }
+
+  /**
+   * @brief  メッセージの続きを取り込む
+   */
+  void update(const void *data, std::size_t len) { ctx.update(data, len); }
+
+  /**
+   * @brief  MACを求める
+   * @note   続けて次のメッセージを計算する場合は、init()を呼び出す
+   */
+  digest_type finalize() { return outer_hash(ctx.finalize()); }
+
+  /**
+   * @brief  1つのメッセージのMACを求める
+   */
+  digest_type mac(const void *data, std::size_t len) const {
+    Hasher h = inner;
+    h.update(data, len);
+    return outer_hash(h.finalize());
+  }
+
+  /**
+   * @brief  MACを検証する
+   * @param  const std::uint8_t* tag 検証するMAC
+   * @param  std::size_t taglen     tagのbyte数(先頭だけを切り詰めたMACも扱う)
+   */
+  bool verify(const void *data, std::size_t len, const std::uint8_t *tag,
+              std::size_t taglen = digest_size) const {
+    if (taglen == 0 || taglen > digest_size) {
+      return false;
+    }
+    return constant_time_equal(mac(data, len).data(), tag, taglen);
+  }
+
+  /**
+   * @brief  同じ鍵で複数のメッセージのMACをまとめて求める
+   * @note   ハッシュクラスがhash_many()を持てば、内側と外側をそれぞれ
+   *         SIMDレーンに分けて計算する(内側の状態は全レーンで共有する)
+   */
+  void mac_many(std::size_t n, const void *const *data,
+                const std::size_t *len, digest_type *M) const {
+    if constexpr (has_prefixed_hash_many<Hasher>::value) {
+      // ヒープ確保を避けるため、一定数ずつ区切って計算する
+      constexpr std::size_t chunk = 64;
+      digest_type D[chunk];
+      const void *P[chunk];
+      std::size_t L[chunk];
+      for (std::size_t i = 0; i < n; i += chunk) {
+        const std::size_t m = std::min(chunk, n - i);
+        Hasher::hash_many(m, data + i, len + i, D, inner);
+        for (std::size_t j = 0; j < m; j++) {
+          P[j] = D[j].data();
+          L[j] = digest_size;
+        }
+        Hasher::hash_many(m, P, L, M + i, outer);
+      }
+    } else {
+      for (std::size_t i = 0; i < n; i++) {
+        M[i] = mac(data[i], len[i]);
+      }
+    }
+  }
+
+  /**
+   * @brief  同じ鍵で複数のメッセージのMACをまとめて検証する
+   * @param  const std::uint8_t* const* tags 各メッセージのMAC(digest_size byte)
+   * @param  bool* ok                        各メッセージの検証結果の書き込み先
+   * @return 全て一致すればtrue
+   */
+  bool verify_many(std::size_t n, const void *const *data,
+                   const std::size_t *len, const std::uint8_t *const *tags,
+                   bool *ok) const {
+    constexpr std::size_t chunk = 64;
+    digest_type M[chunk];
+    bool all = true;
+    for (std::size_t i = 0; i < n; i += chunk) {
+      const std::size_t m = std::min(chunk, n - i);
+      mac_many(m, data + i, len + i, M);
+      for (std::size_t j = 0; j < m; j++) {
+        ok[i + j] = constant_time_equal(M[j].data(), tags[i + j], digest_size);
+        all = all && ok[i + j];
+      }
+    }
+    return all;
+  }
+
+private:
+  digest_type outer_hash(const digest_type &d) const {
+    Hasher h = outer;
+    h.update(d.data(), d.size());
+    return h.finalize();
+  }
+
+  /**< @brief K0 ^ ipad, K0 ^ opadを圧縮した状態 */
+  Hasher inner;
+  Hasher outer;
+
+  /**< @brief init(), update(), finalize()で計算中のメッセージ */
+  Hasher ctx;
+};
+
+#endif // end of HMAC_HPP
@@ -0,0 +1,162 @@
+/**
+ * @brief HMACのテストプログラム
+ * @note  テストベクタはRFC 2202(HMAC-SHA1)およびRFC 4231(HMAC-SHA224/256/384/512)から
+ */
+
+#define CATCH_CONFIG_MAIN // This tells Catch to provide a main() - only do this
+                          // in one cpp file
+#include "../alloc_counter.hpp"
+#include "../hmac.hpp"
+#include "../matcher.hpp"
+#include "../sha1/sha1.hpp"
+#include "../sha2/sha2.hpp"
+#include "../sha256/sha256.hpp"
+#include "../sha512/sha512.hpp"
+
+namespace {
+
+const std::string key1(20, '\x0b');
+const std::string msg1 = "Hi There";
+const std::string key2 = "Jefe";
+const std::string msg2 = "what do ya want for nothing?";
+const std::string key3(131, '\xaa');
+const std::string msg3 =
+    "Test Using Larger Than Block-Size Key - Hash Key First";
+
+template <class Hasher>
+typename Hasher::digest_type mac(const std::string &key,
+                                 const std::string &msg) {
+  return HMAC<Hasher>(key.data(), key.size()).mac(msg.data(), msg.size());
+}
+
+} // namespace
+
+TEST_CASE("HMAC-Example") {
+  SECTION("HMAC-SHA1") {
+    CHECK_THAT(mac<SHA1>(key1, msg1),
+               expect("b6173186 55057264 e28bc0b6 fb378c8e f146be00"));
+    CHECK_THAT(mac<SHA1>(key2, msg2),
+               expect("effcdf6a e5eb2fa2 d27416d5 f184df9c 259a7c79"));
+    CHECK_THAT(mac<SHA1>(key3, msg3),
+               expect("90d0dace 1c1bdc95 73393078 03160335 bde6df2b"));
+  }
+  SECTION("HMAC-SHA256") {
+    CHECK_THAT(mac<SHA256>(key1, msg1),
+               expect("b0344c61 d8db3853 5ca8afce af0bf12b 881dc200 "
+                      "c9833da7 26e9376c 2e32cff7"));
+    CHECK_THAT(mac<SHA256>(key2, msg2),
+               expect("5bdcc146 bf60754e 6a042426 089575c7 5a003f08 "
+                      "9d273983 9dec58b9 64ec3843"));
+    CHECK_THAT(mac<SHA256>(key3, msg3),
+               expect("60e43159 1ee0b67f 0d8a26aa cbf5b77f 8e0bc621 "
+                      "3728c514 0546040f 0ee37f54"));
+  }
+  SECTION("HMAC-SHA512") {
+    CHECK_THAT(mac<SHA512>(key1, msg1),
+               expect("87aa7cdea5ef619d 4ff0b4241a1d6cb0 2379f4e2ce4ec278 "
+                      "7ad0b30545e17cde daa833b7d6b8a702 038b274eaea3f4e4 "
+                      "be9d914eeb61f170 2e696c203a126854"));
+    CHECK_THAT(mac<SHA512>(key2, msg2),
+               expect("164b7a7bfcf819e2 e395fbe73b56e0a3 87bd64222e831fd6 "
+                      "10270cd7ea250554 9758bf75c05a994a 6d034f65f8f0e6fd "
+                      "caeab1a34d4a6b4b 636e070a38bce737"));
+    CHECK_THAT(mac<SHA512>(key3, msg3),
+               expect("80b24263c7c1a3eb b71493c1dd7be8b4 9b46d1f41b4aeec1 "
+                      "121b013783f8f352 6b56d037e05f2598 bd0fd2215d6a1e52 "
+                      "95e64f73f63f0aec 8b915a985d786598"));
+  }
+}
+
+TEST_CASE("HMAC-SHA2-Variants") {
+  SECTION("HMAC-SHA224") {
+    CHECK_THAT(mac<SHA224>(key1, msg1),
+               expect("896fb112 8abbdf19 6832107c d49df33f 47b4b116 "
+                      "9912ba4f 53684b22"));
+    CHECK_THAT(mac<SHA224>(key2, msg2),
+               expect("a30e0109 8bc6dbbf 45690f3a 7e9e6d0f 8bbea2a3 "
+                      "9e614800 8fd05e44"));
+  }
+  SECTION("HMAC-SHA384") {
+    CHECK_THAT(mac<SHA384>(key1, msg1),
+               expect("afd03944d8489562 6b0825f4ab46907f 15f9dadbe4101ec6 "
+                      "82aa034c7cebc59c faea9ea9076ede7f 4af152e8b2fa9cb6"));
+    CHECK_THAT(mac<SHA384>(key2, msg2),
+               expect("af45d2e376484031 617f78d2b58a6b1b 9c7ef464f5a01b47 "
+                      "e42ec3736322445e 8e2240ca5e69e2c7 8b3239ecfab21649"));
+  }
+  SECTION("HMAC-SHA512/256") {
+    CHECK_THAT(mac<SHA512_256>(key2, msg2),
+               expect("6df7b24630d5ccb2 ee335407081a8718 8c221489768fa202 "
+                      "0513b2d593359456"));
+  }
+}
+
+TEST_CASE("HMAC-Reuse") {
+  HMAC<SHA256> hmac(key2.data(), key2.size());
+
+  SECTION("Streaming") {
+    // 鍵を計算し直さずに、同じオブジェクトで何度でも計算できる
+    for (int i = 0; i < 3; i++) {
+      hmac.init();
+      hmac.update(msg2.data(), 10);
+      hmac.update(msg2.data() + 10, msg2.size() - 10);
+      CHECK(hmac.finalize() == hmac.mac(msg2.data(), msg2.size()));
+    }
+  }
+
+  SECTION("Rekey") {
+    hmac.rekey(key1.data(), key1.size());
+    CHECK(hmac.mac(msg1.data(), msg1.size()) == mac<SHA256>(key1, msg1));
+  }
+
+  SECTION("Verify") {
+    auto tag = hmac.mac(msg2.data(), msg2.size());
+    CHECK(hmac.verify(msg2.data(), msg2.size(), tag.data()));
+    CHECK(hmac.verify(msg2.data(), msg2.size(), tag.data(), 16));
+    CHECK_FALSE(hmac.verify(msg2.data(), msg2.size(), tag.data(), 0));
+    tag[31] ^= 1;
+    CHECK_FALSE(hmac.verify(msg2.data(), msg2.size(), tag.data()));
+  }
+
+  SECTION("Zero Allocation") {
+    const std::size_t before = allocation_count;
+    for (int i = 0; i < 100; i++) {
+      static_cast<void>(hmac.mac(msg2.data(), msg2.size()));
+    }
+    CHECK(allocation_count == before);
+  }
+}
+
+TEMPLATE_TEST_CASE("HMAC-Batch", "", SHA1, SHA224, SHA256, SHA512,
+                   SHA512_256) {
+  // 長さの異なるメッセージを用意し、1つずつ計算した結果と突き合わせる
+  std::vector<std::vector<std::uint8_t>> msgs;
+  for (std::size_t i = 0; i < 150; i++) {
+    msgs.emplace_back((i * 37) % 300, static_cast<std::uint8_t>(i));
+  }
+  std::vector<const void *> data;
+  std::vector<std::size_t> len;
+  for (auto &&m : msgs) {
+    data.push_back(m.data());
+    len.push_back(m.size());
+  }
+
+  const HMAC<TestType> hmac(key3.data(), key3.size());
+  std::vector<typename TestType::digest_type> tags(msgs.size());
+  hmac.mac_many(msgs.size(), data.data(), len.data(), tags.data());
+  std::vector<const std::uint8_t *> ptrs;
+  for (std::size_t i = 0; i < msgs.size(); i++) {
+    CHECK(tags[i] == hmac.mac(msgs[i].data(), msgs[i].size()));
+    ptrs.push_back(tags[i].data());
+  }
+
+  std::unique_ptr<bool[]> ok(new bool[msgs.size()]);
+  CHECK(hmac.verify_many(msgs.size(), data.data(), len.data(), ptrs.data(),
+                         ok.get()));
+  tags[77][0] ^= 1;
+  CHECK_FALSE(hmac.verify_many(msgs.size(), data.data(), len.data(),
+                               ptrs.data(), ok.get()));
+  for (std::size_t i = 0; i < msgs.size(); i++) {
+    CHECK(ok[i] == (i != 77));
+  }
+}
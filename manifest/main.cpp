@@ -0,0 +1,172 @@
+/**
+ * @brief manifestのテストプログラム
+ */
+
+#define CATCH_CONFIG_MAIN // This tells Catch to provide a main() - only do this
+                          // in one cpp file
+#include "../matcher.hpp"
+#include "manifest.hpp"
+#include <cstdlib>
+#include <fstream>
+
+namespace fs = std::filesystem;
+
+/**
+ * @brief テスト用の一時ディレクトリ(スコープを抜けると削除される)
+ */
+class TempDir {
+public:
+  TempDir() {
+    const char *dir = std::getenv("TMPDIR");
+    path = std::string(dir != nullptr ? dir : "/tmp") + "/manifest.XXXXXX";
+    REQUIRE(::mkdtemp(&path[0]) != nullptr);
+  }
+
+  ~TempDir() { fs::remove_all(path); }
+
+  void write(const std::string &rel, const std::string &data) const {
+    fs::create_directories(fs::path(path + "/" + rel).parent_path());
+    std::ofstream(path + "/" + rel, std::ios::binary) << data;
+  }
+
+  std::string path;
+};
+
+TEST_CASE("Manifest-Build") {
+  TempDir dir;
+  std::string large(5 * 4096 + 123, '\0');
+  for (std::size_t i = 0; i < large.size(); i++) {
+    large[i] = static_cast<char>(i * 7 + 3);
+  }
+  dir.write("b.txt", "abc");
+  dir.write("a/empty", "");
+  dir.write("a/b/c/large.bin", large);
+  dir.write("z", std::string(1000, 'a'));
+  fs::create_symlink("b.txt", dir.path + "/link");
+
+  // スレッド数によらず、同じ順序・同じ値になること
+  const std::size_t threads = GENERATE(1, 4);
+  INFO("threads = " << threads);
+  WorkStealingPool pool(threads);
+
+  // 大きなファイルが複数の仕事に分かれるよう、分割単位を小さくする
+  ManifestStats stats;
+  const auto manifest =
+      ManifestBuilder<SHA256>(pool, 2 * 4096).build(dir.path, stats);
+
+  REQUIRE(manifest.size() == 4);
+  CHECK(stats.files == 4);
+  CHECK(stats.bytes == 3 + large.size() + 1000);
+  CHECK(stats.errors.empty());
+
+  CHECK(manifest[0].path == "a/b/c/large.bin");
+  CHECK(manifest[0].size == large.size());
+  CHECK(manifest[0].digest ==
+        to_hex(SHA256().hash(large.data(), large.size())));
+
+  CHECK(manifest[1].path == "a/empty");
+  CHECK(manifest[1].digest ==
+        "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855");
+
+  CHECK(manifest[2].path == "b.txt");
+  CHECK(manifest[2].digest ==
+        "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad");
+
+  CHECK(manifest[3].path == "z");
+  CHECK(manifest[3].digest ==
+        to_hex(SHA256().hash(std::string(1000, 'a').data(), 1000)));
+}
+
+TEST_CASE("Manifest-Algorithms") {
+  TempDir dir;
+  dir.write("abc", "abc");
+  WorkStealingPool pool(2);
+  ManifestStats stats;
+
+  const auto sha1 = ManifestBuilder<SHA1>(pool).build(dir.path, stats);
+  REQUIRE(sha1.size() == 1);
+  CHECK(sha1[0].digest == "a9993e364706816aba3e25717850c26c9cd0d89d");
+
+  const auto sha512 = ManifestBuilder<SHA512>(pool).build(dir.path, stats);
+  REQUIRE(sha512.size() == 1);
+  CHECK(sha512[0].digest ==
+        "ddaf35a193617abacc417349ae20413112e6fa4e89a97ea20a9eeee64b55d39a"
+        "2192992a274fc1a836ba3c23a3feebbd454d4423643ce80e2a9ac94fa54ca49f");
+}
+
+TEST_CASE("Manifest-Errors") {
+  WorkStealingPool pool(2);
+  ManifestStats stats;
+  const auto manifest =
+      ManifestBuilder<SHA256>(pool).build("/nonexistent/manifest", stats);
+  CHECK(manifest.empty());
+  CHECK(stats.errors.size() == 1);
+}
+
+TEST_CASE("Manifest-Format") {
+  CHECK(format_manifest_line({"dir/a b", 3, "ab"}) == "ab  3  dir/a b\n");
+  CHECK(format_manifest_line({"x\ny\\z", 0, "ab"}) ==
+        "ab  0  x\\ny\\\\z\n");
+}
+
+TEST_CASE("Manifest-Digest-Cache") {
+  TempDir dir;
+  std::string large(5 * 4096 + 123, '\0');
+  for (std::size_t i = 0; i < large.size(); i++) {
+    large[i] = static_cast<char>(i * 7 + 3);
+  }
+  dir.write("b.txt", "abc");
+  dir.write("a/large.bin", large);
+  dir.write("a/empty", "");
+
+  // racy_windowより古い更新時刻にしておく
+  const struct timespec past[2] = {{::time(nullptr) - 3600, 0},
+                                   {::time(nullptr) - 3600, 0}};
+  for (const char *rel : {"b.txt", "a/large.bin", "a/empty"}) {
+    REQUIRE(::utimensat(AT_FDCWD, (dir.path + "/" + rel).c_str(), past, 0) ==
+            0);
+  }
+
+  WorkStealingPool pool(4);
+  const std::string cache_path = dir.path + ".cache";
+  const auto build = [&](bool rehash, std::uint64_t &hits) {
+    DigestCache cache(cache_path, rehash);
+    ManifestBuilder<SHA256> builder(pool, 2 * 4096);
+    builder.use_cache(&cache);
+    ManifestStats stats;
+    const auto manifest = builder.build(dir.path, stats);
+    hits = cache.hits();
+    return manifest;
+  };
+
+  // 2回目は全てのファイルが記録から求まり、結果は変わらない
+  std::uint64_t hits;
+  const auto first = build(false, hits);
+  CHECK(hits == 0);
+  const auto second = build(false, hits);
+  CHECK(hits == 3);
+  REQUIRE(second.size() == 3);
+  for (std::size_t i = 0; i < 3; i++) {
+    CHECK(second[i].path == first[i].path);
+    CHECK(second[i].size == first[i].size);
+    CHECK(second[i].digest == first[i].digest);
+  }
+  CHECK(second[1].digest ==
+        to_hex(SHA256().hash(large.data(), large.size())));
+
+  // 計算し直しを強制すれば記録を使わない
+  build(true, hits);
+  CHECK(hits == 0);
+
+  // 別のアルゴリズムの記録は使わない
+  {
+    DigestCache cache(cache_path);
+    ManifestBuilder<SHA1> builder(pool);
+    builder.use_cache(&cache);
+    ManifestStats stats;
+    const auto sha1 = builder.build(dir.path, stats);
+    CHECK(cache.hits() == 0);
+    CHECK(sha1[2].digest == "a9993e364706816aba3e25717850c26c9cd0d89d");
+  }
+  ::unlink(cache_path.c_str());
+}
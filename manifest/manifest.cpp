@@ -0,0 +1,111 @@
+/**
+ * @brief ディレクトリ以下の全てのファイルのハッシュ値の一覧を出力する
+ * @note  使い方: manifest [-a 1|256|512] [-j THREADS] [-C CACHE [-f]] DIR
+ *        "<digest>  <size>  <path>"の形式でパスの昇順に標準出力へ書き出し、
+ *        最後に処理したファイル数と速度(files/s, GB/s)を標準エラー出力に表示する
+ *        -C CACHEを指定すると、変わっていないファイルはCACHEに記録したハッシュ値を
+ *        使う(-fなら記録を使わずに計算し直し、結果を記録する)
+ */
+
+#include "manifest.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+
+namespace {
+
+int usage(const char *prog) {
+  std::fprintf(stderr,
+               "usage: %s [-a 1|256|512] [-j THREADS] [-C CACHE [-f]] DIR\n",
+               prog);
+  return 2;
+}
+
+template <class Hasher>
+std::vector<ManifestEntry> build(WorkStealingPool &pool, const char *root,
+                                 ManifestStats &stats, DigestCache *cache) {
+  ManifestBuilder<Hasher> builder(pool);
+  builder.use_cache(cache);
+  return builder.build(root, stats);
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  int bits = 256;
+  std::size_t threads = 0;
+  const char *cache_path = nullptr;
+  bool rehash = false;
+  int i = 1;
+  for (; i + 1 < argc && argv[i][0] == '-'; i++) {
+    if (std::strcmp(argv[i], "-f") == 0) {
+      rehash = true;
+    } else if (std::strcmp(argv[i], "-a") == 0) {
+      bits = std::atoi(argv[++i]);
+    } else if (std::strcmp(argv[i], "-j") == 0) {
+      threads = static_cast<std::size_t>(std::atol(argv[++i]));
+    } else if (std::strcmp(argv[i], "-C") == 0) {
+      cache_path = argv[++i];
+    } else {
+      return usage(argv[0]);
+    }
+  }
+  if (i + 1 != argc || (bits != 1 && bits != 256 && bits != 512) ||
+      (rehash && cache_path == nullptr)) {
+    return usage(argv[0]);
+  }
+
+  std::unique_ptr<DigestCache> cache;
+  if (cache_path != nullptr) {
+    try {
+      cache = std::make_unique<DigestCache>(cache_path, rehash);
+    } catch (const std::system_error &e) {
+      std::fprintf(stderr, "%s: %s\n", argv[0], e.what());
+      return EXIT_FAILURE;
+    }
+  }
+
+  const auto start = std::chrono::steady_clock::now();
+  WorkStealingPool pool(threads);
+  ManifestStats stats;
+  std::vector<ManifestEntry> manifest;
+  switch (bits) {
+  case 1:
+    manifest = build<SHA1>(pool, argv[i], stats, cache.get());
+    break;
+  case 256:
+    manifest = build<SHA256>(pool, argv[i], stats, cache.get());
+    break;
+  default:
+    manifest = build<SHA512>(pool, argv[i], stats, cache.get());
+    break;
+  }
+  const double sec = std::chrono::duration<double>(
+                         std::chrono::steady_clock::now() - start)
+                         .count();
+
+  for (auto &&e : manifest) {
+    std::fputs(format_manifest_line(e).c_str(), stdout);
+  }
+  for (auto &&e : stats.errors) {
+    std::fprintf(stderr, "%s: %s\n", argv[0], e.c_str());
+  }
+  std::fprintf(stderr,
+               "%llu files, %llu bytes in %.3f s (%.1f files/s, %.3f GB/s) "
+               "with %zu threads\n",
+               static_cast<unsigned long long>(stats.files),
+               static_cast<unsigned long long>(stats.bytes), sec,
+               stats.files / sec, stats.bytes / sec / 1e9, pool.size());
+  if (cache != nullptr) {
+    std::fprintf(stderr, "cache: %llu hit(s), %llu miss(es)\n",
+                 static_cast<unsigned long long>(cache->hits()),
+                 static_cast<unsigned long long>(cache->misses()));
+    if (!cache->flush()) {
+      std::fprintf(stderr, "%s: %s: could not update the cache\n", argv[0],
+                   cache_path);
+    }
+  }
+  return stats.errors.empty() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
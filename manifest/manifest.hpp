@@ -0,0 +1,250 @@
+/**
+ * @brief ディレクトリ以下の全てのファイルのハッシュ値を一覧(manifest)にする
+ * @note  ディレクトリの走査とファイルのハッシュ計算を1つずつ仕事として
+ *        ワークスティーリング方式のスレッドプールに分配する
+ *        大きなファイルはsegment_sizeごとの仕事に分け、続きを改めて投入する
+ *        (1つの巨大なファイルがスレッドを長時間占有しないようにする)
+ *        DigestCacheを指定すると、変わっていないファイルは開かずに記録を使う
+ */
+
+#ifndef MANIFEST_HPP
+#define MANIFEST_HPP
+
+#include "../digest_cache.hpp"
+#include "../hex.hpp"
+#include "../mapped_file.hpp"
+#include "../sha1/sha1.hpp"
+#include "../sha256/sha256.hpp"
+#include "../sha512/sha512.hpp"
+#include "../work_stealing_pool.hpp"
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * @brief manifestの1行(1つのファイル)
+ */
+struct ManifestEntry {
+  std::string path;   // ルートからの相対パス('/'区切り)
+  std::uint64_t size; // ファイルの大きさ(byte)
+  std::string digest; // ハッシュ値(小文字の16進数)
+
+  bool operator<(const ManifestEntry &rhs) const { return path < rhs.path; }
+};
+
+/**
+ * @brief manifestの集計
+ */
+struct ManifestStats {
+  std::uint64_t files = 0;
+  std::uint64_t bytes = 0;
+  std::vector<std::string> errors; // 読めなかったファイルやディレクトリ
+};
+
+/**
+ * @brief  manifestの1行を書式化する: "<digest>  <size>  <path>\n"
+ * @note   パス中の'\\'と改行は"\\\\", "\\n"にエスケープし、1行に収める
+ */
+inline std::string format_manifest_line(const ManifestEntry &e) {
+  std::string line = e.digest + "  " + std::to_string(e.size) + "  ";
+  for (char c : e.path) {
+    if (c == '\\') {
+      line += "\\\\";
+    } else if (c == '\n') {
+      line += "\\n";
+    } else {
+      line += c;
+    }
+  }
+  line += '\n';
+  return line;
+}
+
+/**
+ * @tparam Hasher SHA1, SHA256, SHA512などのハッシュクラス
+ */
+template <class Hasher> class ManifestBuilder {
+public:
+  /**< @brief 大きなファイルを分割する単位(byte) */
+  static constexpr std::size_t default_segment_size = std::size_t(16) << 20;
+
+  /**
+   * @param  WorkStealingPool& pool   仕事を分配するスレッドプール
+   * @param  std::size_t segment_size 1つの仕事で計算するbyte数
+   *         ページ長の倍数であること
+   */
+  explicit ManifestBuilder(WorkStealingPool &pool,
+                           std::size_t segment_size = default_segment_size)
+      : pool(pool), segment_size(segment_size), results(pool.size()) {}
+
+  /**
+   * @brief  ハッシュ値のキャッシュを使う(nullptrなら使わない)
+   * @note   build()の間、cacheは複数のスレッドから使われる
+   */
+  void use_cache(DigestCache *cache) { this->cache = cache; }
+
+  /**
+   * @brief  ディレクトリ以下の全ての通常ファイルのハッシュ値を求める
+   * @return パスの昇順に並べたmanifest
+   * @note   シンボリックリンクはたどらない
+   */
+  std::vector<ManifestEntry> build(const std::string &root,
+                                   ManifestStats &stats) {
+    this->root = root;
+    pool.submit([this] { walk(std::string()); });
+    pool.wait();
+
+    std::vector<ManifestEntry> manifest;
+    for (auto &&r : results) {
+      std::move(r.begin(), r.end(), std::back_inserter(manifest));
+      r.clear();
+    }
+    std::sort(manifest.begin(), manifest.end());
+
+    for (auto &&e : manifest) {
+      stats.files++;
+      stats.bytes += e.size;
+    }
+    std::sort(errors.begin(), errors.end());
+    stats.errors = std::move(errors);
+    errors.clear();
+    return manifest;
+  }
+
+private:
+  /**
+   * @brief 大きなファイルを分割して計算する間の途中経過
+   */
+  struct Job {
+    Job(const std::string &root, std::string rel)
+        : path(std::move(rel)), file(root + "/" + path) {}
+
+    std::string path;
+    MappedFile file;
+    Hasher hasher;
+    std::size_t offset = 0;
+
+    /**< @brief キャッシュを使う場合の、計算を始める前のstat() */
+    struct stat st {};
+  };
+
+  /**
+   * @brief  ディレクトリを1段だけ走査し、見つけたものを仕事として投入する
+   */
+  void walk(const std::string &dir) {
+    namespace fs = std::filesystem;
+    std::error_code ec;
+    fs::directory_iterator it(root + "/" + dir, ec);
+    for (; !ec && it != fs::directory_iterator(); it.increment(ec)) {
+      const std::string rel =
+          (dir.empty() ? std::string() : dir + "/") +
+          it->path().filename().string();
+      const fs::file_status st = it->symlink_status(ec);
+      if (ec) {
+        // 走査の途中で消えたファイルなど、その項目だけを読めなかったものとする
+        fail(rel, ec.message());
+        ec.clear();
+        continue;
+      }
+      if (fs::is_directory(st)) {
+        pool.submit([this, rel] { walk(rel); });
+      } else if (fs::is_regular_file(st)) {
+        pool.submit([this, rel] { start(rel); });
+      }
+    }
+    if (ec) {
+      fail(dir.empty() ? std::string(".") : dir, ec.message());
+    }
+  }
+
+  /**
+   * @brief  ファイルを開き、小さければその場で、大きければ分割して計算する
+   */
+  void start(const std::string &rel) {
+    struct stat st;
+    if (cache != nullptr && ::stat((root + "/" + rel).c_str(), &st) == 0 &&
+        S_ISREG(st.st_mode)) {
+      typename Hasher::digest_type M;
+      if (cache->lookup(st, CacheAlgorithm<Hasher>::id, M.data(), M.size())) {
+        results[pool.worker_index()].push_back(
+            {rel, static_cast<std::uint64_t>(st.st_size), to_hex(M)});
+        return;
+      }
+    }
+
+    std::shared_ptr<Job> job;
+    try {
+      job = std::make_shared<Job>(root, rel);
+      if (cache != nullptr &&
+          ::fstat(job->file.descriptor(), &job->st) != 0) {
+        job->st.st_mode = 0;
+      }
+      if (!job->file.mapped()) {
+        // 空のファイル、あるいはマップできないファイル
+        const std::uint64_t n = feed_descriptor(
+            job->hasher, job->file.descriptor(), job->path);
+        finish(*job, n);
+        return;
+      }
+    } catch (const std::system_error &e) {
+      fail(rel, e.code().message());
+      return;
+    }
+    resume(job);
+  }
+
+  /**
+   * @brief  segment_size分を計算し、残りがあれば続きを投入する
+   */
+  void resume(const std::shared_ptr<Job> &job) {
+    const std::size_t size = job->file.size();
+    const std::size_t last = std::min(size, job->offset + segment_size);
+    try {
+      job->file.feed(job->hasher, job->offset, last);
+    } catch (const std::system_error &e) {
+      // 計算している間に切り詰められたファイル
+      fail(job->path, e.code().message());
+      return;
+    }
+    job->offset = last;
+    if (last < size) {
+      pool.submit([this, job] { resume(job); });
+      return;
+    }
+    finish(*job, size);
+  }
+
+  void finish(Job &job, std::uint64_t size) {
+    const auto M = job.hasher.finalize();
+    struct stat st;
+    // 計算している間に書き換えられたファイルは記録しない
+    if (cache != nullptr && S_ISREG(job.st.st_mode) &&
+        ::fstat(job.file.descriptor(), &st) == 0 &&
+        st.st_size == job.st.st_size &&
+        st.st_mtim.tv_sec == job.st.st_mtim.tv_sec &&
+        st.st_mtim.tv_nsec == job.st.st_mtim.tv_nsec) {
+      cache->insert(job.st, CacheAlgorithm<Hasher>::id, M.data(), M.size());
+    }
+    results[pool.worker_index()].push_back(
+        {std::move(job.path), size, to_hex(M)});
+  }
+
+  void fail(const std::string &path, const std::string &message) {
+    std::lock_guard<std::mutex> lock(mutex);
+    errors.push_back(path + ": " + message);
+  }
+
+  WorkStealingPool &pool;
+  const std::size_t segment_size;
+  std::string root;
+  DigestCache *cache = nullptr;
+
+  /**< @brief スレッドごとの結果(ロックせずに追加できるよう分けておく) */
+  std::vector<std::vector<ManifestEntry>> results;
+
+  std::mutex mutex;
+  std::vector<std::string> errors;
+};
+
+#endif // end of MANIFEST_HPP
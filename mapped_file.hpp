@@ -0,0 +1,264 @@
+/**
+ * @brief ファイルをメモリにマップし、コピーせずにハッシュ関数へ渡す
+ * @note  POSIX(mmap, madvise)を前提とする
+ *        数GBのファイルでもstd::vectorに読み込まず、ページキャッシュを直接参照する
+ * @note  マップしている間にファイルが切り詰められると、末尾を越えたページへの
+ *        アクセスはSIGBUSとなる(ログのローテーションなど)
+ *        feed()はSIGBUSを捕まえてstd::system_error(EIO)に変えるので、
+ *        プロセスは終了せず、そのファイルだけが読めなかったことになる
+ *        マップした領域を直接読む場合はguard_sigbus()で囲むこと
+ */
+
+#ifndef MAPPED_FILE_HPP
+#define MAPPED_FILE_HPP
+
+#include <algorithm>
+#include <cerrno>
+#include <csetjmp>
+#include <csignal>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace mapped_file_detail {
+
+/**< @brief このスレッドでSIGBUSを捕まえている場合の戻り先 */
+inline thread_local sigjmp_buf *sigbus_target = nullptr;
+
+/**< @brief guard_sigbus()が設定する前のSIGBUSの処理 */
+inline struct sigaction previous_sigbus;
+
+inline void on_sigbus(int sig, siginfo_t *info, void *context) {
+  if (sigbus_target != nullptr) {
+    siglongjmp(*sigbus_target, 1);
+  }
+  // 捕まえていないスレッドでのSIGBUSは、元の処理に任せる
+  // (既定の処理なら、戻った後に同じアクセスで改めてSIGBUSとなり終了する)
+  if (previous_sigbus.sa_flags & SA_SIGINFO) {
+    previous_sigbus.sa_sigaction(sig, info, context);
+  } else if (previous_sigbus.sa_handler != SIG_IGN &&
+             previous_sigbus.sa_handler != SIG_DFL) {
+    previous_sigbus.sa_handler(sig);
+  } else {
+    ::sigaction(sig, &previous_sigbus, nullptr);
+  }
+}
+
+/**
+ * @brief  SIGBUSの処理を一度だけ設定する
+ */
+inline void install_sigbus_handler() {
+  static const bool installed = [] {
+    struct sigaction sa {};
+    sa.sa_sigaction = on_sigbus;
+    sa.sa_flags = SA_SIGINFO | SA_NODEFER;
+    sigemptyset(&sa.sa_mask);
+    return ::sigaction(SIGBUS, &sa, &previous_sigbus) == 0;
+  }();
+  (void)installed;
+}
+
+} // namespace mapped_file_detail
+
+/**
+ * @brief  マップした領域を読むf()を呼び出し、SIGBUSをstd::system_errorに変える
+ * @param  const std::string& name エラーメッセージに使う名前
+ * @note   SIGBUSはf()を呼び出したスレッドで起きたものだけを捕まえる
+ *         SIGBUSで中断したf()の途中の状態(ハッシュの途中経過など)は不定なので、
+ *         例外を受け取った側で捨てること
+ */
+template <class F> void guard_sigbus(const std::string &name, F &&f) {
+  mapped_file_detail::install_sigbus_handler();
+
+  // f()が例外を送出した場合も含め、抜けるときに必ず元の戻り先に戻す
+  struct Restore {
+    sigjmp_buf *const outer = mapped_file_detail::sigbus_target;
+    ~Restore() { mapped_file_detail::sigbus_target = outer; }
+  } restore;
+
+  sigjmp_buf target;
+  if (sigsetjmp(target, 1) != 0) {
+    throw std::system_error(EIO, std::generic_category(),
+                            name + " (truncated while mapped)");
+  }
+  mapped_file_detail::sigbus_target = &target;
+  f();
+}
+
+/**
+ * @brief 読み込み専用でマップしたファイル
+ * @note  空のファイル、あるいはパイプなどのマップできないファイルは
+ *        mapped() == falseとなり、呼び出し側でread()による読み込みに切り替える
+ */
+class MappedFile {
+public:
+  /**< @brief ハッシュ関数に一度に渡す大きさ(先読みの単位) */
+  static constexpr std::size_t window_size = std::size_t(64) << 20;
+
+  /**
+   * @brief  ファイルを開き、通常のファイルであればマップする
+   * @param  const std::string& path ファイルのパス
+   * @param  std::size_t min_size    これより小さなファイルはマップしない
+   *         (1回のread()で読めるなら、mmap/munmapより安い)
+   * @note   開けなければstd::system_errorを送出する
+   */
+  explicit MappedFile(const std::string &path, std::size_t min_size = 0)
+      : name(path) {
+    fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+      throw std::system_error(errno, std::generic_category(), path);
+    }
+    struct stat st;
+    if (::fstat(fd, &st) < 0) {
+      const int err = errno;
+      ::close(fd);
+      throw std::system_error(err, std::generic_category(), path);
+    }
+    if (static_cast<std::uint64_t>(st.st_size) >= min_size) {
+      map(st);
+    }
+  }
+
+  /**
+   * @brief  開いているファイルディスクリプタを、通常のファイルであればマップする
+   * @note   fdは閉じない(標準入力など、呼び出し側が所有するもの)
+   *         fstat()に失敗すればマップしない
+   * @param  const std::string& name エラーメッセージに使う名前
+   */
+  explicit MappedFile(int descriptor, const std::string &name = "-")
+      : name(name), fd(descriptor), owned(false) {
+    struct stat st;
+    if (::fstat(fd, &st) == 0) {
+      map(st);
+    }
+  }
+
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+
+  ~MappedFile() {
+    if (addr != nullptr) {
+      ::munmap(const_cast<std::uint8_t *>(addr), len);
+    }
+    if (owned) {
+      ::close(fd);
+    }
+  }
+
+  /**
+   * @brief  マップできたか判定する
+   */
+  bool mapped() const { return addr != nullptr; }
+
+  /**
+   * @brief  ファイルディスクリプタを返す(マップできなかったときの読み込み用)
+   */
+  int descriptor() const { return fd; }
+
+  const std::uint8_t *data() const { return addr; }
+  std::size_t size() const { return len; }
+
+  /**
+   * @brief  ファイル全体をwindow_sizeずつhasher.update()に渡す
+   * @note   次の区間をMADV_WILLNEEDで先読みさせ、計算とI/Oを重ねる
+   *         計算を終えた区間はMADV_DONTNEEDで手放し、常駐メモリを抑える
+   *         途中でファイルが切り詰められればstd::system_error(EIO)を送出する
+   */
+  template <class Hasher> void feed(Hasher &hasher) const {
+    feed(hasher, 0, len);
+  }
+
+  /**
+   * @brief  ファイルの[first, last)の区間をwindow_sizeずつhasher.update()に渡す
+   * @note   firstはページ長の倍数であること
+   *         大きなファイルを複数の仕事に分けて順に計算する場合に使う
+   */
+  template <class Hasher>
+  void feed(Hasher &hasher, std::size_t first, std::size_t last) const {
+    for (std::size_t off = first; off < last; off += window_size) {
+      const std::size_t n = std::min(window_size, last - off);
+      if (off + n < len) {
+        advise(off + n, std::min(window_size, len - off - n), MADV_WILLNEED);
+      }
+      guard_sigbus(name, [&] { hasher.update(addr + off, n); });
+      advise(off, n, MADV_DONTNEED);
+    }
+  }
+
+private:
+  void map(const struct stat &st) {
+    if (!S_ISREG(st.st_mode) || st.st_size == 0) {
+      return;
+    }
+
+    len = static_cast<std::size_t>(st.st_size);
+    void *p = ::mmap(nullptr, len, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (p == MAP_FAILED) {
+      len = 0;
+      return;
+    }
+    addr = static_cast<const std::uint8_t *>(p);
+
+    // 先頭から順に一度だけ読むことをカーネルに伝え、先読みを大きくする
+    ::madvise(p, len, MADV_SEQUENTIAL);
+    ::posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+  }
+
+  void advise(std::size_t off, std::size_t n, int advice) const {
+    // window_sizeはページ長の倍数なので、offは常にページ境界にある
+    // (firstを指定した場合はfirstがページ長の倍数であることを要求する)
+    ::madvise(const_cast<std::uint8_t *>(addr) + off, n, advice);
+  }
+
+  std::string name;
+  int fd = -1;
+  bool owned = true;
+  const std::uint8_t *addr = nullptr;
+  std::size_t len = 0;
+};
+
+/**
+ * @brief  ファイルディスクリプタから終端まで読み込み、hasherに渡す
+ * @param  std::uint8_t* buf 読み込みに使うバッファ(何度でも使い回す)
+ * @param  std::size_t size  バッファのbyte数
+ * @return 読み込んだbyte数
+ * @note   マップできないファイル(パイプ、標準入力など)に使う
+ *         読み込みに失敗するとstd::system_errorを送出する
+ */
+template <class Hasher>
+std::uint64_t feed_descriptor(Hasher &hasher, int fd, const std::string &name,
+                              std::uint8_t *buf, std::size_t size) {
+  std::uint64_t total = 0;
+  for (;;) {
+    const ssize_t n = ::read(fd, buf, size);
+    if (n == 0) {
+      return total;
+    }
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      throw std::system_error(errno, std::generic_category(), name);
+    }
+    hasher.update(buf, static_cast<std::size_t>(n));
+    total += static_cast<std::size_t>(n);
+  }
+}
+
+/**
+ * @brief  64 KiBのバッファを確保してfeed_descriptor()を呼び出す
+ */
+template <class Hasher>
+std::uint64_t feed_descriptor(Hasher &hasher, int fd, const std::string &name) {
+  std::vector<std::uint8_t> buf(1 << 16);
+  return feed_descriptor(hasher, fd, name, buf.data(), buf.size());
+}
+
+#endif // end of MAPPED_FILE_HPP
@@ -2,30 +2,34 @@
 #define MATCHER_HPP
 
 #include <algorithm>
-#include <sstream>
+#include <array>
 #include <string>
+#include <string_view>
 #include <vector>
 
 #include "catch2/catch.hpp"
-
-#define FMT_HEADER_ONLY
-#include "fmt/format.h"
+#include "hex.hpp"
 
 // The mather class
 class BytesMatcher : public Catch::MatcherBase<std::vector<uint8_t>> {
 public:
+  // 期待するダイジェストは一度だけbyte列にし、以後はbyte列のまま比べる
   explicit BytesMatcher(const std::string &digest) : digest(digest) {
-    std::copy(digest.cbegin(), digest.cend(), std::back_inserter(rhs));
-    rhs.erase(std::remove(rhs.begin(), rhs.end(), ' '), rhs.cend());
+    std::string hex = digest;
+    hex.erase(std::remove(hex.begin(), hex.end(), ' '), hex.cend());
+    rhs.resize(hex.size() / 2);
+    valid = hex.size() % 2 == 0 && from_hex(hex.data(), rhs.size(), rhs.data());
   }
 
   bool match(const std::vector<std::uint8_t> &bytes) const override {
-    std::ostringstream ss;
-    for (auto &&b : bytes) {
-      ss << fmt::format("{:02x}", static_cast<unsigned>(b));
-    }
-    const auto lhs = ss.str();
-    return lhs == rhs;
+    return valid && bytes == rhs;
+  }
+
+  // finalize()などが返す固定長のダイジェスト用
+  template <std::size_t N>
+  bool match(const std::array<std::uint8_t, N> &bytes) const {
+    return valid && std::equal(bytes.cbegin(), bytes.cend(), rhs.cbegin(),
+                               rhs.cend());
   }
 
   virtual std::string describe() const override {
@@ -34,7 +38,8 @@ public:
 
 private:
   std::string digest;
-  std::string rhs;
+  std::vector<std::uint8_t> rhs;
+  bool valid;
 };
 
 // The builder function
@@ -42,4 +47,25 @@ inline BytesMatcher expect(const std::string &digest) {
   return BytesMatcher(digest);
 }
 
+// コンパイル時に計算したダイジェストを16進数表記と比べる(static_assert用)
+template <std::size_t N>
+constexpr bool digest_is(const std::array<std::uint8_t, N> &bytes,
+                         std::string_view hex) {
+  const auto nibble = [](char c) {
+    return c <= '9' ? c - '0' : c - 'a' + 10;
+  };
+  std::size_t j = 0;
+  for (std::size_t i = 0; i < N; i++) {
+    while (j < hex.size() && hex[j] == ' ') {
+      j++;
+    }
+    if (j + 1 >= hex.size() ||
+        bytes[i] != nibble(hex[j]) * 16 + nibble(hex[j + 1])) {
+      return false;
+    }
+    j += 2;
+  }
+  return j == hex.size();
+}
+
 #endif
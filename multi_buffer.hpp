@@ -0,0 +1,197 @@
+/**
+ * @brief 複数の独立したメッセージをSIMDのレーンに割り当てて並列にハッシュ化する
+ * @note  Intelのmulti-buffer方式に倣い、各レーンが別々のメッセージを受け持つ
+ *        長さの異なるメッセージは、終わったレーンから順に次のメッセージへ差し替える
+ */
+
+#ifndef MULTI_BUFFER_HPP
+#define MULTI_BUFFER_HPP
+
+#include "bit.hpp"
+#include "stats.hpp"
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @tparam Hasher SHA256, SHA512などのハッシュクラス
+ *         word_type, block_size, digest_type, IV, compress(), stats()を持つこと
+ * @tparam Lanes  1回のカーネル呼び出しで同時に圧縮するブロック数
+ */
+template <class Hasher, std::size_t Lanes> class MultiBuffer {
+public:
+  using word_type = typename Hasher::word_type;
+  using digest_type = typename Hasher::digest_type;
+
+  /**< @brief ハッシュ値を構成するwordの個数 */
+  static constexpr std::size_t words = std::tuple_size<decltype(Hasher::IV)>();
+
+  /**< @brief メッセージ長を格納する領域の大きさ(byte) */
+  static constexpr std::size_t length_size = Hasher::block_size / 8;
+
+  /**
+   * @brief 各レーンのブロックを1つずつ圧縮するカーネルの型
+   * @note  ハッシュ値はS[i * Lanes + lane]の配置(SoA)で保持する
+   */
+  using kernel_fn = void (*)(word_type *S, const std::uint8_t *const *blocks);
+
+  /**
+   * @brief  n個のメッセージをハッシュ化する
+   * @param  kernel_fn kernel        Lanes個のブロックを同時に圧縮するカーネル
+   * @param  std::size_t n           メッセージの個数
+   * @param  const void* const* data 各メッセージの先頭
+   * @param  const std::size_t* len  各メッセージのbyte数
+   * @param  digest_type* M          各メッセージのハッシュ値の書き込み先
+   * @param  const word_type* iv     各レーンの初期ハッシュ値
+   * @param  std::uint64_t offset    ivまでに取り込み済みのbyte数(ブロック長の倍数)
+   * @note   共通の接頭辞を圧縮した状態をivに与えると、続きだけを計算できる
+   */
+  static void run(kernel_fn kernel, std::size_t n, const void *const *data,
+                  const std::size_t *len, digest_type *M,
+                  const word_type *iv = Hasher::IV.data(),
+                  std::uint64_t offset = 0) {
+    alignas(64) word_type S[words * Lanes];
+    Lane lanes[Lanes];
+    const std::uint8_t *blocks[Lanes];
+    std::size_t next = 0;   // 次にレーンへ割り当てるメッセージ
+    std::size_t active = 0; // 計算中のレーン数
+
+    // 空いたレーンに次のメッセージを割り当てる
+    const auto assign = [&](std::size_t l) {
+      if (next == n) {
+        lanes[l].job = n;
+        return;
+      }
+      lanes[l].start(next, data[next], len[next], offset);
+      for (std::size_t i = 0; i < words; i++) {
+        S[i * Lanes + l] = iv[i];
+      }
+      next++;
+      active++;
+    };
+
+    for (std::size_t l = 0; l < Lanes; l++) {
+      assign(l);
+    }
+
+    while (active > 0) {
+      // 残りが少なければ、空きレーンに無駄な計算をさせずに1本ずつ仕上げる
+      if (next == n && active * 2 <= Lanes) {
+        for (std::size_t l = 0; l < Lanes; l++) {
+          if (lanes[l].job < n) {
+            finish(lanes[l], S, l, M);
+          }
+        }
+        return;
+      }
+
+      // 空きレーンには読み捨てるためのゼロブロックを与える
+      for (std::size_t l = 0; l < Lanes; l++) {
+        blocks[l] = lanes[l].job < n ? lanes[l].block() : zero_block.data();
+      }
+      kernel(S, blocks);
+      if constexpr (stats_enabled) {
+        Hasher::stats().add_blocks(Hasher::batch_backend(), active);
+      }
+
+      // 最終ブロックまで圧縮したレーンを退役させ、次のメッセージを割り当てる
+      for (std::size_t l = 0; l < Lanes; l++) {
+        if (lanes[l].job < n && ++lanes[l].done == lanes[l].total) {
+          output(S, l, M[lanes[l].job]);
+          active--;
+          assign(l);
+        }
+      }
+    }
+  }
+
+private:
+  /**
+   * @brief 1つのレーンが受け持つメッセージの進捗
+   */
+  struct Lane {
+    std::size_t job;       // メッセージの番号(未割り当てならn)
+    const std::uint8_t *p; // メッセージ本体の先頭
+    std::size_t body;      // メッセージ本体のブロック数
+    std::size_t total;     // パディング後のブロック数
+    std::size_t done;      // 圧縮済みのブロック数
+
+    // パディングを施した最終ブロック(1つまたは2つ)
+    alignas(16) std::uint8_t tail[2 * Hasher::block_size];
+
+    void start(std::size_t i, const void *data, std::size_t len,
+               std::uint64_t offset) {
+      job = i;
+      p = static_cast<const std::uint8_t *>(data);
+      body = len / Hasher::block_size;
+      total = body + padding(tail, p + body * Hasher::block_size,
+                             len % Hasher::block_size, offset + len);
+      done = 0;
+    }
+
+    const std::uint8_t *block() const {
+      return done < body ? p + done * Hasher::block_size
+                         : tail + (done - body) * Hasher::block_size;
+    }
+  };
+
+  /**
+   * @brief  メッセージの端数に M || 1 || 0k || l のパディングを施す
+   * @return パディング後のブロック数(1または2)
+   */
+  static std::size_t padding(std::uint8_t *tail, const std::uint8_t *rest,
+                             std::size_t r, std::uint64_t msglen) {
+    const std::size_t nblocks =
+        r + 1 + length_size <= Hasher::block_size ? 1 : 2;
+    const std::size_t padded_len = nblocks * Hasher::block_size;
+    std::copy(rest, rest + r, tail);
+    tail[r] = 0b10000000;
+    std::fill(tail + r + 1, tail + padded_len - 8, 0x00);
+    if constexpr (length_size == 16) {
+      store_be64(tail + padded_len - 16, msglen >> 61);
+    }
+    store_be64(tail + padded_len - 8, msglen * 8);
+    return nblocks;
+  }
+
+  /**
+   * @brief 残りのブロックを単一ストリームの圧縮関数で仕上げる
+   */
+  static void finish(Lane &lane, word_type *S, std::size_t l,
+                     digest_type *M) {
+    word_type H[words];
+    for (std::size_t i = 0; i < words; i++) {
+      H[i] = S[i * Lanes + l];
+    }
+    if (lane.done < lane.body) {
+      Hasher::compress(H, lane.block(), lane.body - lane.done);
+      lane.done = lane.body;
+    }
+    Hasher::compress(H, lane.block(), lane.total - lane.done);
+    for (std::size_t i = 0; i < words; i++) {
+      S[i * Lanes + l] = H[i];
+    }
+    output(S, l, M[lane.job]);
+  }
+
+  /**
+   * @brief レーンlのハッシュ値をbyte列として書き出す
+   */
+  static void output(const word_type *S, std::size_t l, digest_type &M) {
+    std::uint8_t bytes[words * sizeof(word_type)];
+    for (std::size_t i = 0; i < words; i++) {
+      if constexpr (sizeof(word_type) == 4) {
+        store_be32(bytes + i * 4, S[i * Lanes + l]);
+      } else {
+        store_be64(bytes + i * 8, S[i * Lanes + l]);
+      }
+    }
+    std::copy(bytes, bytes + M.size(), M.begin());
+  }
+
+  /**< @brief 空きレーンに与えるブロック */
+  inline static const std::array<std::uint8_t, Hasher::block_size> zero_block{};
+};
+
+#endif // end of MULTI_BUFFER_HPP
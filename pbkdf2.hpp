@@ -0,0 +1,226 @@
+/**
+ * @brief 反復計算をSIMDレーンに並べるPBKDF2-HMAC
+ * @note  RFC 8018: DK = T1 || T2 || ...
+ *                  Ti = U1 ^ U2 ^ ... ^ Uc
+ *                  U1 = HMAC(P, S || INT(i)), Uj = HMAC(P, Uj-1)
+ *        Uj-1は常にdigest_size byteなので、内側と外側のどちらも1ブロックの圧縮で済む
+ *        鍵ブロックの状態(midstate)と、パディング済みのブロックは反復の前に一度だけ作り、
+ *        反復ごとの圧縮は(候補のパスワード, 出力ブロック)の組をレーンに割り当てて行う
+ */
+
+#ifndef PBKDF2_HPP
+#define PBKDF2_HPP
+
+#include "bit.hpp"
+#include "hmac.hpp"
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @tparam Hasher SHA256, SHA512などのハッシュクラス
+ *         IV, compress(), batch_kernel()を持つこと
+ */
+template <class Hasher> class PBKDF2 {
+public:
+  using word_type = typename Hasher::word_type;
+
+  static constexpr std::size_t block_size = Hasher::block_size;
+  static constexpr std::size_t digest_size = Hasher::digest_size;
+
+  /**
+   * @brief  1つのパスワードから鍵を導出する
+   * @param  const void* pw           パスワードの先頭
+   * @param  std::size_t pwlen       パスワードのbyte数
+   * @param  const void* salt         ソルトの先頭
+   * @param  std::size_t saltlen     ソルトのbyte数
+   * @param  std::uint32_t c         反復回数(0は1として扱う)
+   * @param  std::uint8_t* dk        導出した鍵の書き込み先
+   * @param  std::size_t dklen       導出する鍵のbyte数
+   * @note   dklenがdigest_sizeより長ければ、出力ブロックをレーンに並べる
+   */
+  static void derive(const void *pw, std::size_t pwlen, const void *salt,
+                     std::size_t saltlen, std::uint32_t c, std::uint8_t *dk,
+                     std::size_t dklen) {
+    const void *const P[1] = {pw};
+    const std::size_t L[1] = {pwlen};
+    std::uint8_t *const D[1] = {dk};
+    derive_many(1, P, L, salt, saltlen, c, D, dklen);
+  }
+
+  /**
+   * @brief  共通のソルトと反復回数で、複数のパスワードから鍵を導出する
+   * @param  std::size_t n              パスワードの個数
+   * @param  const void* const* pw      各パスワードの先頭
+   * @param  const std::size_t* pwlen   各パスワードのbyte数
+   * @param  std::uint8_t* const* dk    各鍵の書き込み先(dklen byte)
+   * @note   パスワードの候補を総当たりで検証する用途などに使う
+   */
+  static void derive_many(std::size_t n, const void *const *pw,
+                          const std::size_t *pwlen, const void *salt,
+                          std::size_t saltlen, std::uint32_t c,
+                          std::uint8_t *const *dk, std::size_t dklen) {
+    const std::size_t blocks = (dklen + digest_size - 1) / digest_size;
+    const std::size_t jobs = n * blocks;
+    for (std::size_t first = 0; first < jobs;) {
+      // 残りの仕事が少なければ、レーンを埋められないので1つずつ計算する
+      const auto kernel = Hasher::batch_kernel(jobs - first);
+      Lanes lanes(kernel);
+      const std::size_t m = std::min(kernel.lanes, jobs - first);
+      for (std::size_t j = 0; j < m; j++) {
+        const std::size_t k = (first + j) / blocks;
+        lanes.start(j, pw[k], pwlen[k], salt, saltlen,
+                    static_cast<std::uint32_t>((first + j) % blocks + 1));
+      }
+      lanes.iterate(c);
+      for (std::size_t j = 0; j < m; j++) {
+        const std::size_t k = (first + j) / blocks;
+        const std::size_t off = (first + j) % blocks * digest_size;
+        lanes.output(j, dk[k] + off, std::min(digest_size, dklen - off));
+      }
+      first += m;
+    }
+  }
+
+private:
+  /**< @brief ハッシュ値のword数(SHA-224などの派生版ではdigest_sizeより長い) */
+  static constexpr std::size_t words = Hasher::IV.size();
+  static constexpr std::size_t max_lanes = Hasher::max_lanes;
+
+  /**
+   * @brief  各レーンが1つの(パスワード, 出力ブロック)のTiを計算する
+   * @note   状態は全てSoA(X[w * lanes + lane])で持ち、ヒープを確保しない
+   *         使わないレーンはゼロのブロックを圧縮し、結果を捨てる
+   */
+  struct Lanes {
+    explicit Lanes(typename Hasher::BatchKernel kernel) : kernel(kernel) {
+      for (std::size_t j = 0; j < max_lanes; j++) {
+        ptr[j] = block[j].data();
+      }
+    }
+
+    /**
+     * @brief  レーンjの鍵ブロックの状態とU1を求め、Uのブロックを用意する
+     */
+    void start(std::size_t j, const void *pw, std::size_t pwlen,
+               const void *salt, std::size_t saltlen, std::uint32_t i) {
+      const auto ipad = HMAC<Hasher>::key_block(pw, pwlen, 0x36);
+      const auto opad = HMAC<Hasher>::key_block(pw, pwlen, 0x5c);
+      std::array<word_type, words> H = Hasher::IV;
+      Hasher::compress(H.data(), ipad.data(), 1);
+      scatter(inner, j, H.data());
+      H = Hasher::IV;
+      Hasher::compress(H.data(), opad.data(), 1);
+      scatter(outer, j, H.data());
+
+      std::uint8_t be[4];
+      store_be32(be, i);
+      HMAC<Hasher> mac(pw, pwlen);
+      mac.update(salt, saltlen);
+      mac.update(be, sizeof(be));
+      const auto U = mac.finalize();
+
+      // U || 0x80 || 0 ... || 鍵ブロックを含めたbit長
+      // 以降の反復では先頭のdigest_size byteだけを書き換える
+      auto &b = block[j];
+      std::copy(U.begin(), U.end(), b.begin());
+      b[digest_size] = 0x80;
+      store_be64(b.data() + block_size - 8, (block_size + digest_size) * 8);
+      std::uint8_t t[words * sizeof(word_type)] = {};
+      std::copy(U.begin(), U.end(), t);
+      for (std::size_t w = 0; w < words; w++) {
+        T[w * kernel.lanes + j] = load(t + w * sizeof(word_type));
+      }
+    }
+
+    /**
+     * @brief  U2, ..., Ucを求め、Tに排他的論理和をとる
+     */
+    void iterate(std::uint32_t c) {
+      alignas(64) word_type S[words * max_lanes];
+      const std::size_t n = words * kernel.lanes;
+      for (std::uint32_t r = 1; r < c; r++) {
+        std::copy(inner, inner + n, S);
+        kernel.compress(S, ptr);
+        gather(S);
+        std::copy(outer, outer + n, S);
+        kernel.compress(S, ptr);
+        gather(S);
+        for (std::size_t x = 0; x < n; x++) {
+          T[x] ^= S[x];
+        }
+      }
+    }
+
+    /**
+     * @brief  レーンjのTiの先頭len byteを書き込む
+     */
+    void output(std::size_t j, std::uint8_t *out, std::size_t len) const {
+      std::uint8_t t[words * sizeof(word_type)];
+      for (std::size_t w = 0; w < words; w++) {
+        store(t + w * sizeof(word_type), T[w * kernel.lanes + j]);
+      }
+      std::copy(t, t + len, out);
+    }
+
+  private:
+    void scatter(word_type *X, std::size_t j, const word_type *H) {
+      for (std::size_t w = 0; w < words; w++) {
+        X[w * kernel.lanes + j] = H[w];
+      }
+    }
+
+    /**
+     * @brief  圧縮したハッシュ値を、次の圧縮の入力(ブロックの先頭)に書き戻す
+     * @note   ハッシュ値を切り詰める派生版では、先頭のdigest_size byteだけを書く
+     */
+    void gather(const word_type *S) {
+      for (std::size_t j = 0; j < kernel.lanes; j++) {
+        if constexpr (digest_size == words * sizeof(word_type)) {
+          for (std::size_t w = 0; w < words; w++) {
+            store(block[j].data() + w * sizeof(word_type),
+                  S[w * kernel.lanes + j]);
+          }
+        } else {
+          std::uint8_t t[words * sizeof(word_type)];
+          for (std::size_t w = 0; w < words; w++) {
+            store(t + w * sizeof(word_type), S[w * kernel.lanes + j]);
+          }
+          std::copy(t, t + digest_size, block[j].begin());
+        }
+      }
+    }
+
+    static word_type load(const std::uint8_t *p) {
+      if constexpr (sizeof(word_type) == 4) {
+        return load_be32(p);
+      } else {
+        return load_be64(p);
+      }
+    }
+
+    static void store(std::uint8_t *p, word_type x) {
+      if constexpr (sizeof(word_type) == 4) {
+        store_be32(p, x);
+      } else {
+        store_be64(p, x);
+      }
+    }
+
+    typename Hasher::BatchKernel kernel;
+
+    /**< @brief 鍵ブロック(K0 ^ ipad, K0 ^ opad)を圧縮した状態 */
+    word_type inner[words * max_lanes] = {};
+    word_type outer[words * max_lanes] = {};
+
+    /**< @brief U1 ^ U2 ^ ... */
+    word_type T[words * max_lanes] = {};
+
+    /**< @brief パディング済みの、次に圧縮するブロック */
+    std::array<std::uint8_t, block_size> block[max_lanes] = {};
+    const std::uint8_t *ptr[max_lanes];
+  };
+};
+
+#endif // end of PBKDF2_HPP
@@ -0,0 +1,190 @@
+/**
+ * @brief PBKDF2のテストプログラム
+ * @note  テストベクタはRFC 7914(PBKDF2-HMAC-SHA256)から
+ *        SHA512, SHA-2の派生版および長い鍵の期待値はPythonの
+ *        hashlib.pbkdf2_hmacで求めた
+ */
+
+#define CATCH_CONFIG_MAIN // This tells Catch to provide a main() - only do this
+                          // in one cpp file
+#include "../pbkdf2.hpp"
+#include "../matcher.hpp"
+#include "../sha2/sha2.hpp"
+#include <string>
+#include <vector>
+
+namespace {
+
+const std::string password = "password";
+const std::string salt = "salt";
+
+template <class Hasher>
+std::vector<std::uint8_t> derive(const std::string &pw, const std::string &s,
+                                 std::uint32_t c, std::size_t dklen) {
+  std::vector<std::uint8_t> dk(dklen);
+  PBKDF2<Hasher>::derive(pw.data(), pw.size(), s.data(), s.size(), c,
+                         dk.data(), dk.size());
+  return dk;
+}
+
+/**
+ * @brief  HMACをそのまま反復する素朴な実装(derive_many()との突き合わせ用)
+ */
+template <class Hasher>
+std::vector<std::uint8_t> reference(const std::string &pw, const std::string &s,
+                                    std::uint32_t c, std::size_t dklen) {
+  const HMAC<Hasher> hmac(pw.data(), pw.size());
+  std::vector<std::uint8_t> dk;
+  for (std::uint32_t i = 1; dk.size() < dklen; i++) {
+    std::string m = s;
+    for (int k = 3; k >= 0; k--) {
+      m.push_back(static_cast<char>(i >> (8 * k)));
+    }
+    auto U = hmac.mac(m.data(), m.size());
+    auto T = U;
+    for (std::uint32_t r = 1; r < c; r++) {
+      U = hmac.mac(U.data(), U.size());
+      for (std::size_t k = 0; k < T.size(); k++) {
+        T[k] ^= U[k];
+      }
+    }
+    const std::size_t n = std::min(T.size(), dklen - dk.size());
+    dk.insert(dk.end(), T.begin(), T.begin() + n);
+  }
+  return dk;
+}
+
+template <class Hasher> void check_rfc_vectors() {
+  if constexpr (Hasher::digest_size == 32) {
+    CHECK_THAT(derive<Hasher>(password, salt, 1, 32),
+               expect("120fb6cf fcf8b32c 43e72252 56c4f837 a86548c9 "
+                      "2ccc3548 0805987c b70be17b"));
+    CHECK_THAT(derive<Hasher>(password, salt, 2, 32),
+               expect("ae4d0c95 af6b46d3 2d0adff9 28f06dd0 2a303f8e "
+                      "f3c251df d6e2d85a 95474c43"));
+    CHECK_THAT(derive<Hasher>(password, salt, 4096, 32),
+               expect("c5e478d5 9288c841 aa530db6 845c4c8d 962893a0 "
+                      "01ce4e11 a4963873 aa98134a"));
+    CHECK_THAT(derive<Hasher>("passwordPASSWORDpassword",
+                              "saltSALTsaltSALTsaltSALTsaltSALTsalt", 4096,
+                              40),
+               expect("348c89db cbd32b2f 32d814b8 116e84cf 2b17347e "
+                      "bc180018 1c4e2a1f b8dd53e1 c635518c 7dac47e9"));
+    CHECK_THAT(derive<Hasher>(std::string("pass\0word", 9),
+                              std::string("sa\0lt", 5), 4096, 16),
+               expect("89b69d05 16f82989 3c696226 650a8687"));
+    CHECK_THAT(derive<Hasher>(std::string(100, 'k'), salt, 10, 32),
+               expect("f3af8c78 4b6e7dd9 d0fc1ea9 ccea92f0 de9ff770 "
+                      "862fa3fa b2a93f21 698635e1"));
+  } else {
+    CHECK_THAT(derive<Hasher>(password, salt, 1, 64),
+               expect("867f70cf1ade02cf f3752599a3a53dc4 af34c7a669815ae5 "
+                      "d513554e1c8cf252 c02d470a285a0501 bad999bfe943c08f "
+                      "050235d7d68b1da5 5e63f73b60a57fce"));
+    CHECK_THAT(derive<Hasher>(password, salt, 2, 64),
+               expect("e1d9c16aa681708a 45f5c7c4e215ceb6 6e011a2e9f004071 "
+                      "3f18aefdb866d53c f76cab2868a39b9f 7840edce4fef5a82 "
+                      "be67335c77a6068e 04112754f27ccf4e"));
+    CHECK_THAT(derive<Hasher>(password, salt, 4096, 64),
+               expect("d197b1b33db0143e 018b12f3d1d1479e 6cdebdcc97c5c0f8 "
+                      "7f6902e072f457b5 143f30602641b3d5 5cd335988cb36b84 "
+                      "376060ecd532e039 b742a239434af2d5"));
+    CHECK_THAT(derive<Hasher>("passwordPASSWORDpassword",
+                              "saltSALTsaltSALTsaltSALTsaltSALTsalt", 4096,
+                              64),
+               expect("8c0511f4c6e597c6 ac6315d8f0362e22 5f3c501495ba23b8 "
+                      "68c005174dc4ee71 115b59f9e60cd953 2fa33e0f75aefe30 "
+                      "225c583a186cd82b d4daea9724a3d3b8"));
+    CHECK_THAT(derive<Hasher>(std::string(200, 'k'), salt, 10, 64),
+               expect("a1d7f0838cd79b67 4489f08f5c06b56a a66bfd490c5e389b "
+                      "7d93fd1ddfe869bb f742d63d285b8a80 bd819ab0c5b219de "
+                      "97065355d2197a8b 7addf1e9bae86ef9"));
+  }
+}
+
+} // namespace
+
+TEMPLATE_TEST_CASE("PBKDF2-Example", "", SHA256, SHA512) {
+  const Backend original = TestType::batch_backend();
+  for (Backend b : {Backend::Scalar, Backend::AVX2, Backend::AVX512}) {
+    if (!TestType::set_batch_backend(b)) {
+      WARN("batch backend " << backend_name(b) << " is not supported");
+      continue;
+    }
+    INFO("batch backend = " << backend_name(b));
+    check_rfc_vectors<TestType>();
+  }
+  TestType::set_batch_backend(original);
+}
+
+TEST_CASE("PBKDF2-SHA2-Variants") {
+  // ハッシュ値を切り詰める派生版では、Uのブロックのパディング位置が変わる
+  CHECK_THAT(derive<SHA224>(password, salt, 4096, 28),
+             expect("218c453b f90635bd 0a21a75d 172703ff 6108ef60 "
+                    "3f65bb82 1aedade1"));
+  CHECK_THAT(derive<SHA384>(password, salt, 4096, 48),
+             expect("559726be38db125b c85ed7895f6e3cf5 74c7a01c080c3447 "
+                    "db1e8a76764deb3c 307b94853fbe424f 6488c5f4f1289626"));
+  CHECK_THAT(derive<SHA512_224>(password, salt, 4096, 28),
+             expect("ed54af699cc307e0 8965098bda5ff4e4 1ea1931f46da771c "
+                    "1ea9128e"));
+  CHECK_THAT(derive<SHA512_256>(password, salt, 4096, 32),
+             expect("f2fbe5f8ec3618bb 145279a8c6a8dfa4 76c282a3ed53d8c2 "
+                    "57d51ce021d3877d"));
+}
+
+TEMPLATE_TEST_CASE("PBKDF2-Long Output", "", SHA224, SHA256, SHA512,
+                   SHA512_224) {
+  // 複数の出力ブロックは別々のレーンで計算される
+  const Backend original = TestType::batch_backend();
+  for (Backend b : {Backend::Scalar, Backend::AVX2, Backend::AVX512}) {
+    if (!TestType::set_batch_backend(b)) {
+      continue;
+    }
+    INFO("batch backend = " << backend_name(b));
+    for (std::size_t dklen : {1, 31, 65, 150, 1000}) {
+      INFO("dklen = " << dklen);
+      CHECK(derive<TestType>(password, salt, 3, dklen) ==
+            reference<TestType>(password, salt, 3, dklen));
+    }
+  }
+  TestType::set_batch_backend(original);
+}
+
+TEMPLATE_TEST_CASE("PBKDF2-Batch", "", SHA256, SHA512) {
+  // 長さの異なるパスワード(ブロック長を超えるものも含む)を用意する
+  std::vector<std::string> pws;
+  for (std::size_t i = 0; i < 37; i++) {
+    pws.emplace_back((i * 13) % 200, static_cast<char>('a' + i % 26));
+  }
+  std::vector<const void *> pw;
+  std::vector<std::size_t> pwlen;
+  for (auto &&p : pws) {
+    pw.push_back(p.data());
+    pwlen.push_back(p.size());
+  }
+
+  const Backend original = TestType::batch_backend();
+  for (Backend b : {Backend::Scalar, Backend::AVX2, Backend::AVX512}) {
+    if (!TestType::set_batch_backend(b)) {
+      continue;
+    }
+    INFO("batch backend = " << backend_name(b));
+    for (std::size_t dklen : {16, 100}) {
+      std::vector<std::vector<std::uint8_t>> dk(
+          pws.size(), std::vector<std::uint8_t>(dklen));
+      std::vector<std::uint8_t *> out;
+      for (auto &&d : dk) {
+        out.push_back(d.data());
+      }
+      PBKDF2<TestType>::derive_many(pws.size(), pw.data(), pwlen.data(),
+                                    salt.data(), salt.size(), 5, out.data(),
+                                    dklen);
+      for (std::size_t i = 0; i < pws.size(); i++) {
+        INFO("i = " << i << ", dklen = " << dklen);
+        CHECK(dk[i] == reference<TestType>(pws[i], salt, 5, dklen));
+      }
+    }
+  }
+  TestType::set_batch_backend(original);
+}
@@ -0,0 +1,282 @@
+/**
+ * @brief SHA256のproof-of-work(先頭のビットが0となるナンスの探索と検証)
+ * @note  SHA256(challenge || be32(nonce))の先頭bits個のビットが全て0となる
+ *        32-bitのnonceを探す
+ *        challengeのうちナンスを含むブロックより前は一度だけ圧縮してmidstateとし、
+ *        ナンスごとには最終ブロック(多くとも2つ)だけを圧縮する
+ *          SIMDレーン: hash_many()のバックエンドのレーンに連続したナンスを並べる
+ *          SHA-NI    : 最終ブロックをcompress()で圧縮する
+ *          スカラー  : ナンスより前のラウンドと、ナンスに依存しないWtを省く
+ *                      (SHA256::compress_nonce())
+ *        ナンス空間は一定の大きさの区間に分け、スレッドプールの空いたスレッドから
+ *        順に割り当てる。見つかった時点で全てのスレッドが探索をやめる
+ */
+
+#ifndef POW_HPP
+#define POW_HPP
+
+#include "bit.hpp"
+#include "sha256/sha256.hpp"
+#include "thread_pool.hpp"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+
+class ProofOfWork {
+public:
+  using digest_type = SHA256::digest_type;
+
+  /**< @brief ナンスの個数(32-bit) */
+  static constexpr std::uint64_t nonce_space = std::uint64_t(1) << 32;
+
+  /**< @brief スレッドに1度に割り当てるナンスの個数 */
+  static constexpr std::uint64_t chunk_size = std::uint64_t(1) << 16;
+
+  /**< @brief search()の結果 */
+  struct Result {
+    /**< @brief 条件を満たすナンスが見つかったか */
+    bool found;
+
+    /**< @brief 見つかったナンス */
+    std::uint32_t nonce;
+
+    /**< @brief 見つかったナンスのハッシュ値 */
+    digest_type digest;
+
+    /**< @brief 計算したハッシュ値の個数 */
+    std::uint64_t hashes;
+
+    /**< @brief 探索にかかった時間(秒) */
+    double seconds;
+
+    /**
+     * @brief  1秒あたりに計算したハッシュ値の個数
+     */
+    double hash_rate() const { return seconds > 0 ? hashes / seconds : 0; }
+  };
+
+  /**
+   * @param  const void* challenge 課題のbyte列の先頭
+   * @param  std::size_t len       課題のbyte数
+   */
+  ProofOfWork(const void *challenge, std::size_t len) {
+    SHA256 ctx;
+    ctx.update(challenge, len);
+    prefix = ctx.state();
+
+    // 最終ブロック: 課題の端数 || ナンス || 0x80 || 0 ... || ビット長
+    offset = prefix.buflen;
+    std::copy(prefix.buffer.begin(), prefix.buffer.begin() + offset,
+              tail.begin());
+    tail[offset + 4] = 0b10000000;
+    blocks = offset + 4 + 9 > SHA256::block_size ? 2 : 1;
+    store_be64(tail.data() + blocks * SHA256::block_size - 8,
+               (prefix.msglen + 4) * 8);
+    schedule = SHA256::nonce_schedule(prefix.H.data(), tail.data(), offset / 4);
+  }
+
+  /**
+   * @brief  SHA256(challenge || be32(nonce))
+   */
+  digest_type hash(std::uint32_t nonce) const {
+    std::uint8_t n[4];
+    store_be32(n, nonce);
+    return SHA256(prefix).hash_suffix(n, 4);
+  }
+
+  /**
+   * @brief  ナンスが条件を満たすか検証する
+   */
+  bool verify(std::uint32_t nonce, unsigned bits) const {
+    return leading_zeros(hash(nonce)) >= bits;
+  }
+
+  /**
+   * @brief  ハッシュ値の先頭から続く0のビット数
+   */
+  static unsigned leading_zeros(const digest_type &M) {
+    std::uint32_t H[8];
+    for (std::size_t i = 0; i < 8; i++) {
+      H[i] = load_be32(&M[i * 4]);
+    }
+    return leading_zeros(H);
+  }
+
+  /**
+   * @brief  条件を満たすナンスを探す
+   * @param  ThreadPool& pool    探索に使うスレッドプール
+   * @param  unsigned bits       先頭の0のビット数
+   * @param  std::uint32_t first 最初に試すナンス
+   * @param  std::uint64_t count 試すナンスの個数(ナンス空間の終わりまでに切り詰める)
+   * @note   見つかった時点で他のスレッドも探索をやめる
+   *         複数のスレッドが見つけたら最小のナンスを返すが、ナンス空間全体で
+   *         最小とは限らない(1スレッドなら最小となる)
+   */
+  Result search(ThreadPool &pool, unsigned bits, std::uint32_t first = 0,
+                std::uint64_t count = nonce_space) const {
+    const auto start = std::chrono::steady_clock::now();
+    count = std::min(count, nonce_space - first);
+
+    std::atomic<bool> stop{false};
+    std::atomic<std::uint64_t> best{no_nonce};
+    std::atomic<std::uint64_t> hashes{0};
+    pool.parallel_for(
+        (count + chunk_size - 1) / chunk_size, [&](std::size_t i) {
+          if (stop.load(std::memory_order_relaxed)) {
+            return;
+          }
+          const std::uint64_t begin = first + i * chunk_size;
+          const std::uint64_t end = std::min(begin + chunk_size, first + count);
+          std::uint64_t nonce = no_nonce;
+          hashes += scan(begin, end, bits, stop, nonce);
+          if (nonce == no_nonce) {
+            return;
+          }
+          std::uint64_t x = best.load();
+          while (nonce < x && !best.compare_exchange_weak(x, nonce)) {
+          }
+          stop = true;
+        });
+
+    Result r{};
+    r.found = best != no_nonce;
+    if (r.found) {
+      r.nonce = static_cast<std::uint32_t>(best.load());
+      r.digest = hash(r.nonce);
+    }
+    r.hashes = hashes;
+    r.seconds = std::chrono::duration<double>(
+                    std::chrono::steady_clock::now() - start)
+                    .count();
+    return r;
+  }
+
+private:
+  /**< @brief ナンスが見つかっていないことを表す値 */
+  static constexpr std::uint64_t no_nonce =
+      std::numeric_limits<std::uint64_t>::max();
+
+  /**
+   * @brief  ハッシュ値のwordの先頭から続く0のビット数
+   * @param  std::size_t stride wordの間隔(SIMDレーンのSではレーン数)
+   */
+  static unsigned leading_zeros(const std::uint32_t *H,
+                                std::size_t stride = 1) {
+    unsigned n = 0;
+    for (std::size_t i = 0; i < 8; i++, n += 32) {
+      if (H[i * stride] != 0) {
+        return n + __builtin_clz(H[i * stride]);
+      }
+    }
+    return n;
+  }
+
+  /**
+   * @brief  [begin, end)のナンスを順に試す
+   * @param  std::uint64_t& nonce 最初に見つかったナンスの書き込み先
+   * @return 計算したハッシュ値の個数
+   * @note   stopが立てば途中でやめる
+   */
+  std::uint64_t scan(std::uint64_t begin, std::uint64_t end, unsigned bits,
+                     const std::atomic<bool> &stop,
+                     std::uint64_t &nonce) const {
+    const SHA256::BatchKernel kernel = SHA256::batch_kernel();
+    if (kernel.lanes > 1) {
+      return scan_lanes(kernel, begin, end, bits, stop, nonce);
+    }
+
+    std::array<std::uint8_t, 2 * SHA256::block_size> block = tail;
+    const std::size_t k = offset / 4;
+    const bool shani = SHA256::backend() == Backend::SHANI;
+    std::uint32_t H[8];
+    for (std::uint64_t x = begin; x < end; x++) {
+      if (stop.load(std::memory_order_relaxed)) {
+        return x - begin;
+      }
+      store_be32(block.data() + offset, static_cast<std::uint32_t>(x));
+      if (shani) {
+        std::copy(prefix.H.begin(), prefix.H.end(), H);
+        SHA256::compress(H, block.data(), blocks);
+      } else {
+        SHA256::compress_nonce(schedule, load_be32(block.data() + k * 4),
+                               k < 15 ? load_be32(block.data() + k * 4 + 4)
+                                      : 0,
+                               H);
+        if (blocks == 2) {
+          SHA256::compress(H, block.data() + SHA256::block_size, 1);
+        }
+      }
+      if (leading_zeros(H) >= bits) {
+        nonce = x;
+        return x - begin + 1;
+      }
+    }
+    return end - begin;
+  }
+
+  /**
+   * @brief  scan()のSIMDレーン版(連続したナンスをレーンに並べる)
+   */
+  std::uint64_t scan_lanes(const SHA256::BatchKernel &kernel,
+                           std::uint64_t begin, std::uint64_t end,
+                           unsigned bits, const std::atomic<bool> &stop,
+                           std::uint64_t &nonce) const {
+    constexpr std::size_t max_lanes = SHA256::max_lanes;
+    const std::size_t L = kernel.lanes;
+    alignas(64) std::uint32_t S[8 * max_lanes];
+    std::uint8_t block[max_lanes][2 * SHA256::block_size];
+    const std::uint8_t *ptr[2][max_lanes];
+    for (std::size_t j = 0; j < L; j++) {
+      std::copy(tail.begin(), tail.end(), block[j]);
+      ptr[0][j] = block[j];
+      ptr[1][j] = block[j] + SHA256::block_size;
+    }
+
+    for (std::uint64_t x = begin; x < end; x += L) {
+      if (stop.load(std::memory_order_relaxed)) {
+        return x - begin;
+      }
+      // 区間の終わりを越えるレーンも計算するが、結果は見ない
+      const std::size_t m =
+          static_cast<std::size_t>(std::min<std::uint64_t>(L, end - x));
+      for (std::size_t j = 0; j < L; j++) {
+        store_be32(block[j] + offset, static_cast<std::uint32_t>(x + j));
+      }
+      for (std::size_t w = 0; w < 8; w++) {
+        std::fill(S + w * L, S + (w + 1) * L, prefix.H[w]);
+      }
+      for (std::size_t b = 0; b < blocks; b++) {
+        kernel.compress(S, ptr[b]);
+      }
+      SHA256::stats().add_blocks(SHA256::batch_backend(), L * blocks);
+      for (std::size_t j = 0; j < m; j++) {
+        if (leading_zeros(S + j, L) >= bits) {
+          nonce = x + j;
+          return x - begin + j + 1;
+        }
+      }
+    }
+    return end - begin;
+  }
+
+  /**< @brief 課題を取り込んだ途中状態 */
+  SHA256::state_type prefix;
+
+  /**< @brief ナンスを含む最終ブロック(ナンスの位置は0) */
+  std::array<std::uint8_t, 2 * SHA256::block_size> tail{};
+
+  /**< @brief 最終ブロックでのナンスの位置(byte) */
+  std::size_t offset;
+
+  /**< @brief 最終ブロックの個数(1または2) */
+  std::size_t blocks;
+
+  /**< @brief 最初の最終ブロックの前計算 */
+  SHA256::NonceSchedule schedule;
+};
+
+#endif // end of POW_HPP
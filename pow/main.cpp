@@ -0,0 +1,136 @@
+/**
+ * @brief proof-of-workのテストプログラム
+ */
+
+#define CATCH_CONFIG_MAIN // This tells Catch to provide a main() - only do this
+                          // in one cpp file
+#include "../matcher.hpp"
+#include "../pow.hpp"
+#include <string>
+
+namespace {
+
+/**
+ * @brief  SHA256(challenge || be32(nonce))を愚直に計算する
+ */
+SHA256::digest_type reference(const std::string &challenge,
+                              std::uint32_t nonce) {
+  std::string msg = challenge;
+  for (int s = 24; s >= 0; s -= 8) {
+    msg += static_cast<char>(nonce >> s);
+  }
+  return SHA256().hash(msg.data(), msg.size());
+}
+
+/**
+ * @brief  条件を満たす最小のナンスを愚直に探す
+ */
+std::uint32_t first_nonce(const std::string &challenge, unsigned bits) {
+  std::uint32_t nonce = 0;
+  while (ProofOfWork::leading_zeros(reference(challenge, nonce)) < bits) {
+    nonce++;
+  }
+  return nonce;
+}
+
+/**
+ * @brief  compress()とhash_many()のバックエンドの組
+ */
+struct Config {
+  Backend backend;
+  Backend batch;
+};
+
+} // namespace
+
+TEST_CASE("PoW-LeadingZeros") {
+  SHA256::digest_type M{};
+  CHECK(ProofOfWork::leading_zeros(M) == 256);
+  M[0] = 0x80;
+  CHECK(ProofOfWork::leading_zeros(M) == 0);
+  M[0] = 0x00;
+  M[4] = 0x01;
+  CHECK(ProofOfWork::leading_zeros(M) == 39);
+  M[4] = 0x00;
+  M[31] = 0x01;
+  CHECK(ProofOfWork::leading_zeros(M) == 255);
+}
+
+TEST_CASE("PoW-Hash") {
+  const std::string challenge = "abc";
+  const ProofOfWork pow(challenge.data(), challenge.size());
+  for (std::uint32_t nonce : {0u, 1u, 0x01020304u, 0xffffffffu}) {
+    CHECK(pow.hash(nonce) == reference(challenge, nonce));
+  }
+}
+
+TEST_CASE("PoW-Search") {
+  // 単一スレッドなら最小のナンスが見つかる
+  // 課題の長さを変え、ナンスがwordの境界をまたぐ場合、最終ブロックが2つになる場合、
+  // ナンスがブロックの境界をまたぐ場合を通す
+  ThreadPool pool(1);
+  const Backend original = SHA256::backend();
+  const Backend batch = SHA256::batch_backend();
+  for (Config c : {Config{Backend::Scalar, Backend::Scalar},
+                   Config{Backend::SHANI, Backend::Scalar},
+                   Config{Backend::Scalar, Backend::AVX2},
+                   Config{Backend::Scalar, Backend::AVX512}}) {
+    if (!SHA256::set_backend(c.backend) ||
+        !SHA256::set_batch_backend(c.batch)) {
+      continue;
+    }
+    for (std::size_t len = 0; len <= 130; len++) {
+      std::string challenge;
+      for (std::size_t i = 0; i < len; i++) {
+        challenge += static_cast<char>(i * 37 + len);
+      }
+      const ProofOfWork pow(challenge.data(), challenge.size());
+      const auto r = pow.search(pool, 6);
+      const std::uint32_t expected = first_nonce(challenge, 6);
+      REQUIRE(r.found);
+      CHECK(r.nonce == expected);
+      CHECK(r.digest == reference(challenge, expected));
+      CHECK(r.hashes >= expected + 1);
+      CHECK(pow.verify(r.nonce, 6));
+    }
+  }
+  SHA256::set_backend(original);
+  SHA256::set_batch_backend(batch);
+}
+
+TEST_CASE("PoW-Range") {
+  ThreadPool pool(1);
+  const std::string challenge = "range";
+  const ProofOfWork pow(challenge.data(), challenge.size());
+
+  // 範囲に解がなければ全て試して見つからない
+  const auto none = pow.search(pool, 256, 1000, 5000);
+  CHECK(!none.found);
+  CHECK(none.hashes == 5000);
+
+  // 範囲はナンス空間の終わりで切り詰める
+  const auto tail = pow.search(pool, 256, 0xffffff00u);
+  CHECK(!tail.found);
+  CHECK(tail.hashes == 0x100);
+
+  // 先頭から探さなくてもよい
+  const std::uint32_t expected = first_nonce(challenge, 4);
+  const auto r = pow.search(pool, 4, expected);
+  REQUIRE(r.found);
+  CHECK(r.nonce == expected);
+  CHECK(r.hashes == 1);
+}
+
+TEST_CASE("PoW-Threads") {
+  ThreadPool pool(4);
+  const std::string challenge = "rate-limit:client-42:1700000000";
+  const ProofOfWork pow(challenge.data(), challenge.size());
+  const auto r = pow.search(pool, 16);
+  REQUIRE(r.found);
+  CHECK(pow.verify(r.nonce, 16));
+  CHECK(ProofOfWork::leading_zeros(r.digest) >= 16);
+  CHECK(r.hash_rate() > 0);
+
+  // 見つかった時点で他のスレッドも止まり、ナンス空間の一部しか試さない
+  CHECK(r.hashes < ProofOfWork::nonce_space / 16);
+}
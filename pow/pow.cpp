@@ -0,0 +1,65 @@
+/**
+ * @brief SHA256のproof-of-workのナンスを探索または検証する
+ * @note  使い方: pow [-b BITS] [-j THREADS] [-v NONCE] CHALLENGE
+ *        SHA256(CHALLENGE || be32(nonce))の先頭BITS個(既定は20)のビットが0となる
+ *        ナンスを探し、"<nonce>  <digest>"を標準出力へ書き出す
+ *        試したハッシュ値の個数と速度(MH/s)を標準エラー出力に表示する
+ *        -vを指定すると探索せず、NONCEが条件を満たすかを終了コードで返す
+ */
+
+#include "../hex.hpp"
+#include "../pow.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+namespace {
+
+int usage(const char *prog) {
+  std::fprintf(stderr,
+               "usage: %s [-b BITS] [-j THREADS] [-v NONCE] CHALLENGE\n", prog);
+  return 2;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  unsigned bits = 20;
+  std::size_t threads = 0;
+  const char *verify = nullptr;
+  int i = 1;
+  for (; i + 1 < argc && argv[i][0] == '-'; i += 2) {
+    if (std::strcmp(argv[i], "-b") == 0) {
+      bits = static_cast<unsigned>(std::atoi(argv[i + 1]));
+    } else if (std::strcmp(argv[i], "-j") == 0) {
+      threads = static_cast<std::size_t>(std::atol(argv[i + 1]));
+    } else if (std::strcmp(argv[i], "-v") == 0) {
+      verify = argv[i + 1];
+    } else {
+      return usage(argv[0]);
+    }
+  }
+  if (i + 1 != argc || bits > 256) {
+    return usage(argv[0]);
+  }
+
+  const ProofOfWork pow(argv[i], std::strlen(argv[i]));
+  if (verify != nullptr) {
+    const auto nonce =
+        static_cast<std::uint32_t>(std::strtoul(verify, nullptr, 0));
+    const bool ok = pow.verify(nonce, bits);
+    std::printf("%s\n", ok ? "OK" : "FAILED");
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+  }
+
+  ThreadPool pool(threads);
+  const auto r = pow.search(pool, bits);
+  if (r.found) {
+    std::printf("%lu  %s\n", static_cast<unsigned long>(r.nonce),
+                to_hex(r.digest).c_str());
+  }
+  std::fprintf(stderr, "%llu hashes in %.3f s (%.2f MH/s, %zu threads)\n",
+               static_cast<unsigned long long>(r.hashes), r.seconds,
+               r.hash_rate() / 1e6, pool.size());
+  return r.found ? EXIT_SUCCESS : EXIT_FAILURE;
+}
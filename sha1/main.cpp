@@ -5,6 +5,7 @@
 
 #define CATCH_CONFIG_MAIN // This tells Catch to provide a main() - only do this
                           // in one cpp file
+#include "../alloc_counter.hpp"
 #include "../matcher.hpp"
 #include "sha1.hpp"
 
@@ -25,3 +26,127 @@ TEST_CASE("SHA1-Example") {
     CHECK_THAT(bytes, expect("34aa973c d4c4daa4 f61eeb2b dbad2731 6534016f"));
   }
 }
+
+TEST_CASE("SHA1-Streaming") {
+  SECTION("Split Message") {
+    SHA1 ctx;
+    ctx.update("a", 1);
+    ctx.update("bc", 2);
+    CHECK_THAT(ctx.finalize(),
+               expect("a9993e36 4706816a ba3e2571 7850c26c 9cd0d89d"));
+  }
+  SECTION("Empty Message") {
+    SHA1 ctx;
+    CHECK_THAT(ctx.finalize(),
+               expect("da39a3ee 5e6b4b0d 3255bfef 95601890 afd80709"));
+  }
+  SECTION("Long Message") {
+    const std::vector<std::uint8_t> msg(1000000, 0x61);
+    for (std::size_t chunk : {1, 55, 63, 64, 65, 1000, 4096}) {
+      SHA1 ctx;
+      for (std::size_t i = 0; i < msg.size(); i += chunk) {
+        ctx.update(msg.data() + i, std::min(chunk, msg.size() - i));
+      }
+      CHECK_THAT(ctx.finalize(),
+                 expect("34aa973c d4c4daa4 f61eeb2b dbad2731 6534016f"));
+    }
+  }
+}
+
+TEST_CASE("SHA1-Zero-Allocation") {
+  const std::string msg(1000, 'a');
+  const std::size_t before = allocation_count.load();
+  const auto bytes = SHA1().hash(msg.data(), msg.size());
+  const std::size_t after = allocation_count.load();
+  CHECK(after == before);
+  CHECK_THAT(bytes, expect("291e9a6c 66994949 b57ba5e6 50361e98 fc36b1ba"));
+}
+
+TEST_CASE("SHA1-Prefix") {
+  std::vector<std::uint8_t> msg(500);
+  for (std::size_t i = 0; i < msg.size(); i++) {
+    msg[i] = static_cast<std::uint8_t>(i * 7 + 3);
+  }
+
+  // ブロック境界にない接頭辞も含め、接頭辞を一度だけ取り込んで使い回す
+  for (std::size_t plen : {0, 1, 55, 64, 100, 128, 200, 300}) {
+    INFO("prefix = " << plen);
+    SHA1 prefix;
+    prefix.update(msg.data(), plen);
+    const SHA1::state_type saved = prefix.state();
+    for (std::size_t len = 0; plen + len <= msg.size(); len += 37) {
+      const auto expected = SHA1().hash(msg.data(), plen + len);
+      CHECK(prefix.hash_suffix(msg.data() + plen, len) == expected);
+
+      SHA1 ctx(saved);
+      ctx.update(msg.data() + plen, len);
+      CHECK(ctx.finalize() == expected);
+    }
+
+    // restore()で同じオブジェクトを接頭辞の状態に戻せる
+    SHA1 ctx;
+    ctx.update("junk", 4);
+    ctx.restore(saved);
+    CHECK(ctx.finalize() == SHA1().hash(msg.data(), plen));
+  }
+}
+
+TEST_CASE("SHA1-Constexpr") {
+  // コンパイル時に評価されること
+  constexpr auto abc = sha1("abc");
+  constexpr auto empty = sha1("");
+  constexpr auto two =
+      sha1("abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq");
+  constexpr auto bytes = sha1(std::array<std::uint8_t, 3>{0x61, 0x62, 0x63});
+  static_assert(digest_is(abc, "a9993e36 4706816a ba3e2571 7850c26c 9cd0d89d"));
+  static_assert(digest_is(empty,
+                          "da39a3ee 5e6b4b0d 3255bfef 95601890 afd80709"));
+  static_assert(digest_is(two, "84983e44 1c3bd26e baae4aa1 f95129e5 e54670f1"));
+  static_assert(digest_is(bytes,
+                          "a9993e36 4706816a ba3e2571 7850c26c 9cd0d89d"));
+
+  // ダイジェストをテンプレート引数に使う
+  using First = std::integral_constant<std::uint8_t, sha1("abc")[0]>;
+  CHECK(First::value == 0xa9);
+
+  // 実行時に呼び出しても、通常の計算と一致すること
+  std::vector<std::uint8_t> msg(300);
+  for (std::size_t i = 0; i < msg.size(); i++) {
+    msg[i] = static_cast<std::uint8_t>(i * 7 + 3);
+  }
+  for (std::size_t len = 0; len <= msg.size(); len++) {
+    CHECK(SHA1::hash_constexpr(msg.data(), len) ==
+          SHA1().hash(msg.data(), len));
+  }
+}
+
+TEST_CASE("SHA1-Backends") {
+  // スカラー実装の結果を基準にして、各バックエンドの結果と突き合わせる
+  std::vector<std::uint8_t> msg(1000);
+  for (std::size_t i = 0; i < msg.size(); i++) {
+    msg[i] = static_cast<std::uint8_t>(i * 7 + 3);
+  }
+  const Backend original = SHA1::backend();
+  REQUIRE(SHA1::set_backend(Backend::Scalar));
+  std::vector<SHA1::digest_type> expected;
+  for (std::size_t len = 0; len <= msg.size(); len += 13) {
+    expected.push_back(SHA1().hash(msg.data(), len));
+  }
+
+  for (Backend b : {Backend::Scalar, Backend::SHANI}) {
+    if (!SHA1::set_backend(b)) {
+      WARN("backend " << backend_name(b) << " is not supported");
+      continue;
+    }
+    INFO("backend = " << backend_name(b));
+    CHECK(SHA1::backend() == b);
+    CHECK_THAT(SHA1().hash("abc"),
+               expect("a9993e36 4706816a ba3e2571 7850c26c 9cd0d89d"));
+    CHECK_THAT(SHA1().hash(std::vector<std::uint8_t>(1000000, 0x61)),
+               expect("34aa973c d4c4daa4 f61eeb2b dbad2731 6534016f"));
+    for (std::size_t len = 0, i = 0; len <= msg.size(); len += 13, i++) {
+      CHECK(SHA1().hash(msg.data(), len) == expected[i]);
+    }
+  }
+  SHA1::set_backend(original);
+}
@@ -7,17 +7,213 @@
 #define SHA1_HPP
 
 #include "../bit.hpp"
+#include "../cpu.hpp"
+#include "../stats.hpp"
+#include "../unroll.hpp"
+#include <algorithm>
+#include <array>
 #include <string>
+#include <string_view>
+#include <type_traits>
 #include <vector>
 
-//#define DEBUG
-#ifdef DEBUG
-#define FMT_HEADER_ONLY
-#include <../fmt/printf.h>
-#include <iostream>
-#endif
-
 class SHA1 {
+public:
+  /**< @brief ブロック長(byte) */
+  static constexpr std::size_t block_size = 64;
+
+  /**< @brief ダイジェスト長(byte) */
+  static constexpr std::size_t digest_size = 20;
+
+  /**< @brief ハッシュ化されたbyte列の型 */
+  using digest_type = std::array<std::uint8_t, digest_size>;
+
+  /**< @brief n個の連続したブロックを圧縮し、ハッシュ値Hを更新する関数の型 */
+  using compress_fn = void (*)(std::uint32_t *H, const std::uint8_t *blocks,
+                               std::size_t n);
+
+public:
+  SHA1() { init(); }
+
+  /**
+   * @brief  ハッシュ値とバッファを初期状態に戻す
+   * @note   finalize()の後に同じオブジェクトを再利用する場合に呼び出す
+   */
+  void init() {
+    H = IV;
+    buflen = 0;
+    msglen = 0;
+  }
+
+  /**
+   * @brief  メッセージの続きを取り込む
+   * @param  const void* data 追加するbyte列の先頭
+   * @param  std::size_t len  追加するbyte数
+   * @note   何度呼び出しても、保持するのは1ブロック分のバッファとハッシュ値のみ
+   */
+  void update(const void *data, std::size_t len) {
+    const auto *p = static_cast<const std::uint8_t *>(data);
+    msglen += len;
+    statistics.add(statistics.bytes, len);
+
+    // バッファに端数が残っていれば、先に1ブロック分まで埋める
+    if (buflen > 0) {
+      const std::size_t n = std::min(len, block_size - buflen);
+      append(p, n);
+      p += n;
+      len -= n;
+      if (buflen < block_size) {
+        return;
+      }
+      compress(buffer.data(), 1);
+      buflen = 0;
+    }
+
+    // 揃っているブロックはコピーせずにまとめて圧縮する
+    const std::size_t n = len / block_size;
+    if (n > 0) {
+      compress(p, n);
+      p += n * block_size;
+      len -= n * block_size;
+    }
+
+    // 端数はバッファに退避しておく
+    append(p, len);
+  }
+
+  /**
+   * @brief  最終ブロックにパディングを施し、ハッシュ値を求める
+   * @param  std::uint8_t* M ハッシュ値の書き込み先(digest_size byte)
+   */
+  void finalize(std::uint8_t *M) {
+    padding();
+
+    for (std::size_t i = 0; i < 5; i++) {
+      store_be32(M + i * 4, H[i]);
+    }
+  }
+
+  /**
+   * @brief  最終ブロックにパディングを施し、ハッシュ値を求める
+   * @return ハッシュ化されたbyte列
+   */
+  digest_type finalize() {
+    digest_type M; // 8 * 20 = 160-bits
+    finalize(M.data());
+    return M;
+  }
+
+public:
+  /**< @brief 計算の途中状態(memcpyで複製できる) */
+  struct state_type {
+    std::array<std::uint32_t, 5> H;
+    std::array<std::uint8_t, block_size> buffer;
+    std::size_t buflen;
+    std::uint64_t msglen;
+  };
+
+  /**
+   * @brief  途中状態から計算を再開する
+   */
+  explicit SHA1(const state_type &s) { restore(s); }
+
+  /**
+   * @brief  現在の途中状態を返す
+   * @note   共通の接頭辞を一度だけ取り込んだ状態を保存し、メッセージごとに
+   *         restore()あるいはコピーして使い回す
+   */
+  state_type state() const { return state_type{H, buffer, buflen, msglen}; }
+
+  /**
+   * @brief  保存した途中状態に戻す
+   */
+  void restore(const state_type &s) {
+    H = s.H;
+    buffer = s.buffer;
+    buflen = s.buflen;
+    msglen = s.msglen;
+  }
+
+  /**
+   * @brief  自身をコピーして続きを取り込み、ハッシュ値を求める
+   * @param  const void* data 続きのbyte列の先頭
+   * @param  std::size_t len  続きのbyte数
+   * @note   自身は変更しないので、接頭辞を取り込んだ状態から何度でも呼び出せる
+   *         圧縮するのは続きを含むブロックだけ
+   */
+  digest_type hash_suffix(const void *data, std::size_t len) const {
+    SHA1 ctx = *this;
+    ctx.update(data, len);
+    return ctx.finalize();
+  }
+
+public:
+  /**
+   * @brief  SHA1(Secure Hash Algorithm 1)の計算を行う
+   * @param  const void* data ハッシュ化対象のbyte列の先頭
+   * @param  std::size_t len  ハッシュ化対象のbyte数
+   * @return ハッシュ化されたbyte列
+   * @note   ヒープ確保を一切行わない
+   */
+  digest_type hash(const void *data, std::size_t len) const {
+    const std::uint64_t start = stats_histogram_enabled ? stats_ticks() : 0;
+    SHA1 ctx;
+    ctx.update(data, len);
+    const digest_type M = ctx.finalize();
+    if constexpr (stats_histogram_enabled) {
+      statistics.add_latency(len, stats_ticks() - start);
+    }
+    return M;
+  }
+
+  /**
+   * @brief  コンパイル時にも評価できるSHA1の計算
+   * @param  const Byte* data ハッシュ化対象のbyte列の先頭(charまたはuint8_t)
+   * @param  std::size_t len  ハッシュ化対象のbyte数
+   * @return ハッシュ化されたbyte列(digest message)
+   * @note   定数式ではバックエンドを選択できないので、常にスカラー実装で計算する
+   *         通常はsha1()から呼び出す
+   */
+  template <class Byte>
+  static constexpr digest_type hash_constexpr(const Byte *data,
+                                              std::size_t len) {
+    std::uint32_t S[5] = {};
+    for (std::size_t i = 0; i < 5; i++) {
+      S[i] = IV[i];
+    }
+
+    // 揃っているブロックを1つずつコピーして圧縮する
+    std::uint8_t block[block_size] = {};
+    std::size_t off = 0;
+    for (; off + block_size <= len; off += block_size) {
+      for (std::size_t i = 0; i < block_size; i++) {
+        block[i] = static_cast<std::uint8_t>(data[off + i]);
+      }
+      compress_block(S, block);
+    }
+
+    // 端数に M || 1 || 0k || l のパディングを施す
+    const std::size_t r = len - off;
+    for (std::size_t i = 0; i < block_size; i++) {
+      block[i] = i < r ? static_cast<std::uint8_t>(data[off + i]) : 0x00;
+    }
+    block[r] = 0b10000000;
+    if (r + 1 > block_size - 8) {
+      compress_block(S, block);
+      for (std::size_t i = 0; i < block_size; i++) {
+        block[i] = 0x00;
+      }
+    }
+    store_be64(block + block_size - 8, static_cast<std::uint64_t>(len) * 8);
+    compress_block(S, block);
+
+    digest_type M{};
+    for (std::size_t i = 0; i < 5; i++) {
+      store_be32(&M[i * 4], S[i]);
+    }
+    return M;
+  }
+
 public:
   /**
    * @brief  SHA1(Secure Hash Algorithm 1)の計算を行う
@@ -25,9 +221,8 @@ public:
    * @return ハッシュ化されたbyte列
    */
   std::vector<std::uint8_t> hash(const std::string &msg) const {
-    std::vector<std::uint8_t> bytes(msg.size(), 0x00);
-    std::copy(msg.cbegin(), msg.cend(), bytes.begin());
-    return hash(bytes);
+    const digest_type M = hash(msg.data(), msg.size());
+    return std::vector<std::uint8_t>(M.cbegin(), M.cend());
   }
 
 public:
@@ -37,90 +232,186 @@ public:
    * @return ハッシュ化されたbyte列
    */
   std::vector<std::uint8_t> hash(const std::vector<std::uint8_t> &msg) const {
-    // ハッシュ値を用意
-    std::vector<std::uint32_t> H{
-        0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476, 0xc3d2e1f0,
-    };
-
-    // プリプロセス: メッセージにパディングを施す
-    const std::vector<std::uint8_t> padded_msg = padding(msg);
-
-    // メッセージを512-bitのチャンクに分割する
-    const std::size_t chunks_num =
-        padded_msg.size() / 64; // チャンクの大きさは512(8 * 64)-bit * n
-    for (std::size_t i = 0; i < chunks_num; i++) {
-      std::vector<std::uint32_t> W(80);
-
-      // 0 <= t <= 15 : メッセージを16つの32-bit wordsに分割する
-      for (std::uint32_t t = 0; t < 16; t++) {
-        std::uint32_t base = i * 64 + t * 4;
-        W[t] = (padded_msg[base + 0] << 24) | (padded_msg[base + 1] << 16) |
-               (padded_msg[base + 2] << 8) | (padded_msg[base + 3]);
-#ifdef DEBUG
-        fmt::printf("W[%2d] = %08x", t, W[t]);
+    const digest_type M = hash(msg.data(), msg.size());
+    return std::vector<std::uint8_t>(M.cbegin(), M.cend());
+  }
+
+public:
+  /**
+   * @brief  現在使用している圧縮関数のバックエンドを返す
+   * @note   初回呼び出し時にCPUIDを確認し、使用可能な最速のものが選ばれる
+   *         環境変数SHA_BACKENDで強制することもできる
+   */
+  static Backend backend() { return dispatcher().backend; }
+
+  /**
+   * @brief  実行中のCPUでバックエンドが使用可能か判定する
+   */
+  static bool supports(Backend b) {
+    switch (b) {
+    case Backend::Scalar:
+      return true;
+    case Backend::SHANI:
+#ifdef SHA_X86
+      return cpu_features().sha && cpu_features().sse41;
+#else
+      return false;
 #endif
-      }
+    default:
+      return false;
+    }
+  }
 
-      // 16 <= t <= 79 : 16つの32-bit wordsを80つの32-bits wordsに拡張する
-      for (std::uint32_t t = 16; t < 80; t++) {
-        W[t] = rotl(W[t - 3] ^ W[t - 8] ^ W[t - 14] ^ W[t - 16], 1);
+  /**
+   * @brief  圧縮関数のバックエンドを強制する
+   * @return 実行中のCPUで使用できなければ何もせずにfalseを返す
+   * @note   他のスレッドがハッシュ計算中に呼び出してはならない
+   */
+  static bool set_backend(Backend b) {
+    if (!supports(b)) {
+      return false;
+    }
+    dispatcher() = Dispatcher{b, select(b)};
+    statistics.select(b);
+    return true;
+  }
+
+  /**
+   * @brief  SHA1の統計を返す
+   * @note   SHA_STATSを定義してコンパイルしたときだけ記録される(stats.hpp)
+   */
+  static HashStats &stats() { return statistics; }
+
+  /**< @brief 初期ハッシュ値 H0, H1, ..., H4 */
+  inline static constexpr std::array<std::uint32_t, 5> IV{
+      0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476, 0xc3d2e1f0,
+  };
+
+private:
+  /**< @brief 選択されたバックエンドとその圧縮関数 */
+  struct Dispatcher {
+    Backend backend;
+    compress_fn compress;
+  };
+
+  static Dispatcher &dispatcher() {
+    static Dispatcher d = [] {
+      Backend b;
+      if (!requested_backend(b) || !supports(b)) {
+        b = supports(Backend::SHANI) ? Backend::SHANI : Backend::Scalar;
       }
+      statistics.select(b);
+      return Dispatcher{b, select(b)};
+    }();
+    return d;
+  }
 
-      // 5つのword...a, b, c, d, eの値を初期化する
-      std::uint32_t a = H[0];
-      std::uint32_t b = H[1];
-      std::uint32_t c = H[2];
-      std::uint32_t d = H[3];
-      std::uint32_t e = H[4];
-
-      // Main Loop: US Secure Hash Algorithm 1 (SHA-1)
-      for (std::uint32_t t = 0; t < 80; t++) {
-        const std::uint32_t T = rotl(a, 5) + f(t, b, c, d) + e + K(t) + W[t];
-        e = d;
-        d = c;
-        c = rotl(b, 30);
-        b = a;
-        a = T;
-
-#ifdef DEBUG
-        fmt::printf("t = %2d ", t);
-        fmt::printf("a = %08x ", a);
-        fmt::printf("b = %08x ", b);
-        fmt::printf("c = %08x ", c);
-        fmt::printf("d = %08x ", d);
-        fmt::printf("e = %08x\n", e);
+  static compress_fn select(Backend b) {
+#ifdef SHA_X86
+    if (b == Backend::SHANI) {
+      return compress_shani;
+    }
 #endif
-      }
+    static_cast<void>(b);
+    return compress_scalar;
+  }
 
-      // ハッシュ値の更新
-      H[0] = a + H[0];
-      H[1] = b + H[1];
-      H[2] = c + H[2];
-      H[3] = d + H[3];
-      H[4] = e + H[4];
+  /**
+   * @brief  選択されたバックエンドでn個のブロックを圧縮する
+   */
+  void compress(const std::uint8_t *blocks, std::size_t n) {
+    StatsTimer<> timer(statistics, &HashStats::compress_ticks);
+    const Dispatcher &d = dispatcher();
+    d.compress(H.data(), blocks, n);
+    statistics.add_blocks(d.backend, n);
+  }
 
-#ifdef DEBUG
-      for (auto &&h : H) {
-        fmt::printf("%08x ", h);
-      }
-      std::cout << std::endl;
+#ifdef SHA_X86
+  /**
+   * @brief  SHA extensionsを用いてn個のブロックを圧縮する
+   * @note   定義はsha1_shani.hppにある
+   */
+  static void compress_shani(std::uint32_t *H, const std::uint8_t *blocks,
+                             std::size_t n);
 #endif
+
+  /**
+   * @brief  512-bitのブロックをn個圧縮し、ハッシュ値を更新する
+   * @param  std::uint32_t* H            ハッシュ値 H0, H1, ..., H4
+   * @param  const std::uint8_t* blocks 64byteのブロックが連続した領域の先頭
+   * @param  std::size_t n              ブロックの個数
+   */
+  static void compress_scalar(std::uint32_t *H, const std::uint8_t *blocks,
+                              std::size_t n) {
+    for (; n > 0; n--, blocks += block_size) {
+      compress_block(H, blocks);
     }
+  }
 
-    // 最終的なハッシュ値を返す
-    std::vector<std::uint8_t> M(20); // 8 * 20 = 160-bits
+  /**
+   * @brief  512-bitのブロックを1つ圧縮し、ハッシュ値を更新する
+   * @param  std::uint32_t* H           ハッシュ値 H0, H1, ..., H4
+   * @param  const std::uint8_t* block 64byteのブロックの先頭
+   */
+  static constexpr void compress_block(std::uint32_t *H,
+                                       const std::uint8_t *block) {
+    // message schedule: 直近の16 words(Wtは W[t % 16])
+    std::uint32_t W[16] = {};
+
+    // 5つのword...a, b, c, d, eの値を初期化する
+    std::uint32_t v[5] = {};
     for (std::size_t i = 0; i < 5; i++) {
-      const std::size_t base = i * 4;
-      M[base + 0] = static_cast<std::uint8_t>(H[i] >> 24);
-      M[base + 1] = static_cast<std::uint8_t>(H[i] >> 16);
-      M[base + 2] = static_cast<std::uint8_t>(H[i] >> 8);
-      M[base + 3] = static_cast<std::uint8_t>(H[i]);
+      v[i] = H[i];
     }
 
-    return M;
+    // Main Loop: US Secure Hash Algorithm 1 (SHA-1)
+    // 80ラウンドをコンパイル時に展開し、ftとKtはラウンドごとに静的に決まる
+    unroll<0, 80>([&](auto t) {
+      constexpr std::size_t i = decltype(t)::value;
+      round<i>(v, schedule<i>(W, block));
+    });
+
+    // ハッシュ値の更新(80ラウンドで変数の役割は一巡している)
+    for (std::size_t i = 0; i < 5; i++) {
+      H[i] += v[i];
+    }
+  }
+
+  /**
+   * @brief  message scheduleのWtを求める
+   * @param  std::uint32_t* W 直近の16 words(Wtを W[t % 16]に上書きする)
+   * @note   0 <= t <= 15 はメッセージの32-bit words、16 <= t <= 79 は
+   *         使い終わった W{t-16} の位置に計算する
+   */
+  template <std::size_t t>
+  __attribute__((always_inline)) static constexpr std::uint32_t
+  schedule(std::uint32_t *W, const std::uint8_t *block) {
+    if constexpr (t < 16) {
+      W[t] = load_be32(block + t * 4);
+    } else {
+      W[t % 16] = rotl(W[(t - 3) % 16] ^ W[(t - 8) % 16] ^ W[(t - 14) % 16] ^
+                           W[t % 16],
+                       1);
+    }
+    return W[t % 16];
+  }
+
+  /**
+   * @brief  t番目のラウンドを計算する
+   * @param  std::uint32_t* v  変数(ラウンドtでは、k番目の変数がv[(k - t) mod 5])
+   * @param  std::uint32_t w  Wt
+   * @note   e = d; d = c; ...と値を移す代わりに変数の役割を1つずらすので、
+   *         書き込むのは新しいaになるv[e]と、30-bit回転するv[b]の2つだけ
+   *         展開したループに関数呼び出しが残らないよう、必ずインライン展開する
+   */
+  template <std::size_t t>
+  __attribute__((always_inline)) static constexpr void
+  round(std::uint32_t *v, std::uint32_t w) {
+    constexpr auto r = [](std::size_t k) { return (k + 5 - t % 5) % 5; };
+    v[r(4)] += rotl(v[r(0)], 5) + f<t>(v[r(1)], v[r(2)], v[r(3)]) + K<t>() + w;
+    v[r(1)] = rotl(v[r(1)], 30);
   }
 
-private:
   /**
    * @brief
    * 入力メッセージMに対し、メッセージ長が512-bitの倍数になるように、Mの末尾に以下のようなパディングを施す
@@ -135,71 +426,116 @@ private:
    *                                         ~ 423 ~  ~   64   ~
    *        01100001  01100010  01100011  1  00...00  00...011000
    *        a         b         c                          l = 24
+   *
+   * @note  メッセージ全体はコピーせず、バッファに残った最終ブロックにのみパディングを施して圧縮する
    */
-  std::vector<std::uint8_t>
-  padding(const std::vector<std::uint8_t> &msg) const {
-    // パディングすべき大きさを計算する
-    const std::size_t msglen = msg.size();
-    std::size_t padlen = 64 - (msglen % 64);
+  void padding() {
+    // 0b10000000を付加
+    buffer[buflen++] = 0b10000000;
 
-    // 余裕がなければ拡張
-    if (padlen < 9) {
-      padlen += 64;
+    // メッセージ長を書き込む余裕がなければ、もう1ブロック圧縮する
+    if (buflen > block_size - 8) {
+      zero_fill(block_size);
+      compress(buffer.data(), 1);
+      buflen = 0;
     }
+    zero_fill(block_size - 8);
 
-    // パディングされたメッセージを格納するための変数を用意
-    const std::size_t padded_len = msglen + padlen;
-    std::vector<std::uint8_t> padded_msg(padded_len,
-                                         0x00); // まずここで0で埋めてしまう
-    std::copy(msg.cbegin(), msg.cend(), padded_msg.begin());
-
-    // 0b10000000を付加
-    padded_msg[msglen] = 0b10000000;
+    // メッセージ長を64-bitのビット数として付加する
+    store_be64(buffer.data() + block_size - 8, msglen * 8);
+    compress(buffer.data(), 1);
+    buflen = 0;
+  }
 
-    // メッセージ長を付加
-    padded_msg[padded_len - 4] = static_cast<std::uint8_t>((msglen * 8) >> 24);
-    padded_msg[padded_len - 3] = static_cast<std::uint8_t>((msglen * 8) >> 16);
-    padded_msg[padded_len - 2] = static_cast<std::uint8_t>((msglen * 8) >> 8);
-    padded_msg[padded_len - 1] = static_cast<std::uint8_t>((msglen * 8));
+  /**
+   * @brief  byte列をバッファの末尾に追加する
+   */
+  void append(const std::uint8_t *p, std::size_t n) {
+    StatsTimer<> timer(statistics, &HashStats::copy_ticks);
+    std::copy(p, p + n, buffer.begin() + buflen);
+    buflen += n;
+  }
 
-    return padded_msg;
+  /**
+   * @brief  バッファのbuflenからendまでを0で埋める(パディング)
+   */
+  void zero_fill(std::size_t end) {
+    StatsTimer<> timer(statistics, &HashStats::copy_ticks);
+    std::fill(buffer.begin() + buflen, buffer.begin() + end, 0x00);
   }
 
   /**
    * @brief 論理関数ft(x, y, z)を定義する
    * @param t  0 <= t <= 79を満たすような整数(パラメタ)
+   * @note  tはコンパイル時に決まるので、ラウンドごとの分岐は残らない
    */
-  constexpr std::uint32_t f(std::uint32_t t, std::uint32_t x, std::uint32_t y,
-                            std::uint32_t z) const {
-    // if      (/*0<=t&&*/ t <= 19) { return ch(x, y, z);     }
-    // else if (20 <= t && t <= 39) { return parity(x, y, z); }
-    // else if (40 <= t && t <= 59) { return maj(x, y, z);    }
-    // return parity(x, y, z);  // 60 <= t <= 79
-
-    return (/*0<=t&&*/ t <= 19)
-               ? ch(x, y, z)
-               : (20 <= t && t <= 39)
-                     ? parity(x, y, z)
-                     : (40 <= t && t <= 59) ? maj(x, y, z)
-                                            : parity(x, y, z); // 60 <= t <= 79
+  template <std::size_t t>
+  static constexpr std::uint32_t f(std::uint32_t x, std::uint32_t y,
+                                   std::uint32_t z) {
+    static_assert(t <= 79);
+    if constexpr (t <= 19) {
+      return ch(x, y, z);
+    } else if constexpr (t <= 39) {
+      return parity(x, y, z);
+    } else if constexpr (t <= 59) {
+      return maj(x, y, z);
+    } else {
+      return parity(x, y, z);
+    }
   }
 
   /**
    * @brief SHA-1で使用する32-bit定数(関数)Ktの定義
    */
-  constexpr std::uint32_t K(std::uint32_t t) const {
-    // if      (/*0<=t&&*/ t <= 19) { return 0x5a827999; }
-    // else if (20 <= t && t <= 39) { return 0x6ed9eba1; }
-    // else if (40 <= t && t <= 59) { return 0x8f1bbcdc; }
-    // return 0xca62c1d6;  // 60 <= t <= 79
-
-    return (/*0<=t&&*/ t <= 19)
-               ? 0x5a827999
-               : (20 <= t && t <= 39)
-                     ? 0x6ed9eba1
-                     : (40 <= t && t <= 59) ? 0x8f1bbcdc
-                                            : 0xca62c1d6; // 60 <= t <= 79
+  template <std::size_t t> static constexpr std::uint32_t K() {
+    static_assert(t <= 79);
+    if constexpr (t <= 19) {
+      return 0x5a827999;
+    } else if constexpr (t <= 39) {
+      return 0x6ed9eba1;
+    } else if constexpr (t <= 59) {
+      return 0x8f1bbcdc;
+    } else {
+      return 0xca62c1d6;
+    }
   }
+
+  /**< @brief ハッシュ値(chaining state) H0, H1, ..., H4 */
+  std::array<std::uint32_t, 5> H;
+
+  /**< @brief 1ブロックに満たないメッセージの端数を保持するバッファ */
+  std::array<std::uint8_t, block_size> buffer;
+
+  /**< @brief バッファに保持しているbyte数 */
+  std::size_t buflen;
+
+  /**< @brief これまでに取り込んだメッセージ長(byte) */
+  std::uint64_t msglen;
+
+  /**< @brief 統計(無効なときは何も記録しない) */
+  inline static HashStats statistics{"sha1"};
+  inline static const bool registered =
+      stats_enabled && stats_register(statistics);
 };
 
+static_assert(std::is_trivially_copyable_v<SHA1::state_type>);
+static_assert(std::is_trivially_copyable_v<SHA1>);
+
+/**
+ * @brief  コンパイル時にも評価できるSHA1
+ * @note   例: constexpr auto d = sha1("abc");
+ */
+constexpr SHA1::digest_type sha1(std::string_view msg) {
+  return SHA1::hash_constexpr(msg.data(), msg.size());
+}
+
+template <std::size_t N>
+constexpr SHA1::digest_type sha1(const std::array<std::uint8_t, N> &msg) {
+  return SHA1::hash_constexpr(msg.data(), N);
+}
+
+#ifdef SHA_X86
+#include "sha1_shani.hpp"
+#endif
+
 #endif // SHA1_HPP
@@ -0,0 +1,89 @@
+/**
+ * @brief SHA extensions(SHA-NI)によるSHA1の圧縮関数
+ * @note  sha1.hppからincludeされる
+ *        ターゲット属性を付けているので、-mshaなしでビルドしても実行時に選択できる
+ */
+
+#ifndef SHA1_SHANI_HPP
+#define SHA1_SHANI_HPP
+
+#include "sha1.hpp"
+
+/**
+ * @note  sha1rnds4は(a, b, c, d)を1つのレジスタに持ち、1命令で4ラウンド進む
+ *        eはsha1nexteでrotl(a, 30)を求めつつW[t]に加算して渡す
+ *        論理関数ftと定数Ktは即値(0..3)で20ラウンドごとに切り替える
+ *        メッセージスケジュールはsha1msg1/sha1msg2で4 wordsずつ計算する
+ */
+__attribute__((target("sha,sse4.1"))) inline void
+SHA1::compress_shani(std::uint32_t *H, const std::uint8_t *blocks,
+                     std::size_t n) {
+  // 128-bit全体のbyte順を反転させ、W[t]が上位のwordに来るように読み込むためのマスク
+  const __m128i MASK =
+      _mm_set_epi64x(0x0001020304050607ULL, 0x08090a0b0c0d0e0fULL);
+
+  __m128i abcd = _mm_loadu_si128(reinterpret_cast<const __m128i *>(H));
+  abcd = _mm_shuffle_epi32(abcd, 0x1b); // A B C D を上位から並べる
+
+  // e0, e1を交互に使い、一方でラウンドを進めながら他方に次のeを用意する
+  __m128i E[2];
+  E[0] = _mm_set_epi32(static_cast<int>(H[4]), 0, 0, 0);
+
+  for (; n > 0; n--, blocks += block_size) {
+    const __m128i abcd_save = abcd;
+    const __m128i e_save = E[0];
+
+    // W[4i], ..., W[4i + 3]を保持するリングバッファ
+    __m128i M[4];
+
+    for (std::size_t i = 0; i < 20; i++) {
+      // 0 <= t <= 15 : メッセージをそのまま読み込む
+      if (i < 4) {
+        M[i] = _mm_shuffle_epi8(
+            _mm_loadu_si128(
+                reinterpret_cast<const __m128i *>(blocks + i * 16)),
+            MASK);
+      }
+
+      if (i == 0) {
+        E[0] = _mm_add_epi32(E[0], M[0]);
+      } else {
+        E[i % 2] = _mm_sha1nexte_epu32(E[i % 2], M[i % 4]);
+      }
+      E[(i + 1) % 2] = abcd;
+
+      // 16 <= t <= 79 : W[t - 3]の寄与を加えてrotl(..., 1)を完了させる
+      if (3 <= i && i <= 18) {
+        M[(i + 1) % 4] = _mm_sha1msg2_epu32(M[(i + 1) % 4], M[i % 4]);
+      }
+
+      if (i < 5) {
+        abcd = _mm_sha1rnds4_epu32(abcd, E[i % 2], 0);
+      } else if (i < 10) {
+        abcd = _mm_sha1rnds4_epu32(abcd, E[i % 2], 1);
+      } else if (i < 15) {
+        abcd = _mm_sha1rnds4_epu32(abcd, E[i % 2], 2);
+      } else {
+        abcd = _mm_sha1rnds4_epu32(abcd, E[i % 2], 3);
+      }
+
+      // W[t - 16] ^ W[t - 14]およびW[t - 8]の寄与を先に計算しておく
+      if (1 <= i && i <= 16) {
+        M[(i + 3) % 4] = _mm_sha1msg1_epu32(M[(i + 3) % 4], M[i % 4]);
+      }
+      if (2 <= i && i <= 17) {
+        M[(i + 2) % 4] = _mm_xor_si128(M[(i + 2) % 4], M[i % 4]);
+      }
+    }
+
+    // ハッシュ値の更新
+    E[0] = _mm_sha1nexte_epu32(E[0], e_save);
+    abcd = _mm_add_epi32(abcd, abcd_save);
+  }
+
+  abcd = _mm_shuffle_epi32(abcd, 0x1b);
+  _mm_storeu_si128(reinterpret_cast<__m128i *>(H), abcd);
+  H[4] = static_cast<std::uint32_t>(_mm_extract_epi32(E[0], 3));
+}
+
+#endif // end of SHA1_SHANI_HPP
@@ -0,0 +1,215 @@
+/**
+ * @brief SHA-224, SHA-384, SHA-512/224, SHA-512/256のテストプログラム
+ * @note  期待値はFIPS 180-4の例およびPythonのhashlibで求めた
+ */
+
+#define CATCH_CONFIG_MAIN // This tells Catch to provide a main() - only do this
+                          // in one cpp file
+#include "../alloc_counter.hpp"
+#include "../matcher.hpp"
+#include "sha2.hpp"
+
+namespace {
+
+const std::string msg448 =
+    "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq";
+const std::string msg896 = "abcdefghbcdefghicdefghijdefghijkefghijklfghijklm"
+                           "ghijklmnhijklmnoijklmnopjklmnopqklmnopqrlmnopqrs"
+                           "mnopqrstnopqrstu";
+
+} // namespace
+
+TEST_CASE("SHA224-Example") {
+  CHECK_THAT(SHA224().hash("abc"),
+             expect("23097d22 3405d822 8642a477 bda255b3 2aadbce4 "
+                    "bda0b3f7 e36c9da7"));
+  CHECK_THAT(SHA224().hash(std::string()),
+             expect("d14a028c 2a3a2bc9 476102bb 288234c4 15a2b01f "
+                    "828ea62a c5b3e42f"));
+  CHECK_THAT(SHA224().hash(msg448),
+             expect("75388b16 512776cc 5dba5da1 fd890150 b0c6455c "
+                    "b4f58b19 52522525"));
+  CHECK_THAT(SHA224().hash(msg896),
+             expect("c97ca9a5 59850ce9 7a04a96d ef6d99a9 e0e0e2ab "
+                    "14e6b8df 265fc0b3"));
+  CHECK_THAT(SHA224().hash(std::vector<std::uint8_t>(1000000, 0x61)),
+             expect("20794655 980c91d8 bbb4c1ea 97618a4b f03f4258 "
+                    "1948b2ee 4ee7ad67"));
+}
+
+TEST_CASE("SHA384-Example") {
+  CHECK_THAT(SHA384().hash("abc"),
+             expect("cb00753f45a35e8b b5a03d699ac65007 272c32ab0eded163 "
+                    "1a8b605a43ff5bed 8086072ba1e7cc23 58baeca134c825a7"));
+  CHECK_THAT(SHA384().hash(std::string()),
+             expect("38b060a751ac9638 4cd9327eb1b1e36a 21fdb71114be0743 "
+                    "4c0cc7bf63f6e1da 274edebfe76f65fb d51ad2f14898b95b"));
+  CHECK_THAT(SHA384().hash(msg448),
+             expect("3391fdddfc8dc739 3707a65b1b470939 7cf8b1d162af05ab "
+                    "fe8f450de5f36bc6 b0455a8520bc4e6f 5fe95b1fe3c8452b"));
+  CHECK_THAT(SHA384().hash(msg896),
+             expect("09330c33f71147e8 3d192fc782cd1b47 53111b173b3b05d2 "
+                    "2fa08086e3b0f712 fcc7c71a557e2db9 66c3e9fa91746039"));
+  CHECK_THAT(SHA384().hash(std::vector<std::uint8_t>(1000000, 0x61)),
+             expect("9d0e1809716474cb 086e834e310a4a1c ed149e9c00f24852 "
+                    "7972cec5704c2a5b 07b8b3dc38ecc4eb ae97ddd87f3d8985"));
+}
+
+TEST_CASE("SHA512_224-Example") {
+  CHECK_THAT(SHA512_224().hash("abc"),
+             expect("4634270f707b6a54 daae7530460842e2 0e37ed265ceee9a4 "
+                    "3e8924aa"));
+  CHECK_THAT(SHA512_224().hash(std::string()),
+             expect("6ed0dd02806fa89e 25de060c19d3ac86 cabb87d6a0ddd05c "
+                    "333b84f4"));
+  CHECK_THAT(SHA512_224().hash(msg448),
+             expect("e5302d6d54bb2422 75d1e7622d68df6e b02dedd13f564c13 "
+                    "dbda2174"));
+  CHECK_THAT(SHA512_224().hash(msg896),
+             expect("23fec5bb94d60b23 308192640b0c4533 35d664734fe40e72 "
+                    "68674af9"));
+  CHECK_THAT(SHA512_224().hash(std::vector<std::uint8_t>(1000000, 0x61)),
+             expect("37ab331d76f0d36d e422bd0edeb22a28 accd487b7a8453ae "
+                    "965dd287"));
+}
+
+TEST_CASE("SHA512_256-Example") {
+  CHECK_THAT(SHA512_256().hash("abc"),
+             expect("53048e2681941ef9 9b2e29b76b4c7dab e4c2d0c634fc6d46 "
+                    "e0e2f13107e7af23"));
+  CHECK_THAT(SHA512_256().hash(std::string()),
+             expect("c672b8d1ef56ed28 ab87c3622c511406 9bdd3ad7b8f97374 "
+                    "98d0c01ecef0967a"));
+  CHECK_THAT(SHA512_256().hash(msg448),
+             expect("bde8e1f9f19bb9fd 3406c90ec6bc47bd 36d8ada9f11880db "
+                    "c8a22a7078b6a461"));
+  CHECK_THAT(SHA512_256().hash(msg896),
+             expect("3928e184fb8690f8 40da3988121d31be 65cb9d3ef83ee614 "
+                    "6feac861e19b563a"));
+  CHECK_THAT(SHA512_256().hash(std::vector<std::uint8_t>(1000000, 0x61)),
+             expect("9a59a052930187a9 7038cae692f30708 aa6491923ef51943 "
+                    "94dc68d56c74fb21"));
+}
+
+TEST_CASE("SHA2-Constexpr") {
+  static_assert(digest_is(sha224("abc"), "23097d22 3405d822 8642a477 bda255b3 "
+                                         "2aadbce4 bda0b3f7 e36c9da7"));
+  static_assert(digest_is(sha512_256("abc"),
+                          "53048e2681941ef9 9b2e29b76b4c7dab e4c2d0c634fc6d46 "
+                          "e0e2f13107e7af23"));
+  static_assert(sha384("abc")[0] == 0xcb);
+  static_assert(sha512_224(std::array<std::uint8_t, 3>{'a', 'b', 'c'})[0] ==
+                0x46);
+
+  std::vector<std::uint8_t> msg(300);
+  for (std::size_t i = 0; i < msg.size(); i++) {
+    msg[i] = static_cast<std::uint8_t>(i * 7 + 3);
+  }
+  for (std::size_t len = 0; len <= msg.size(); len += 7) {
+    CHECK(SHA224::hash_constexpr(msg.data(), len) ==
+          SHA224().hash(msg.data(), len));
+    CHECK(SHA384::hash_constexpr(msg.data(), len) ==
+          SHA384().hash(msg.data(), len));
+  }
+}
+
+TEMPLATE_TEST_CASE("SHA2-Streaming", "", SHA224, SHA384, SHA512_224,
+                   SHA512_256) {
+  std::vector<std::uint8_t> msg(1000);
+  for (std::size_t i = 0; i < msg.size(); i++) {
+    msg[i] = static_cast<std::uint8_t>(i * 7 + 3);
+  }
+  const auto expected = TestType().hash(msg.data(), msg.size());
+
+  // 細かく分けて渡しても、init()で再利用しても結果は変わらない
+  TestType ctx;
+  for (std::size_t step : {1, 63, 64, 65, 127, 128, 129}) {
+    INFO("step = " << step);
+    ctx.init();
+    for (std::size_t off = 0; off < msg.size(); off += step) {
+      ctx.update(msg.data() + off, std::min(step, msg.size() - off));
+    }
+    CHECK(ctx.finalize() == expected);
+  }
+
+  TestType prefix;
+  prefix.update(msg.data(), 300);
+  CHECK(prefix.hash_suffix(msg.data() + 300, 700) == expected);
+  TestType restored(prefix.state());
+  restored.update(msg.data() + 300, 700);
+  CHECK(restored.finalize() == expected);
+}
+
+TEMPLATE_TEST_CASE("SHA2-Zero-Allocation", "", SHA224, SHA384, SHA512_224,
+                   SHA512_256) {
+  const std::vector<std::uint8_t> msg(1000, 0x61);
+  const std::size_t before = allocation_count;
+  for (int i = 0; i < 10; i++) {
+    static_cast<void>(TestType().hash(msg.data(), msg.size()));
+  }
+  CHECK(allocation_count == before);
+}
+
+TEMPLATE_TEST_CASE("SHA2-Backends", "", SHA224, SHA384, SHA512_224,
+                   SHA512_256) {
+  // 派生版はコアのバックエンドをそのまま使う
+  std::vector<std::uint8_t> msg(1000);
+  for (std::size_t i = 0; i < msg.size(); i++) {
+    msg[i] = static_cast<std::uint8_t>(i * 7 + 3);
+  }
+  const Backend original = TestType::backend();
+  REQUIRE(TestType::set_backend(Backend::Scalar));
+  std::vector<typename TestType::digest_type> expected;
+  for (std::size_t len = 0; len <= msg.size(); len += 13) {
+    expected.push_back(TestType().hash(msg.data(), len));
+  }
+
+  for (Backend b : {Backend::Scalar, Backend::SHANI, Backend::AVX2}) {
+    if (!TestType::set_backend(b)) {
+      continue;
+    }
+    INFO("backend = " << backend_name(b));
+    for (std::size_t len = 0, i = 0; len <= msg.size(); len += 13, i++) {
+      CHECK(TestType().hash(msg.data(), len) == expected[i]);
+    }
+  }
+  TestType::set_backend(original);
+}
+
+TEMPLATE_TEST_CASE("SHA2-Batch", "", SHA224, SHA384, SHA512_224,
+                   SHA512_256) {
+  std::vector<std::vector<std::uint8_t>> msgs;
+  std::vector<const void *> data;
+  std::vector<std::size_t> len;
+  std::vector<typename TestType::digest_type> expected;
+  for (std::size_t i = 0; i < 100; i++) {
+    msgs.emplace_back((i * 37) % 300, static_cast<std::uint8_t>(i));
+  }
+  for (auto &&m : msgs) {
+    data.push_back(m.data());
+    len.push_back(m.size());
+    expected.push_back(TestType().hash(m.data(), m.size()));
+  }
+
+  const Backend original = TestType::batch_backend();
+  for (Backend b : {Backend::Scalar, Backend::AVX2, Backend::AVX512}) {
+    if (!TestType::set_batch_backend(b)) {
+      continue;
+    }
+    INFO("batch backend = " << backend_name(b));
+    std::vector<typename TestType::digest_type> M(msgs.size());
+    TestType::hash_many(msgs.size(), data.data(), len.data(), M.data());
+    CHECK(M == expected);
+  }
+  TestType::set_batch_backend(original);
+}
+
+TEST_CASE("SHA2-Core") {
+  // 派生版を使っても、コアの初期ハッシュ値は変わらない
+  static_cast<void>(SHA224().hash("abc"));
+  static_cast<void>(SHA384().hash("abc"));
+  CHECK_THAT(SHA256().hash("abc"),
+             expect("ba7816bf 8f01cfea 414140de 5dae2223 b00361a3 "
+                    "96177a9c b410ff61 f20015ad"));
+  CHECK(SHA512().hash("abc")[0] == 0xdd);
+}
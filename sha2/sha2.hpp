@@ -0,0 +1,262 @@
+/**
+ * @brief SHA-224, SHA-384, SHA-512/224, SHA-512/256の実装
+ * @note  FIPS 180-4: これらはSHA256またはSHA512と初期ハッシュ値(IV)が異なり、
+ *        ハッシュ値の先頭だけを出力する点のほかは同じ計算を行う
+ *        圧縮関数、バックエンドの選択、hash_many()のSIMDレーンは全て
+ *        元になるSHA256, SHA512(コア)のものをそのまま使う
+ */
+
+#ifndef SHA2_HPP
+#define SHA2_HPP
+
+#include "../sha256/sha256.hpp"
+#include "../sha512/sha512.hpp"
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+/**
+ * @brief SHA-2の派生版
+ * @tparam Core   SHA256またはSHA512
+ * @tparam Params 派生版の定数(IVとdigest_size)を持つ型
+ * @note   コアを非公開に継承し、初期化と出力の切り詰めだけを差し替える
+ */
+template <class Core, class Params> class SHA2Variant : private Core {
+public:
+  using word_type = typename Core::word_type;
+  using state_type = typename Core::state_type;
+  using compress_fn = typename Core::compress_fn;
+
+  /**< @brief ブロック長(byte) */
+  static constexpr std::size_t block_size = Core::block_size;
+
+  /**< @brief ダイジェスト長(byte) */
+  static constexpr std::size_t digest_size = Params::digest_size;
+
+  /**< @brief ハッシュ化されたbyte列(digest message)の型 */
+  using digest_type = std::array<std::uint8_t, digest_size>;
+
+  /**< @brief 初期ハッシュ値 */
+  inline static constexpr std::array<word_type, 8> IV = Params::IV;
+
+  static_assert(digest_size <= Core::digest_size);
+
+public:
+  SHA2Variant() : Core(initial_state()) {}
+
+  /**
+   * @brief  途中状態から計算を再開する
+   */
+  explicit SHA2Variant(const state_type &s) : Core(s) {}
+
+  /**
+   * @brief  ハッシュ値とバッファを初期状態に戻す
+   */
+  void init() { Core::restore(initial_state()); }
+
+  using Core::restore;
+  using Core::state;
+  using Core::update;
+
+  /**
+   * @brief  最終ブロックにパディングを施し、ハッシュ値の先頭を求める
+   * @param  std::uint8_t* M ハッシュ値の書き込み先(digest_size byte)
+   */
+  void finalize(std::uint8_t *M) {
+    typename Core::digest_type D;
+    Core::finalize(D.data());
+    std::copy(D.begin(), D.begin() + digest_size, M);
+  }
+
+  /**
+   * @brief  最終ブロックにパディングを施し、ハッシュ値の先頭を求める
+   */
+  digest_type finalize() {
+    digest_type M;
+    finalize(M.data());
+    return M;
+  }
+
+  /**
+   * @brief  ハッシュ値を計算する
+   * @note   ヒープ確保を一切行わない
+   */
+  digest_type hash(const void *data, std::size_t len) const {
+    SHA2Variant ctx;
+    ctx.update(data, len);
+    return ctx.finalize();
+  }
+
+  std::vector<std::uint8_t> hash(const std::string &msg) const {
+    const digest_type M = hash(msg.data(), msg.size());
+    return std::vector<std::uint8_t>(M.cbegin(), M.cend());
+  }
+
+  std::vector<std::uint8_t> hash(const std::vector<std::uint8_t> &msg) const {
+    const digest_type M = hash(msg.data(), msg.size());
+    return std::vector<std::uint8_t>(M.cbegin(), M.cend());
+  }
+
+  /**
+   * @brief  自身をコピーして続きを取り込み、ハッシュ値を求める
+   */
+  digest_type hash_suffix(const void *data, std::size_t len) const {
+    SHA2Variant ctx = *this;
+    ctx.update(data, len);
+    return ctx.finalize();
+  }
+
+  /**
+   * @brief  コンパイル時にも評価できるハッシュ値の計算
+   */
+  template <class Byte>
+  static constexpr digest_type hash_constexpr(const Byte *data,
+                                              std::size_t len) {
+    const auto D = Core::hash_constexpr(data, len, IV);
+    digest_type M{};
+    for (std::size_t i = 0; i < digest_size; i++) {
+      M[i] = D[i];
+    }
+    return M;
+  }
+
+public:
+  using Core::backend;
+  using Core::batch_backend;
+  using Core::batch_kernel;
+  using Core::compress;
+  using Core::max_lanes;
+  using Core::set_backend;
+  using Core::set_batch_backend;
+  using Core::supports;
+  using Core::supports_batch;
+  using BatchKernel = typename Core::BatchKernel;
+
+  /**
+   * @brief  複数の独立したメッセージをまとめてハッシュ化する
+   * @note   コアのhash_many()をIVから始めて呼び出し、結果を切り詰める
+   */
+  static void hash_many(std::size_t n, const void *const *data,
+                        const std::size_t *len, digest_type *M) {
+    hash_many(n, data, len, M, SHA2Variant());
+  }
+
+  /**
+   * @brief  共通の接頭辞を取り込んだ状態から、複数のメッセージの続きをまとめて
+   *         ハッシュ化する
+   */
+  static void hash_many(std::size_t n, const void *const *data,
+                        const std::size_t *len, digest_type *M,
+                        const SHA2Variant &prefix) {
+    // ヒープ確保を避けるため、一定数ずつ区切って計算する
+    constexpr std::size_t chunk = 64;
+    typename Core::digest_type D[chunk];
+    for (std::size_t i = 0; i < n; i += chunk) {
+      const std::size_t m = std::min(chunk, n - i);
+      Core::hash_many(m, data + i, len + i, D,
+                      static_cast<const Core &>(prefix));
+      for (std::size_t j = 0; j < m; j++) {
+        std::copy(D[j].begin(), D[j].begin() + digest_size, M[i + j].begin());
+      }
+    }
+  }
+
+private:
+  static state_type initial_state() { return state_type{IV, {}, 0, 0}; }
+};
+
+/**< @brief SHA-224(SHA256のIVを変え、先頭224-bitを出力する) */
+struct SHA224Params {
+  static constexpr std::size_t digest_size = 28;
+  static constexpr std::array<std::uint32_t, 8> IV{
+      0xc1059ed8, 0x367cd507, 0x3070dd17, 0xf70e5939,
+      0xffc00b31, 0x68581511, 0x64f98fa7, 0xbefa4fa4,
+  };
+};
+
+/**< @brief SHA-384(SHA512のIVを変え、先頭384-bitを出力する) */
+struct SHA384Params {
+  static constexpr std::size_t digest_size = 48;
+  static constexpr std::array<std::uint64_t, 8> IV{
+      0xcbbb9d5dc1059ed8, 0x629a292a367cd507, 0x9159015a3070dd17,
+      0x152fecd8f70e5939, 0x67332667ffc00b31, 0x8eb44a8768581511,
+      0xdb0c2e0d64f98fa7, 0x47b5481dbefa4fa4,
+  };
+};
+
+/**< @brief SHA-512/224(IVはFIPS 180-4 5.3.6.1の生成関数による) */
+struct SHA512_224Params {
+  static constexpr std::size_t digest_size = 28;
+  static constexpr std::array<std::uint64_t, 8> IV{
+      0x8c3d37c819544da2, 0x73e1996689dcd4d6, 0x1dfab7ae32ff9c82,
+      0x679dd514582f9fcf, 0x0f6d2b697bd44da8, 0x77e36f7304c48942,
+      0x3f9d85a86a1d36c8, 0x1112e6ad91d692a1,
+  };
+};
+
+/**< @brief SHA-512/256(IVはFIPS 180-4 5.3.6.2の生成関数による) */
+struct SHA512_256Params {
+  static constexpr std::size_t digest_size = 32;
+  static constexpr std::array<std::uint64_t, 8> IV{
+      0x22312194fc2bf72c, 0x9f555fa3c84c64c2, 0x2393b86b6f53b151,
+      0x963877195940eabd, 0x96283ee2a88effe3, 0xbe5e1e2553863992,
+      0x2b0199fc2c85b8aa, 0x0eb72ddc81c52ca2,
+  };
+};
+
+using SHA224 = SHA2Variant<SHA256, SHA224Params>;
+using SHA384 = SHA2Variant<SHA512, SHA384Params>;
+using SHA512_224 = SHA2Variant<SHA512, SHA512_224Params>;
+using SHA512_256 = SHA2Variant<SHA512, SHA512_256Params>;
+
+static_assert(std::is_trivially_copyable_v<SHA224>);
+static_assert(std::is_trivially_copyable_v<SHA512_256>);
+
+/**
+ * @brief  コンパイル時にも評価できるSHA-224, SHA-384, SHA-512/224, SHA-512/256
+ * @note   例: constexpr auto d = sha512_256("abc");
+ */
+constexpr SHA224::digest_type sha224(std::string_view msg) {
+  return SHA224::hash_constexpr(msg.data(), msg.size());
+}
+
+constexpr SHA384::digest_type sha384(std::string_view msg) {
+  return SHA384::hash_constexpr(msg.data(), msg.size());
+}
+
+constexpr SHA512_224::digest_type sha512_224(std::string_view msg) {
+  return SHA512_224::hash_constexpr(msg.data(), msg.size());
+}
+
+constexpr SHA512_256::digest_type sha512_256(std::string_view msg) {
+  return SHA512_256::hash_constexpr(msg.data(), msg.size());
+}
+
+template <std::size_t N>
+constexpr SHA224::digest_type sha224(const std::array<std::uint8_t, N> &msg) {
+  return SHA224::hash_constexpr(msg.data(), N);
+}
+
+template <std::size_t N>
+constexpr SHA384::digest_type sha384(const std::array<std::uint8_t, N> &msg) {
+  return SHA384::hash_constexpr(msg.data(), N);
+}
+
+template <std::size_t N>
+constexpr SHA512_224::digest_type
+sha512_224(const std::array<std::uint8_t, N> &msg) {
+  return SHA512_224::hash_constexpr(msg.data(), N);
+}
+
+template <std::size_t N>
+constexpr SHA512_256::digest_type
+sha512_256(const std::array<std::uint8_t, N> &msg) {
+  return SHA512_256::hash_constexpr(msg.data(), N);
+}
+
+#endif // end of SHA2_HPP
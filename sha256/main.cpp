@@ -5,6 +5,7 @@
 
 #define CATCH_CONFIG_MAIN // This tells Catch to provide a main() - only do this
                           // in one cpp file
+#include "../alloc_counter.hpp"
 #include "../matcher.hpp"
 #include "sha256.hpp"
 
@@ -28,3 +29,255 @@ TEST_CASE("SHA256-Example") {
                              "a497200e 046d39cc c7112cd0"));
   }
 }
+
+TEST_CASE("SHA256-Streaming") {
+  SECTION("Split Message") {
+    SHA256 ctx;
+    ctx.update("a", 1);
+    ctx.update("bc", 2);
+    CHECK_THAT(ctx.finalize(),
+               expect("ba7816bf 8f01cfea 414140de 5dae2223 b00361a3 "
+                      "96177a9c b410ff61 f20015ad"));
+  }
+  SECTION("Empty Message") {
+    SHA256 ctx;
+    CHECK_THAT(ctx.finalize(),
+               expect("e3b0c442 98fc1c14 9afbf4c8 996fb924 27ae41e4 "
+                      "649b934c a495991b 7852b855"));
+  }
+  SECTION("Long Message") {
+    const std::vector<std::uint8_t> msg(1000000, 0x61);
+    for (std::size_t chunk : {1, 55, 63, 64, 65, 1000, 4096}) {
+      SHA256 ctx;
+      for (std::size_t i = 0; i < msg.size(); i += chunk) {
+        ctx.update(msg.data() + i, std::min(chunk, msg.size() - i));
+      }
+      CHECK_THAT(ctx.finalize(),
+                 expect("cdc76e5c 9914fb92 81a1c7e2 84d73e67 f1809a48 "
+                        "a497200e 046d39cc c7112cd0"));
+    }
+  }
+}
+
+TEST_CASE("SHA256-Zero-Allocation") {
+  const std::string msg(1000, 'a');
+  const std::size_t before = allocation_count.load();
+  const auto bytes = SHA256().hash(msg.data(), msg.size());
+  const std::size_t after = allocation_count.load();
+  CHECK(after == before);
+  CHECK_THAT(bytes, expect("41edece4 2d63e8d9 bf515a9b a6932e1c 20cbc9f5 "
+                           "a5d13464 5adb5db1 b9737ea3"));
+}
+
+TEST_CASE("SHA256-Stats-Disabled") {
+  // SHA_STATSを定義しなければ何も記録しない(有効な場合はstats/でテストする)
+  STATIC_REQUIRE_FALSE(stats_enabled);
+  const std::string msg(1000, 'a');
+  SHA256().hash(msg.data(), msg.size());
+  CHECK(SHA256::stats().total_blocks() == 0);
+  CHECK(SHA256::stats().bytes == 0);
+  CHECK(SHA256::stats().latency.empty());
+}
+
+TEST_CASE("SHA256-Prefix") {
+  std::vector<std::uint8_t> msg(500);
+  for (std::size_t i = 0; i < msg.size(); i++) {
+    msg[i] = static_cast<std::uint8_t>(i * 7 + 3);
+  }
+
+  // ブロック境界にない接頭辞も含め、接頭辞を一度だけ取り込んで使い回す
+  for (std::size_t plen : {0, 1, 55, 64, 100, 128, 200, 300}) {
+    INFO("prefix = " << plen);
+    SHA256 prefix;
+    prefix.update(msg.data(), plen);
+    const SHA256::state_type saved = prefix.state();
+    for (std::size_t len = 0; plen + len <= msg.size(); len += 37) {
+      const auto expected = SHA256().hash(msg.data(), plen + len);
+      CHECK(prefix.hash_suffix(msg.data() + plen, len) == expected);
+
+      SHA256 ctx(saved);
+      ctx.update(msg.data() + plen, len);
+      CHECK(ctx.finalize() == expected);
+    }
+
+    // restore()で同じオブジェクトを接頭辞の状態に戻せる
+    SHA256 ctx;
+    ctx.update("junk", 4);
+    ctx.restore(saved);
+    CHECK(ctx.finalize() == SHA256().hash(msg.data(), plen));
+  }
+}
+
+TEST_CASE("SHA256-Constexpr") {
+  // コンパイル時に評価されること
+  constexpr auto abc = sha256("abc");
+  constexpr auto empty = sha256("");
+  constexpr auto two =
+      sha256("abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq");
+  constexpr auto bytes = sha256(std::array<std::uint8_t, 3>{0x61, 0x62, 0x63});
+  static_assert(digest_is(abc,
+                          "ba7816bf 8f01cfea 414140de 5dae2223 b00361a3 "
+                          "96177a9c b410ff61 f20015ad"));
+  static_assert(digest_is(empty,
+                          "e3b0c442 98fc1c14 9afbf4c8 996fb924 27ae41e4 "
+                          "649b934c a495991b 7852b855"));
+  static_assert(digest_is(two,
+                          "248d6a61 d20638b8 e5c02693 0c3e6039 a33ce459 "
+                          "64ff2167 f6ecedd4 19db06c1"));
+  static_assert(digest_is(bytes,
+                          "ba7816bf 8f01cfea 414140de 5dae2223 b00361a3 "
+                          "96177a9c b410ff61 f20015ad"));
+
+  // ダイジェストをテンプレート引数に使う
+  using First = std::integral_constant<std::uint8_t, sha256("abc")[0]>;
+  CHECK(First::value == 0xba);
+
+  // 実行時に呼び出しても、通常の計算と一致すること
+  std::vector<std::uint8_t> msg(300);
+  for (std::size_t i = 0; i < msg.size(); i++) {
+    msg[i] = static_cast<std::uint8_t>(i * 7 + 3);
+  }
+  for (std::size_t len = 0; len <= msg.size(); len++) {
+    CHECK(SHA256::hash_constexpr(msg.data(), len) ==
+          SHA256().hash(msg.data(), len));
+  }
+}
+
+TEST_CASE("SHA256-Backends") {
+  // スカラー実装の結果を基準にして、各バックエンドの結果と突き合わせる
+  std::vector<std::uint8_t> msg(1000);
+  for (std::size_t i = 0; i < msg.size(); i++) {
+    msg[i] = static_cast<std::uint8_t>(i * 7 + 3);
+  }
+  const Backend original = SHA256::backend();
+  REQUIRE(SHA256::set_backend(Backend::Scalar));
+  std::vector<SHA256::digest_type> expected;
+  for (std::size_t len = 0; len <= msg.size(); len += 13) {
+    expected.push_back(SHA256().hash(msg.data(), len));
+  }
+
+  for (Backend b : {Backend::Scalar, Backend::SHANI, Backend::AVX2}) {
+    if (!SHA256::set_backend(b)) {
+      WARN("backend " << backend_name(b) << " is not supported");
+      continue;
+    }
+    INFO("backend = " << backend_name(b));
+    CHECK(SHA256::backend() == b);
+    CHECK_THAT(SHA256().hash("abc"),
+               expect("ba7816bf 8f01cfea 414140de 5dae2223 b00361a3 "
+                      "96177a9c b410ff61 f20015ad"));
+    CHECK_THAT(SHA256().hash(std::vector<std::uint8_t>(1000000, 0x61)),
+               expect("cdc76e5c 9914fb92 81a1c7e2 84d73e67 f1809a48 "
+                      "a497200e 046d39cc c7112cd0"));
+    for (std::size_t len = 0, i = 0; len <= msg.size(); len += 13, i++) {
+      CHECK(SHA256().hash(msg.data(), len) == expected[i]);
+    }
+  }
+  SHA256::set_backend(original);
+}
+
+TEST_CASE("SHA256-Batch") {
+  // 長さの異なるメッセージを用意し、1つずつ計算した結果と突き合わせる
+  std::vector<std::vector<std::uint8_t>> msgs;
+  for (std::size_t i = 0; i < 100; i++) {
+    msgs.emplace_back((i * 37) % 300, static_cast<std::uint8_t>(i));
+  }
+  std::vector<const void *> data;
+  std::vector<std::size_t> len;
+  std::vector<SHA256::digest_type> expected;
+  for (auto &&m : msgs) {
+    data.push_back(m.data());
+    len.push_back(m.size());
+    expected.push_back(SHA256().hash(m.data(), m.size()));
+  }
+
+  const Backend original = SHA256::batch_backend();
+  for (Backend b : {Backend::Scalar, Backend::AVX2, Backend::AVX512}) {
+    if (!SHA256::set_batch_backend(b)) {
+      WARN("batch backend " << backend_name(b) << " is not supported");
+      continue;
+    }
+    INFO("batch backend = " << backend_name(b));
+    for (std::size_t n : {0, 1, 7, 8, 9, 16, 17, 100}) {
+      std::vector<SHA256::digest_type> M(n);
+      SHA256::hash_many(n, data.data(), len.data(), M.data());
+      CHECK(std::equal(M.cbegin(), M.cend(), expected.cbegin()));
+    }
+
+    const std::vector<std::uint8_t> msg(1000000, 0x61);
+    const void *p[] = {"abc", msg.data()};
+    const std::size_t l[] = {3, msg.size()};
+    SHA256::digest_type M[2];
+    SHA256::hash_many(2, p, l, M);
+    CHECK_THAT(M[0], expect("ba7816bf 8f01cfea 414140de 5dae2223 b00361a3 "
+                            "96177a9c b410ff61 f20015ad"));
+    CHECK_THAT(M[1], expect("cdc76e5c 9914fb92 81a1c7e2 84d73e67 f1809a48 "
+                            "a497200e 046d39cc c7112cd0"));
+  }
+  SHA256::set_batch_backend(original);
+}
+
+TEST_CASE("SHA256-Fixed-Length") {
+  // 64byteのメッセージを並べた領域(Merkle木の1段に相当する)
+  std::vector<std::uint8_t> level(64 * 40);
+  for (std::size_t i = 0; i < level.size(); i++) {
+    level[i] = static_cast<std::uint8_t>(i * 7 + 3);
+  }
+  const auto double_hash = [](const void *data, std::size_t len) {
+    const auto inner = SHA256().hash(data, len);
+    return SHA256().hash(inner.data(), inner.size());
+  };
+
+  SECTION("Bitcoin Genesis Block") {
+    // ブロックヘッダ(80byte)のdouble-SHA256がブロックのハッシュ値になる
+    const std::string hex =
+        "0100000000000000000000000000000000000000000000000000000000000000"
+        "000000003ba3edfd7a7b12b27ac72c3e67768f617fc81bc3888a51323a9fb8aa"
+        "4b1e5e4a29ab5f49ffff001d1dac2b7c";
+    std::vector<std::uint8_t> header;
+    for (std::size_t i = 0; i < hex.size(); i += 2) {
+      header.push_back(
+          static_cast<std::uint8_t>(std::stoi(hex.substr(i, 2), nullptr, 16)));
+    }
+    CHECK_THAT(sha256d(header.data(), header.size()),
+               expect("6fe28c0a b6f1b372 c1a6a246 ae63f74f 931e8365 "
+                      "e15a089c 68d61900 00000000"));
+  }
+
+  SECTION("Backends") {
+    const Backend original = SHA256::backend();
+    for (Backend b : {Backend::Scalar, Backend::SHANI, Backend::AVX2}) {
+      if (!SHA256::set_backend(b)) {
+        continue;
+      }
+      INFO("backend = " << backend_name(b));
+      for (std::size_t i = 0; i < 40; i++) {
+        const std::uint8_t *p = level.data() + i * 64;
+        CHECK(sha256_64(p) == SHA256().hash(p, 64));
+        CHECK(sha256d_64(p) == double_hash(p, 64));
+        CHECK(sha256d(p, i * 13) == double_hash(p, i * 13));
+      }
+    }
+    SHA256::set_backend(original);
+  }
+
+  SECTION("Batch") {
+    const Backend original = SHA256::batch_backend();
+    for (Backend b : {Backend::Scalar, Backend::AVX2, Backend::AVX512}) {
+      if (!SHA256::set_batch_backend(b)) {
+        continue;
+      }
+      INFO("batch backend = " << backend_name(b));
+      for (std::size_t n : {0, 1, 3, 4, 8, 9, 16, 17, 40}) {
+        std::vector<SHA256::digest_type> M(n), D(n);
+        sha256_64_many(n, level.data(), M.data());
+        sha256d_64_many(n, level.data(), D.data());
+        for (std::size_t i = 0; i < n; i++) {
+          CHECK(M[i] == SHA256().hash(level.data() + i * 64, 64));
+          CHECK(D[i] == double_hash(level.data() + i * 64, 64));
+        }
+      }
+    }
+    SHA256::set_batch_backend(original);
+  }
+}
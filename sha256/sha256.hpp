@@ -7,18 +7,219 @@
 #define SHA256_HPP
 
 #include "../bit.hpp"
+#include "../cpu.hpp"
+#include "../multi_buffer.hpp"
+#include "../stats.hpp"
+#include "../unroll.hpp"
+#include <algorithm>
 #include <array>
 #include <string>
+#include <string_view>
+#include <type_traits>
 #include <vector>
 
-//#define DEBUG
-#ifdef DEBUG
-#define FMT_HEADER_ONLY
-#include <../fmt/printf.h>
-#include <iostream>
-#endif
-
 class SHA256 {
+public:
+  /**< @brief ブロック長(byte) */
+  static constexpr std::size_t block_size = 64;
+
+  /**< @brief ダイジェスト長(byte) */
+  static constexpr std::size_t digest_size = 32;
+
+  /**< @brief ハッシュ化されたbyte列(digest message)の型 */
+  using digest_type = std::array<std::uint8_t, digest_size>;
+
+  /**< @brief ハッシュ値および message schedule を構成するwordの型 */
+  using word_type = std::uint32_t;
+
+  /**< @brief n個の連続したブロックを圧縮し、ハッシュ値Hを更新する関数の型 */
+  using compress_fn = void (*)(std::uint32_t *H, const std::uint8_t *blocks,
+                               std::size_t n);
+
+public:
+  SHA256() { init(); }
+
+  /**
+   * @brief  ハッシュ値とバッファを初期状態に戻す
+   * @note   finalize()の後に同じオブジェクトを再利用する場合に呼び出す
+   */
+  void init() {
+    H = IV;
+    buflen = 0;
+    msglen = 0;
+  }
+
+  /**
+   * @brief  メッセージの続きを取り込む
+   * @param  const void* data 追加するbyte列の先頭
+   * @param  std::size_t len  追加するbyte数
+   * @note   何度呼び出しても、保持するのは1ブロック分のバッファとハッシュ値のみ
+   */
+  void update(const void *data, std::size_t len) {
+    const auto *p = static_cast<const std::uint8_t *>(data);
+    msglen += len;
+    statistics.add(statistics.bytes, len);
+
+    // バッファに端数が残っていれば、先に1ブロック分まで埋める
+    if (buflen > 0) {
+      const std::size_t n = std::min(len, block_size - buflen);
+      append(p, n);
+      p += n;
+      len -= n;
+      if (buflen < block_size) {
+        return;
+      }
+      compress(H.data(), buffer.data(), 1);
+      buflen = 0;
+    }
+
+    // 揃っているブロックはコピーせずにまとめて圧縮する
+    const std::size_t n = len / block_size;
+    if (n > 0) {
+      compress(H.data(), p, n);
+      p += n * block_size;
+      len -= n * block_size;
+    }
+
+    // 端数はバッファに退避しておく
+    append(p, len);
+  }
+
+  /**
+   * @brief  最終ブロックにパディングを施し、ハッシュ値を求める
+   * @param  std::uint8_t* M ハッシュ値の書き込み先(digest_size byte)
+   */
+  void finalize(std::uint8_t *M) {
+    padding();
+
+    for (std::size_t i = 0; i < 8; i++) {
+      store_be32(M + i * 4, H[i]);
+    }
+  }
+
+  /**
+   * @brief  最終ブロックにパディングを施し、ハッシュ値を求める
+   * @return ハッシュ化されたbyte列(digest message)
+   */
+  digest_type finalize() {
+    digest_type M; // 8 * 32 = 256-bits
+    finalize(M.data());
+    return M;
+  }
+
+public:
+  /**< @brief 計算の途中状態(memcpyで複製できる) */
+  struct state_type {
+    std::array<std::uint32_t, 8> H;
+    std::array<std::uint8_t, block_size> buffer;
+    std::size_t buflen;
+    std::uint64_t msglen;
+  };
+
+  /**
+   * @brief  途中状態から計算を再開する
+   */
+  explicit SHA256(const state_type &s) { restore(s); }
+
+  /**
+   * @brief  現在の途中状態を返す
+   * @note   共通の接頭辞を一度だけ取り込んだ状態を保存し、メッセージごとに
+   *         restore()あるいはコピーして使い回す
+   */
+  state_type state() const { return state_type{H, buffer, buflen, msglen}; }
+
+  /**
+   * @brief  保存した途中状態に戻す
+   */
+  void restore(const state_type &s) {
+    H = s.H;
+    buffer = s.buffer;
+    buflen = s.buflen;
+    msglen = s.msglen;
+  }
+
+  /**
+   * @brief  自身をコピーして続きを取り込み、ハッシュ値を求める
+   * @param  const void* data 続きのbyte列の先頭
+   * @param  std::size_t len  続きのbyte数
+   * @note   自身は変更しないので、接頭辞を取り込んだ状態から何度でも呼び出せる
+   *         圧縮するのは続きを含むブロックだけ
+   */
+  digest_type hash_suffix(const void *data, std::size_t len) const {
+    SHA256 ctx = *this;
+    ctx.update(data, len);
+    return ctx.finalize();
+  }
+
+public:
+  /**
+   * @brief  SHA256の計算を行う
+   * @param  const void* data ハッシュ化対象のbyte列の先頭
+   * @param  std::size_t len  ハッシュ化対象のbyte数
+   * @return ハッシュ化されたbyte列(digest message)
+   * @note   ヒープ確保を一切行わない
+   */
+  digest_type hash(const void *data, std::size_t len) const {
+    const std::uint64_t start = stats_histogram_enabled ? stats_ticks() : 0;
+    SHA256 ctx;
+    ctx.update(data, len);
+    const digest_type M = ctx.finalize();
+    if constexpr (stats_histogram_enabled) {
+      statistics.add_latency(len, stats_ticks() - start);
+    }
+    return M;
+  }
+
+  /**
+   * @brief  コンパイル時にも評価できるSHA256の計算
+   * @param  const Byte* data ハッシュ化対象のbyte列の先頭(charまたはuint8_t)
+   * @param  std::size_t len  ハッシュ化対象のbyte数
+   * @param  iv               初期ハッシュ値(SHA-2の派生版はIVだけが異なる)
+   * @return ハッシュ化されたbyte列(digest message)
+   * @note   定数式ではバックエンドを選択できないので、常にスカラー実装で計算する
+   *         通常はsha256()から呼び出す
+   */
+  template <class Byte>
+  static constexpr digest_type
+  hash_constexpr(const Byte *data, std::size_t len,
+                 const std::array<std::uint32_t, 8> &iv = IV) {
+    std::uint32_t S[8] = {};
+    for (std::size_t i = 0; i < 8; i++) {
+      S[i] = iv[i];
+    }
+
+    // 揃っているブロックを1つずつコピーして圧縮する
+    std::uint8_t block[block_size] = {};
+    std::size_t off = 0;
+    for (; off + block_size <= len; off += block_size) {
+      for (std::size_t i = 0; i < block_size; i++) {
+        block[i] = static_cast<std::uint8_t>(data[off + i]);
+      }
+      compress_block(S, block);
+    }
+
+    // 端数に M || 1 || 0k || l のパディングを施す
+    const std::size_t r = len - off;
+    for (std::size_t i = 0; i < block_size; i++) {
+      block[i] = i < r ? static_cast<std::uint8_t>(data[off + i]) : 0x00;
+    }
+    block[r] = 0b10000000;
+    if (r + 1 > block_size - 8) {
+      compress_block(S, block);
+      for (std::size_t i = 0; i < block_size; i++) {
+        block[i] = 0x00;
+      }
+    }
+    store_be64(block + block_size - 8, static_cast<std::uint64_t>(len) * 8);
+    compress_block(S, block);
+
+    digest_type M{};
+    for (std::size_t i = 0; i < 8; i++) {
+      store_be32(&M[i * 4], S[i]);
+    }
+    return M;
+  }
+
 public:
   /**
    * @brief  SHA256の計算を行う
@@ -26,9 +227,8 @@ public:
    * @return ハッシュ化されたbyte列(digest message)
    */
   std::vector<std::uint8_t> hash(const std::string &msg) const {
-    std::vector<std::uint8_t> bytes(msg.size(), 0x00);
-    std::copy(msg.cbegin(), msg.cend(), bytes.begin());
-    return hash(bytes);
+    const digest_type M = hash(msg.data(), msg.size());
+    return std::vector<std::uint8_t>(M.cbegin(), M.cend());
   }
 
 public:
@@ -38,111 +238,601 @@ public:
    * @return ハッシュ化されたbyte列(digest message)
    */
   std::vector<std::uint8_t> hash(const std::vector<std::uint8_t> &msg) const {
-    // ハッシュ値を用意
-    std::vector<std::uint32_t> H{
-        0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
-        0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
-    };
-
-    // プリプロセス: メッセージにパディングを施す
-    const std::vector<std::uint8_t> padded_msg = padding(msg);
-
-    // メッセージを512-bitのチャンクに分割する
-    const std::size_t chunks_num =
-        padded_msg.size() / 64; // チャンクの大きさは512(8 * 64)-bit * n
-    for (std::size_t i = 0; i < chunks_num; i++) {
-
-      // message schedule: W0, W1, ..., W63
-      std::uint32_t W[64];
-
-      // 0 <= t <= 15 : メッセージを16つの32-bit wordsに分割する
-      for (std::uint32_t t = 0; t < 16; t++) {
-
-        const std::uint32_t base = i * 64 + t * 4;
-        W[t] = (padded_msg[base + 0] << 24) | (padded_msg[base + 1] << 16) |
-               (padded_msg[base + 2] << 8) | (padded_msg[base + 3]);
-#ifdef DEBUG
-        fmt::printf("W[%2d] = %08x\n", t, W[t]);
+    const digest_type M = hash(msg.data(), msg.size());
+    return std::vector<std::uint8_t>(M.cbegin(), M.cend());
+  }
+
+public:
+  /**
+   * @brief  ちょうど64byte(ダイジェスト2つの連結)のメッセージのSHA256
+   * @param  const void* data 64byteのメッセージの先頭
+   * @note   2つ目のブロックはパディングだけで、message scheduleまで定数なので
+   *         Kt + Wtを事前に計算したラウンドだけで圧縮する
+   *         定義はsha256_fixed.hppにある(sha256_64()から呼び出す)
+   */
+  static digest_type hash_64(const void *data);
+
+  /**
+   * @brief  SHA256(SHA256(data))(double-SHA256)
+   * @note   内側のハッシュ値はbyte列に戻さず、外側のmessage scheduleの
+   *         先頭8 wordsとしてそのまま使う(sha256d()から呼び出す)
+   */
+  static digest_type hash_d(const void *data, std::size_t len);
+
+  /**
+   * @brief  64byteのメッセージのSHA256(SHA256(data))(Merkle木の節)
+   */
+  static digest_type hash_d64(const void *data);
+
+  /**
+   * @brief  64byteのメッセージn個のSHA256をまとめて計算する
+   * @param  const void* data 64byteのメッセージがn個連続した領域
+   * @param  digest_type* M   各メッセージのハッシュ値の書き込み先
+   * @note   ダイジェストの配列を渡せば、Merkle木の1段を1回の呼び出しで計算できる
+   *         hash_many()のバックエンドのSIMDレーンに並べ、
+   *         パディングのブロックは全てのレーンで同じものを使う
+   */
+  static void hash_64_many(std::size_t n, const void *data, digest_type *M);
+
+  /**
+   * @brief  64byteのメッセージn個のSHA256(SHA256(data))をまとめて計算する
+   */
+  static void hash_d64_many(std::size_t n, const void *data, digest_type *M);
+
+public:
+  /**
+   * @brief ナンスのwordだけが変わるブロックの前計算
+   * @note  word番目と次のwordだけがナンスごとに変わるとき、それより前のラウンドの
+   *        結果と、ナンスに依存しないWt(およびKt + Wt)を一度だけ求めておく
+   */
+  struct NonceSchedule {
+    /**< @brief 圧縮前のハッシュ値(midstate) */
+    std::array<std::uint32_t, 8> H;
+
+    /**< @brief word番目のラウンド直前の変数 */
+    std::array<std::uint32_t, 8> v;
+
+    /**< @brief Wt(ナンスに依存しないものだけが正しい) */
+    std::array<std::uint32_t, 64> W;
+
+    /**< @brief Kt + Wt(同上) */
+    std::array<std::uint32_t, 64> KW;
+
+    /**< @brief ナンスを含む最初のword(0 - 15) */
+    std::size_t word;
+  };
+
+  /**
+   * @brief  ナンスを含むブロックを前計算する
+   * @param  const std::uint32_t* H     圧縮前のハッシュ値
+   * @param  const std::uint8_t* block 64byteのブロック(ナンスの位置の値は問わない)
+   * @param  std::size_t word          ナンスを含む最初のword
+   * @note   定義はsha256_nonce.hppにある
+   */
+  static NonceSchedule nonce_schedule(const std::uint32_t *H,
+                                      const std::uint8_t *block,
+                                      std::size_t word);
+
+  /**
+   * @brief  ナンスのwordだけを差し替えたブロックを圧縮する
+   * @param  std::uint32_t w0 word番目の値
+   * @param  std::uint32_t w1 word + 1番目の値(word = 15なら使わない)
+   * @param  std::uint32_t* H 圧縮後のハッシュ値の書き込み先
+   * @note   word番目より前のラウンドと、ナンスに依存しないWtの計算を省く
+   *         常にスカラーで計算する
+   */
+  static void compress_nonce(const NonceSchedule &s, std::uint32_t w0,
+                             std::uint32_t w1, std::uint32_t *H);
+
+public:
+  /**
+   * @brief  現在使用している圧縮関数のバックエンドを返す
+   * @note   初回呼び出し時にCPUIDを確認し、使用可能な最速のものが選ばれる
+   *         環境変数SHA_BACKENDで強制することもできる
+   */
+  static Backend backend() { return dispatcher().backend; }
+
+  /**
+   * @brief  実行中のCPUでバックエンドが使用可能か判定する
+   */
+  static bool supports(Backend b) {
+    switch (b) {
+    case Backend::Scalar:
+      return true;
+#ifdef SHA_X86
+    case Backend::SHANI:
+      return cpu_features().sha && cpu_features().sse41;
+    case Backend::AVX2:
+      return cpu_features().avx2 && cpu_features().bmi2;
 #endif
-      }
+    default:
+      return false;
+    }
+  }
 
-      // 16 <= t <= 63 : 16つの32-bits wordsを64つの32-bit wordsに分割する
-      for (std::uint32_t t = 16; t < 64; t++) {
-        W[t] = small_sigma1(W[t - 2]) + W[t - 7] + small_sigma0(W[t - 15]) +
-               W[t - 16];
+  /**
+   * @brief  圧縮関数のバックエンドを強制する
+   * @return 実行中のCPUで使用できなければ何もせずにfalseを返す
+   * @note   他のスレッドがハッシュ計算中に呼び出してはならない
+   */
+  static bool set_backend(Backend b) {
+    if (!supports(b)) {
+      return false;
+    }
+    dispatcher() = Dispatcher{b, select(b)};
+    statistics.select(b);
+    return true;
+  }
+
+public:
+  /**
+   * @brief  選択されたバックエンドでn個のブロックを圧縮し、ハッシュ値Hを更新する
+   * @param  std::uint32_t* H            ハッシュ値 H0, H1, ..., H7
+   * @param  const std::uint8_t* blocks 64byteのブロックが連続した領域の先頭
+   * @param  std::size_t n              ブロックの個数
+   * @note   パディングは行わない
+   */
+  static void compress(std::uint32_t *H, const std::uint8_t *blocks,
+                       std::size_t n) {
+    StatsTimer<> timer(statistics, &HashStats::compress_ticks);
+    const Dispatcher &d = dispatcher();
+    d.compress(H, blocks, n);
+    statistics.add_blocks(d.backend, n);
+  }
+
+public:
+  /**
+   * @brief  複数の独立したメッセージをまとめてハッシュ化する
+   * @param  std::size_t n           メッセージの個数
+   * @param  const void* const* data 各メッセージの先頭
+   * @param  const std::size_t* len  各メッセージのbyte数
+   * @param  digest_type* M          各メッセージのハッシュ値の書き込み先
+   * @note   AVX-512では16, AVX2では8つのメッセージをSIMDレーンに割り当てて計算する
+   *         Scalarでは1つずつ計算する
+   */
+  static void hash_many(std::size_t n, const void *const *data,
+                        const std::size_t *len, digest_type *M) {
+    hash_many(n, data, len, M, SHA256());
+  }
+
+  /**
+   * @brief  共通の接頭辞を取り込んだ状態から、複数のメッセージの続きをまとめて
+   *         ハッシュ化する
+   * @param  const SHA256& prefix 接頭辞を取り込んだ状態(HMACの鍵ブロックなど)
+   * @note   各メッセージのハッシュ値は、prefixをコピーしてdata[i]を取り込んだ
+   *         ものと等しい。接頭辞がブロック長の倍数でなければ1つずつ計算する
+   */
+  static void hash_many(std::size_t n, const void *const *data,
+                        const std::size_t *len, digest_type *M,
+                        const SHA256 &prefix) {
+    switch (prefix.buflen == 0 ? batch_dispatcher() : Backend::Scalar) {
+#ifdef SHA_X86
+    case Backend::AVX512:
+      count_bytes(n, len);
+      MultiBuffer<SHA256, 16>::run(compress_x16_avx512, n, data, len, M,
+                                   prefix.H.data(), prefix.msglen);
+      return;
+    case Backend::AVX2:
+      count_bytes(n, len);
+      MultiBuffer<SHA256, 8>::run(compress_x8_avx2, n, data, len, M,
+                                  prefix.H.data(), prefix.msglen);
+      return;
+#endif
+    default:
+      for (std::size_t i = 0; i < n; i++) {
+        SHA256 ctx = prefix;
+        ctx.update(data[i], len[i]);
+        M[i] = ctx.finalize();
       }
+      return;
+    }
+  }
+
+  /**
+   * @brief  hash_many()で使用しているバックエンドを返す
+   * @note   環境変数SHA_BATCH_BACKENDで強制することもできる
+   */
+  static Backend batch_backend() { return batch_dispatcher(); }
+
+  /**
+   * @brief  hash_many()で使用可能なバックエンドか判定する
+   */
+  static bool supports_batch(Backend b) {
+    switch (b) {
+    case Backend::Scalar:
+      return true;
+#ifdef SHA_X86
+    case Backend::AVX2:
+      return cpu_features().avx2;
+    case Backend::AVX512:
+      return cpu_features().avx512f;
+#endif
+    default:
+      return false;
+    }
+  }
+
+  /**
+   * @brief  hash_many()のバックエンドを強制する
+   * @return 実行中のCPUで使用できなければ何もせずにfalseを返す
+   * @note   他のスレッドがハッシュ計算中に呼び出してはならない
+   */
+  static bool set_batch_backend(Backend b) {
+    if (!supports_batch(b)) {
+      return false;
+    }
+    batch_dispatcher() = b;
+    return true;
+  }
+
+  /**
+   * @brief  複数のレーンのブロックを1つずつ同時に圧縮する関数
+   * @param  std::uint32_t* S             各レーンのハッシュ値(S[i * lanes + lane])
+   * @param  const std::uint8_t* const* blocks 各レーンのブロックの先頭
+   * @note   Sは64byte境界に揃えること
+   */
+  using batch_kernel_fn = void (*)(std::uint32_t *S,
+                                   const std::uint8_t *const *blocks);
 
-      // 8つの変数a, b, c, d, e, f, g, hを(i - 1)st hash valueで初期化する
-      std::uint32_t a = H[0];
-      std::uint32_t b = H[1];
-      std::uint32_t c = H[2];
-      std::uint32_t d = H[3];
-      std::uint32_t e = H[4];
-      std::uint32_t f = H[5];
-      std::uint32_t g = H[6];
-      std::uint32_t h = H[7];
-
-      // Main Loop
-      for (std::uint32_t t = 0; t < 64; t++) {
-
-        const std::uint32_t T1 = h + big_sigma1(e) + ch(e, f, g) + K[t] + W[t];
-        const std::uint32_t T2 = big_sigma0(a) + maj(a, b, c);
-
-        h = g;
-        g = f;
-        f = e;
-        e = d + T1;
-        d = c;
-        c = b;
-        b = a;
-        a = T1 + T2;
-
-#ifdef DEBUG
-        fmt::printf("t = %2d ", t);
-        fmt::printf("a = %08x ", a);
-        fmt::printf("b = %08x ", b);
-        fmt::printf("c = %08x ", c);
-        fmt::printf("d = %08x ", d);
-        fmt::printf("e = %08x ", e);
-        fmt::printf("f = %08x ", f);
-        fmt::printf("g = %08x ", g);
-        fmt::printf("h = %08x\n", h);
+  /**< @brief hash_many()のバックエンドのレーン数と圧縮関数 */
+  struct BatchKernel {
+    std::size_t lanes;
+    batch_kernel_fn compress;
+  };
+
+  /**< @brief batch_kernel()のレーン数の上限 */
+  static constexpr std::size_t max_lanes = 16;
+
+  /**
+   * @brief  hash_many()のバックエンドの圧縮関数を返す
+   * @param  std::size_t n 同時に計算できるメッセージの数
+   * @note   パディングを自前で行う呼び出し側(PBKDF2の反復など)のためのもの
+   *         Scalarでは1レーンとなり、圧縮にはcompress()のバックエンドを使う
+   *         nがレーン数の半分に満たなければ、1つずつ圧縮するほうが速いので1レーンとする
+   */
+  static BatchKernel batch_kernel(std::size_t n = max_lanes) {
+    switch (batch_dispatcher()) {
+#ifdef SHA_X86
+    case Backend::AVX512:
+      return n >= 8 ? BatchKernel{16, compress_x16_avx512}
+                    : BatchKernel{1, compress_x1};
+    case Backend::AVX2:
+      return n >= 4 ? BatchKernel{8, compress_x8_avx2}
+                    : BatchKernel{1, compress_x1};
 #endif
+    default:
+      return BatchKernel{1, compress_x1};
+    }
+  }
+
+  /**
+   * @brief  SHA256の統計を返す
+   * @note   SHA_STATSを定義してコンパイルしたときだけ記録される(stats.hpp)
+   */
+  static HashStats &stats() { return statistics; }
+
+  /**< @brief 初期ハッシュ値 H0, H1, ..., H7 */
+  inline static constexpr std::array<std::uint32_t, 8> IV{
+      0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+      0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+  };
+
+private:
+  static Backend &batch_dispatcher() {
+    static Backend b = [] {
+      Backend x;
+      if (!requested_backend(x, "SHA_BATCH_BACKEND") || !supports_batch(x)) {
+        // SHA extensionsが使えるなら、1本ずつ計算してもAVX2の8レーンと同程度に速い
+        if (supports_batch(Backend::AVX512)) {
+          x = Backend::AVX512;
+        } else if (supports_batch(Backend::AVX2) && !supports(Backend::SHANI)) {
+          x = Backend::AVX2;
+        } else {
+          x = Backend::Scalar;
+        }
       }
+      return x;
+    }();
+    return b;
+  }
 
-      // ハッシュ値の更新
-      H[0] = a + H[0];
-      H[1] = b + H[1];
-      H[2] = c + H[2];
-      H[3] = d + H[3];
-      H[4] = e + H[4];
-      H[5] = f + H[5];
-      H[6] = g + H[6];
-      H[7] = h + H[7];
-
-#ifdef __DEBUG__
-      for (auto &&h : H) {
-        fmt::printf("%08x ", h);
+  /**
+   * @brief  hash_many()のSIMDレーンで取り込んだbyte数を記録する
+   * @note   圧縮したブロック数はMultiBufferがカーネルを呼び出すたびに記録する
+   */
+  static void count_bytes(std::size_t n, const std::size_t *len) {
+    if constexpr (stats_enabled) {
+      for (std::size_t i = 0; i < n; i++) {
+        statistics.add(statistics.bytes, len[i]);
       }
-      std::cout << std::endl;
+    }
+  }
+
+  /**
+   * @brief  1レーンのbatch_kernel()(1レーンではSを通常のハッシュ値と同じに扱える)
+   */
+  static void compress_x1(std::uint32_t *S,
+                          const std::uint8_t *const *blocks) {
+    compress(S, blocks[0], 1);
+  }
+
+#ifdef SHA_X86
+  /**
+   * @brief  8つのメッセージのブロックをAVX2で1つずつ同時に圧縮する
+   * @param  std::uint32_t* S             8レーン分のハッシュ値(S[i * 8 + lane])
+   * @param  const std::uint8_t* const* blocks 各レーンのブロックの先頭
+   * @note   定義はsha256_mb.hppにある
+   */
+  static void compress_x8_avx2(std::uint32_t *S,
+                               const std::uint8_t *const *blocks);
+
+  /**
+   * @brief  16のメッセージのブロックをAVX-512で1つずつ同時に圧縮する
+   * @note   定義はsha256_mb.hppにある
+   */
+  static void compress_x16_avx512(std::uint32_t *S,
+                                  const std::uint8_t *const *blocks);
 #endif
+
+private:
+  /**< @brief 選択されたバックエンドとその圧縮関数 */
+  struct Dispatcher {
+    Backend backend;
+    compress_fn compress;
+  };
+
+  static Dispatcher &dispatcher() {
+    static Dispatcher d = [] {
+      Backend b;
+      if (!requested_backend(b) || !supports(b)) {
+        b = supports(Backend::SHANI) ? Backend::SHANI
+            : supports(Backend::AVX2) ? Backend::AVX2
+                                      : Backend::Scalar;
+      }
+      statistics.select(b);
+      return Dispatcher{b, select(b)};
+    }();
+    return d;
+  }
+
+  static compress_fn select(Backend b) {
+#ifdef SHA_X86
+    if (b == Backend::SHANI) {
+      return compress_shani;
     }
+    if (b == Backend::AVX2) {
+      return compress_avx2;
+    }
+#endif
+    static_cast<void>(b);
+    return compress_scalar;
+  }
 
-    // 最終的なハッシュ値を返す
-    std::vector<std::uint8_t> M(32); // 8 * 32 = 256-bits
+#ifdef SHA_X86
+  /**
+   * @brief  SHA extensionsを用いてn個のブロックを圧縮する
+   * @note   定義はsha256_shani.hppにある
+   */
+  static void compress_shani(std::uint32_t *H, const std::uint8_t *blocks,
+                             std::size_t n);
+
+  /**
+   * @brief  AVX2でmessage scheduleを、BMI2(rorx)でラウンドを計算する
+   * @note   定義はsha256_avx2.hppにある
+   */
+  static void compress_avx2(std::uint32_t *H, const std::uint8_t *blocks,
+                            std::size_t n);
+
+  /**
+   * @brief  SHA extensionsを用いて、Kt + Wtが既知のブロックを1つ圧縮する
+   * @note   定義はsha256_shani.hppにある
+   */
+  static void compress_kw_shani(std::uint32_t *H, const std::uint32_t *KW);
+#endif
+
+  /**
+   * @brief  512-bitのブロックをn個圧縮し、ハッシュ値を更新する
+   * @param  std::uint32_t* H            ハッシュ値 H0, H1, ..., H7
+   * @param  const std::uint8_t* blocks 64byteのブロックが連続した領域の先頭
+   * @param  std::size_t n              ブロックの個数
+   */
+  static void compress_scalar(std::uint32_t *H, const std::uint8_t *blocks,
+                              std::size_t n) {
+    for (; n > 0; n--, blocks += block_size) {
+      compress_block(H, blocks);
+    }
+  }
+
+  /**
+   * @brief  512-bitのブロックを1つ圧縮し、ハッシュ値を更新する
+   * @param  std::uint32_t* H           ハッシュ値 H0, H1, ..., H7
+   * @param  const std::uint8_t* block 64byteのブロックの先頭
+   */
+  static constexpr void compress_block(std::uint32_t *H,
+                                       const std::uint8_t *block) {
+    // message schedule: 直近の16 words(Wtは W[t % 16])
+    std::uint32_t W[16] = {};
+
+    // 8つの変数a, b, c, d, e, f, g, hを(i - 1)st hash valueで初期化する
+    std::uint32_t v[8] = {};
     for (std::size_t i = 0; i < 8; i++) {
+      v[i] = H[i];
+    }
+
+    // Main Loop: 64ラウンドをコンパイル時に展開する
+    unroll<0, 64>([&](auto t) {
+      constexpr std::size_t i = decltype(t)::value;
+      round<i>(v, K[i] + schedule<i>(W, block));
+    });
 
-      const std::size_t base = i * 4;
-      M[base + 0] = static_cast<std::uint8_t>(H[i] >> 24);
-      M[base + 1] = static_cast<std::uint8_t>(H[i] >> 16);
-      M[base + 2] = static_cast<std::uint8_t>(H[i] >> 8);
-      M[base + 3] = static_cast<std::uint8_t>(H[i]);
+    // ハッシュ値の更新(64ラウンドで変数の役割は一巡している)
+    for (std::size_t i = 0; i < 8; i++) {
+      H[i] += v[i];
     }
+  }
 
-    return M;
+  /**
+   * @brief  message scheduleのWtを求める
+   * @param  std::uint32_t* W 直近の16 words(Wtを W[t % 16]に上書きする)
+   * @note   0 <= t <= 15 はメッセージの32-bit words、16 <= t <= 63 は
+   *         使い終わった W{t-16} の位置に計算する
+   */
+  template <std::size_t t>
+  static constexpr std::uint32_t schedule(std::uint32_t *W,
+                                          const std::uint8_t *block) {
+    if constexpr (t < 16) {
+      W[t] = load_be32(block + t * 4);
+      return W[t];
+    } else {
+      return expand<t>(W);
+    }
+  }
+
+  /**
+   * @brief  16 <= t <= 63 のWtを、直近の16 wordsから計算する
+   */
+  template <std::size_t t>
+  __attribute__((always_inline)) static constexpr std::uint32_t
+  expand(std::uint32_t *W) {
+    static_assert(16 <= t && t < 64);
+    W[t % 16] += small_sigma1(W[(t - 2) % 16]) + W[(t - 7) % 16] +
+                 small_sigma0(W[(t - 15) % 16]);
+    return W[t % 16];
+  }
+
+  /**
+   * @brief  message scheduleの先頭16 wordsからブロックを1つ圧縮する
+   * @param  std::uint32_t* W W0, ..., W15(作業領域として上書きする)
+   * @note   ハッシュ値をbyte列に戻さずに次のメッセージとする場合に使う
+   */
+  static void compress_words(std::uint32_t *H, std::uint32_t *W) {
+    std::uint32_t v[8];
+    std::copy(H, H + 8, v);
+    unroll<0, 64>([&](auto t) {
+      constexpr std::size_t i = decltype(t)::value;
+      if constexpr (i < 16) {
+        round<i>(v, K[i] + W[i]);
+      } else {
+        round<i>(v, K[i] + expand<i>(W));
+      }
+    });
+    for (std::size_t i = 0; i < 8; i++) {
+      H[i] += v[i];
+    }
+  }
+
+  /**
+   * @brief  Kt + Wtが既知のブロックを1つ圧縮する(message scheduleを省く)
+   */
+  static void compress_kw_scalar(std::uint32_t *H, const std::uint32_t *KW) {
+    std::uint32_t v[8];
+    std::copy(H, H + 8, v);
+    unroll<0, 64>([&](auto t) {
+      constexpr std::size_t i = decltype(t)::value;
+      round<i>(v, KW[i]);
+    });
+    for (std::size_t i = 0; i < 8; i++) {
+      H[i] += v[i];
+    }
+  }
+
+  /**
+   * @brief  パディングだけのブロック(0x80, 0, ..., ビット長)のKt + Wtを求める
+   * @param  std::uint64_t bits メッセージのビット長
+   */
+  static constexpr std::array<std::uint32_t, 64>
+  padding_schedule(std::uint64_t bits) {
+    std::uint32_t W[16] = {0x80000000};
+    W[14] = static_cast<std::uint32_t>(bits >> 32);
+    W[15] = static_cast<std::uint32_t>(bits);
+    std::array<std::uint32_t, 64> KW{};
+    for (std::size_t t = 0; t < 64; t++) {
+      if (t >= 16) {
+        W[t % 16] += small_sigma1(W[(t - 2) % 16]) + W[(t - 7) % 16] +
+                     small_sigma0(W[(t - 15) % 16]);
+      }
+      KW[t] = K[t] + W[t % 16];
+    }
+    return KW;
+  }
+
+  /**< @brief 64byteのメッセージに続くパディングのブロックのKt + Wt */
+  static const std::array<std::uint32_t, 64> KW64;
+
+  /**
+   * @brief  Kt + Wtが既知のブロックを、選択されたバックエンドで圧縮する
+   */
+  static void compress_kw(std::uint32_t *H, const std::uint32_t *KW);
+
+  /**
+   * @brief  64byteのメッセージのSHA256を、ハッシュ値のwordとして求める
+   */
+  static void hash_64_words(const std::uint8_t *data, std::uint32_t *H);
+
+  /**
+   * @brief  ハッシュ値のword(32byte)をメッセージとするSHA256を求める
+   */
+  static void hash_32_words(const std::uint32_t *in, std::uint32_t *H);
+
+  /**
+   * @brief  hash_64_many()とhash_d64_many()の本体
+   * @param  bool twice SHA256(SHA256(data))を求めるか
+   */
+  static void hash_fixed_many(std::size_t n, const void *data, digest_type *M,
+                              bool twice);
+
+  /**
+   * @brief  ナンスのwordがk, k + 1番目のとき、各Wtがナンスに依存するか
+   */
+  static constexpr std::array<bool, 64> nonce_dependency(std::size_t k) {
+    std::array<bool, 64> d{};
+    for (std::size_t t = 0; t < 64; t++) {
+      d[t] = t < 16 ? t == k || t == k + 1
+                    : d[t - 2] || d[t - 7] || d[t - 15] || d[t - 16];
+    }
+    return d;
+  }
+
+  /**
+   * @brief  ナンスを含む最初のwordがkのときのcompress_nonce()
+   * @note   依存するWtとラウンドをコンパイル時に選ぶため、kごとに展開する
+   */
+  template <std::size_t k>
+  static void compress_nonce_at(const NonceSchedule &s, std::uint32_t w0,
+                                std::uint32_t w1, std::uint32_t *H);
+
+  using compress_nonce_fn = void (*)(const NonceSchedule &, std::uint32_t,
+                                     std::uint32_t, std::uint32_t *);
+
+  /**
+   * @brief  compress_nonce_at<0>, ..., compress_nonce_at<15>の表
+   */
+  template <std::size_t... k>
+  static constexpr std::array<compress_nonce_fn, 16>
+  nonce_kernels(std::index_sequence<k...>) {
+    return {{compress_nonce_at<k>...}};
+  }
+
+  /**
+   * @brief  t番目のラウンドを計算する
+   * @param  std::uint32_t* v  変数(ラウンドtでは、k番目の変数がv[(k - t) mod 8])
+   * @param  std::uint32_t wk Kt + Wt
+   * @note   h = g; g = f; ...と値を移す代わりに変数の役割を1つずらすので、
+   *         書き込むのは新しいeとaになるv[d], v[h]の2つだけ
+   *         展開したループに関数呼び出しが残らないよう、必ずインライン展開する
+   */
+  template <std::size_t t>
+  __attribute__((always_inline)) static constexpr void
+  round(std::uint32_t *v, std::uint32_t wk) {
+    constexpr auto r = [](std::size_t k) { return (k + 8 - t % 8) % 8; };
+    const std::uint32_t T1 = v[r(7)] + big_sigma1(v[r(4)]) +
+                             ch(v[r(4)], v[r(5)], v[r(6)]) + wk;
+    const std::uint32_t T2 =
+        big_sigma0(v[r(0)]) + maj(v[r(0)], v[r(1)], v[r(2)]);
+    v[r(3)] += T1;
+    v[r(7)] = T1 + T2;
   }
 
-private:
   /**
    * @brief
    * 入力メッセージMに対し、メッセージ長が512-bitの倍数になるように、Mの末尾に以下のようなパディングを施す
@@ -157,41 +847,49 @@ private:
    *                                         ~ 423 ~  ~   64   ~
    *        01100001  01100010  01100011  1  00...00  00...011000
    *        a         b         c                          l = 24
+   *
+   * @note  メッセージ全体はコピーせず、バッファに残った最終ブロックにのみパディングを施して圧縮する
    */
-  std::vector<std::uint8_t>
-  padding(const std::vector<std::uint8_t> &msg) const {
-    // パディングすべき大きさを計算する
-    const std::size_t msglen = msg.size();
-    std::size_t padlen = 64 - (msglen % 64);
+  void padding() {
+    // 0b10000000を付加
+    buffer[buflen++] = 0b10000000;
 
-    // 余裕がなければ拡張
-    if (padlen < 9) {
-      padlen += 64;
+    // メッセージ長を書き込む余裕がなければ、もう1ブロック圧縮する
+    if (buflen > block_size - 8) {
+      zero_fill(block_size);
+      compress(H.data(), buffer.data(), 1);
+      buflen = 0;
     }
+    zero_fill(block_size - 8);
 
-    // パディングされたメッセージを格納するための変数を用意
-    const std::size_t padded_len = msglen + padlen;
-    std::vector<std::uint8_t> padded_msg(padded_len,
-                                         0x00); // まずここで0で埋めてしまう
-    std::copy(msg.cbegin(), msg.cend(), padded_msg.begin());
-
-    // 0b10000000を付加
-    padded_msg[msglen] = 0b10000000;
+    // メッセージ長を64-bitのビット数として付加する
+    store_be64(buffer.data() + block_size - 8, msglen * 8);
+    compress(H.data(), buffer.data(), 1);
+    buflen = 0;
+  }
 
-    // メッセージ長を付加
-    padded_msg[padded_len - 4] = static_cast<std::uint8_t>((msglen * 8) >> 24);
-    padded_msg[padded_len - 3] = static_cast<std::uint8_t>((msglen * 8) >> 16);
-    padded_msg[padded_len - 2] = static_cast<std::uint8_t>((msglen * 8) >> 8);
-    padded_msg[padded_len - 1] = static_cast<std::uint8_t>((msglen * 8));
+  /**
+   * @brief  byte列をバッファの末尾に追加する
+   */
+  void append(const std::uint8_t *p, std::size_t n) {
+    StatsTimer<> timer(statistics, &HashStats::copy_ticks);
+    std::copy(p, p + n, buffer.begin() + buflen);
+    buflen += n;
+  }
 
-    return padded_msg;
+  /**
+   * @brief  バッファのbuflenからendまでを0で埋める(パディング)
+   */
+  void zero_fill(std::size_t end) {
+    StatsTimer<> timer(statistics, &HashStats::copy_ticks);
+    std::fill(buffer.begin() + buflen, buffer.begin() + end, 0x00);
   }
 
   /**
    * @brief SHA256で使用する関数Σ{256}0(x)
    * @note  仕様書の式(4.4)に相当
    */
-  constexpr std::uint32_t big_sigma0(std::uint32_t x) const {
+  static constexpr std::uint32_t big_sigma0(std::uint32_t x) {
     return rotr(x, 2) ^ rotr(x, 13) ^ rotr(x, 22);
   }
 
@@ -199,7 +897,7 @@ private:
    * @brief SHA256で使用する関数Σ{256}1(x)
    * @note  仕様書の式(4.5)に相当
    */
-  constexpr std::uint32_t big_sigma1(std::uint32_t x) const {
+  static constexpr std::uint32_t big_sigma1(std::uint32_t x) {
     return rotr(x, 6) ^ rotr(x, 11) ^ rotr(x, 25);
   }
 
@@ -207,7 +905,7 @@ private:
    * @brief SHA256で使用する関数σ{256}0(x)
    * @note  仕様書の式(4.6)に相当
    */
-  constexpr std::uint32_t small_sigma0(std::uint32_t x) const {
+  static constexpr std::uint32_t small_sigma0(std::uint32_t x) {
     return rotr(x, 7) ^ rotr(x, 18) ^ (x >> 3);
   }
 
@@ -215,7 +913,7 @@ private:
    * @brief SHA256で使用する関数σ{256}1(x)
    * @note  仕様書の式(4.7)に相当
    */
-  constexpr std::uint32_t small_sigma1(std::uint32_t x) const {
+  static constexpr std::uint32_t small_sigma1(std::uint32_t x) {
     return rotr(x, 17) ^ rotr(x, 19) ^ (x >> 10);
   }
 
@@ -238,6 +936,47 @@ private:
       0x682e6ff3, 0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
       0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
   };
+
+  /**< @brief ハッシュ値(chaining state) H0, H1, ..., H7 */
+  std::array<std::uint32_t, 8> H;
+
+  /**< @brief 1ブロックに満たないメッセージの端数を保持するバッファ */
+  std::array<std::uint8_t, block_size> buffer;
+
+  /**< @brief バッファに保持しているbyte数 */
+  std::size_t buflen;
+
+  /**< @brief これまでに取り込んだメッセージ長(byte) */
+  std::uint64_t msglen;
+
+  /**< @brief 統計(無効なときは何も記録しない) */
+  inline static HashStats statistics{"sha256"};
+  inline static const bool registered =
+      stats_enabled && stats_register(statistics);
 };
 
+static_assert(std::is_trivially_copyable_v<SHA256::state_type>);
+static_assert(std::is_trivially_copyable_v<SHA256>);
+
+/**
+ * @brief  コンパイル時にも評価できるSHA256
+ * @note   例: constexpr auto d = sha256("abc");
+ */
+constexpr SHA256::digest_type sha256(std::string_view msg) {
+  return SHA256::hash_constexpr(msg.data(), msg.size());
+}
+
+template <std::size_t N>
+constexpr SHA256::digest_type sha256(const std::array<std::uint8_t, N> &msg) {
+  return SHA256::hash_constexpr(msg.data(), N);
+}
+
+#ifdef SHA_X86
+#include "sha256_mb.hpp"
+#include "sha256_avx2.hpp"
+#include "sha256_shani.hpp"
+#endif
+#include "sha256_fixed.hpp"
+#include "sha256_nonce.hpp"
+
 #endif // end of SHA256_H
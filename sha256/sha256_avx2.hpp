@@ -0,0 +1,105 @@
+/**
+ * @brief AVX2/BMI2によるSHA256の圧縮関数(単一メッセージ)
+ * @note  sha256.hppからincludeされる
+ *        SHA-NIのないCPU向けに、message scheduleだけをベクトル化する
+ */
+
+#ifndef SHA256_AVX2_HPP
+#define SHA256_AVX2_HPP
+
+#include "sha256.hpp"
+#include "sha256_mb.hpp"
+
+/**
+ * @brief 4つの32-bit wordにσ0, σ1を施す(128-bitレーンごと)
+ * @note  回転はsha256_mb.hppのmm256_rotr_epi32を使う
+ */
+template <int R1, int R2, int S>
+__attribute__((target("avx2"))) inline __m256i sha256_avx2_sigma(__m256i x) {
+  return _mm256_xor_si256(
+      _mm256_xor_si256(mm256_rotr_epi32<R1>(x), mm256_rotr_epi32<R2>(x)),
+      _mm256_srli_epi32(x, S));
+}
+
+/**
+ * @note  2つのブロックをYMMレジスタの下位/上位128-bitに1つずつ載せ、
+ *        message scheduleを4 wordsずつ同時に計算してW + Kを書き出す
+ *        ラウンドはスカラーで計算し、rotrはBMI2のrorxとして展開される
+ *        ブロック数が奇数のときは、最後のブロックを上位にも複製して結果を捨てる
+ */
+__attribute__((target("avx2,bmi2"))) inline void
+SHA256::compress_avx2(std::uint32_t *H, const std::uint8_t *blocks,
+                      std::size_t n) {
+  // 各32-bit word内のbyte順を反転させ、ビッグエンディアンとして読み込むためのマスク
+  const __m256i MASK = _mm256_broadcastsi128_si256(
+      _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL));
+  const __m256i zero = _mm256_setzero_si256();
+
+  // 2ブロック分のW[t] + K[t]
+  alignas(32) std::uint32_t WK[2][64];
+
+  while (n > 0) {
+    const std::uint8_t *lo = blocks;
+    const std::uint8_t *hi = n > 1 ? blocks + block_size : blocks;
+
+    // W[4i], ..., W[4i + 3]を保持するリングバッファ
+    __m256i X[4];
+
+    for (std::size_t i = 0; i < 16; i++) {
+      if (i < 4) {
+        // 0 <= t <= 15 : メッセージをそのまま読み込む
+        const __m128i x0 =
+            _mm_loadu_si128(reinterpret_cast<const __m128i *>(lo + i * 16));
+        const __m128i x1 =
+            _mm_loadu_si128(reinterpret_cast<const __m128i *>(hi + i * 16));
+        X[i] = _mm256_shuffle_epi8(
+            _mm256_inserti128_si256(_mm256_castsi128_si256(x0), x1, 1), MASK);
+      } else {
+        // 16 <= t <= 63 : W[t - 16] + σ0(W[t - 15]) + W[t - 7]を4 words分求める
+        const __m256i &X0 = X[i % 4];
+        const __m256i &X1 = X[(i + 1) % 4];
+        const __m256i &X2 = X[(i + 2) % 4];
+        const __m256i &X3 = X[(i + 3) % 4];
+        const __m256i w15 = _mm256_alignr_epi8(X1, X0, 4);
+        const __m256i w7 = _mm256_alignr_epi8(X3, X2, 4);
+        __m256i w = _mm256_add_epi32(
+            _mm256_add_epi32(X0, sha256_avx2_sigma<7, 18, 3>(w15)), w7);
+
+        // σ1(W[t - 2])は直前に求めたwordに依存するので、2 wordsずつ加える
+        const __m256i s1lo =
+            sha256_avx2_sigma<17, 19, 10>(_mm256_shuffle_epi32(X3, 0xee));
+        w = _mm256_add_epi32(w, _mm256_blend_epi32(zero, s1lo, 0x33));
+        const __m256i s1hi =
+            sha256_avx2_sigma<17, 19, 10>(_mm256_shuffle_epi32(w, 0x40));
+        X[i % 4] = _mm256_add_epi32(w, _mm256_blend_epi32(zero, s1hi, 0xcc));
+      }
+
+      const __m256i wk = _mm256_add_epi32(
+          X[i % 4], _mm256_broadcastsi128_si256(_mm_loadu_si128(
+                        reinterpret_cast<const __m128i *>(&K[i * 4]))));
+      _mm_store_si128(reinterpret_cast<__m128i *>(&WK[0][i * 4]),
+                      _mm256_castsi256_si128(wk));
+      _mm_store_si128(reinterpret_cast<__m128i *>(&WK[1][i * 4]),
+                      _mm256_extracti128_si256(wk, 1));
+    }
+
+    const std::size_t m = n > 1 ? 2 : 1;
+    for (std::size_t j = 0; j < m; j++) {
+      std::uint32_t v[8] = {H[0], H[1], H[2], H[3], H[4], H[5], H[6], H[7]};
+      unroll<0, 64>([&](auto t) {
+        constexpr std::size_t i = decltype(t)::value;
+        round<i>(v, WK[j][i]);
+      });
+
+      // ハッシュ値の更新
+      for (std::size_t i = 0; i < 8; i++) {
+        H[i] += v[i];
+      }
+    }
+
+    blocks += m * block_size;
+    n -= m;
+  }
+}
+
+#endif // end of SHA256_AVX2_HPP
@@ -0,0 +1,213 @@
+/**
+ * @brief 長さが固定のメッセージ(32byte, 64byte)に特化したSHA256とdouble-SHA256
+ * @note  sha256.hppからincludeされる
+ *        Merkle木の節はダイジェスト2つの連結(64byte)、double-SHA256の外側は
+ *        ダイジェスト1つ(32byte)をハッシュ化する。どちらも最終ブロックの
+ *        パディングが定数なので、その分のmessage scheduleを事前に計算しておく
+ *          64byte: 2つ目のブロックはパディングだけで、Kt + Wtが全て定数
+ *          32byte: W8, ..., W15が定数で、W0, ..., W7は内側のハッシュ値そのもの
+ */
+
+#ifndef SHA256_FIXED_HPP
+#define SHA256_FIXED_HPP
+
+#include "sha256.hpp"
+
+inline constexpr std::array<std::uint32_t, 64> SHA256::KW64 =
+    SHA256::padding_schedule(512);
+
+inline void SHA256::compress_kw(std::uint32_t *H, const std::uint32_t *KW) {
+#ifdef SHA_X86
+  if (backend() == Backend::SHANI) {
+    compress_kw_shani(H, KW);
+    statistics.add_blocks(Backend::SHANI, 1);
+    return;
+  }
+#endif
+  compress_kw_scalar(H, KW);
+  statistics.add_blocks(Backend::Scalar, 1);
+}
+
+inline void SHA256::hash_64_words(const std::uint8_t *data, std::uint32_t *H) {
+  statistics.add(statistics.bytes, 64);
+  std::copy(IV.begin(), IV.end(), H);
+  compress(H, data, 1);
+  compress_kw(H, KW64.data());
+}
+
+inline void SHA256::hash_32_words(const std::uint32_t *in, std::uint32_t *H) {
+  statistics.add(statistics.bytes, 32);
+  std::copy(IV.begin(), IV.end(), H);
+  if (backend() == Backend::SHANI) {
+    // SHA extensionsはbyte列から読み込むほうが速い
+    std::uint8_t block[block_size] = {};
+    for (std::size_t i = 0; i < 8; i++) {
+      store_be32(block + i * 4, in[i]);
+    }
+    block[32] = 0b10000000;
+    store_be64(block + block_size - 8, 32 * 8);
+    compress(H, block, 1);
+    return;
+  }
+  std::uint32_t W[16] = {};
+  std::copy(in, in + 8, W);
+  W[8] = 0x80000000;
+  W[15] = 32 * 8;
+  compress_words(H, W);
+  statistics.add_blocks(Backend::Scalar, 1);
+}
+
+inline SHA256::digest_type SHA256::hash_64(const void *data) {
+  std::uint32_t H[8];
+  hash_64_words(static_cast<const std::uint8_t *>(data), H);
+  digest_type M;
+  for (std::size_t i = 0; i < 8; i++) {
+    store_be32(&M[i * 4], H[i]);
+  }
+  return M;
+}
+
+inline SHA256::digest_type SHA256::hash_d(const void *data, std::size_t len) {
+  SHA256 ctx;
+  ctx.update(data, len);
+  ctx.padding();
+  std::uint32_t H[8];
+  hash_32_words(ctx.H.data(), H);
+  digest_type M;
+  for (std::size_t i = 0; i < 8; i++) {
+    store_be32(&M[i * 4], H[i]);
+  }
+  return M;
+}
+
+inline SHA256::digest_type SHA256::hash_d64(const void *data) {
+  std::uint32_t inner[8];
+  hash_64_words(static_cast<const std::uint8_t *>(data), inner);
+  std::uint32_t H[8];
+  hash_32_words(inner, H);
+  digest_type M;
+  for (std::size_t i = 0; i < 8; i++) {
+    store_be32(&M[i * 4], H[i]);
+  }
+  return M;
+}
+
+inline void SHA256::hash_64_many(std::size_t n, const void *data,
+                                 digest_type *M) {
+  hash_fixed_many(n, data, M, false);
+}
+
+inline void SHA256::hash_d64_many(std::size_t n, const void *data,
+                                  digest_type *M) {
+  hash_fixed_many(n, data, M, true);
+}
+
+inline void SHA256::hash_fixed_many(std::size_t n, const void *data,
+                                    digest_type *M, bool twice) {
+  // 64byteのメッセージに続くパディングのブロック
+  static constexpr std::array<std::uint8_t, block_size> pad64 = [] {
+    std::array<std::uint8_t, block_size> b{};
+    b[0] = 0b10000000;
+    store_be64(b.data() + block_size - 8, 64 * 8);
+    return b;
+  }();
+
+  const auto *p = static_cast<const std::uint8_t *>(data);
+  alignas(64) std::uint32_t S[8 * max_lanes];
+  const std::uint8_t *ptr[max_lanes];
+  std::uint8_t outer[max_lanes][block_size];
+
+  for (std::size_t first = 0; first < n;) {
+    // レーンを埋められなければ、残りは1つずつ計算する
+    const BatchKernel kernel = batch_kernel(n - first);
+    if (kernel.lanes == 1) {
+      for (; first < n; first++) {
+        M[first] = twice ? hash_d64(p + first * 64) : hash_64(p + first * 64);
+      }
+      return;
+    }
+
+    const std::size_t L = kernel.lanes;
+    const std::size_t m = std::min(L, n - first);
+    const auto reset = [&] {
+      for (std::size_t w = 0; w < 8; w++) {
+        std::fill(S + w * L, S + (w + 1) * L, IV[w]);
+      }
+    };
+
+    // 空きレーンは最後のメッセージを重ねて計算し、結果を捨てる
+    reset();
+    for (std::size_t j = 0; j < L; j++) {
+      ptr[j] = p + (first + std::min(j, m - 1)) * 64;
+    }
+    kernel.compress(S, ptr);
+    std::fill(ptr, ptr + L, pad64.data());
+    kernel.compress(S, ptr);
+
+    if (twice) {
+      // 内側のハッシュ値 || 0x80 || 0 ... || 256
+      for (std::size_t j = 0; j < L; j++) {
+        std::fill(outer[j] + 32, outer[j] + block_size, 0x00);
+        for (std::size_t w = 0; w < 8; w++) {
+          store_be32(outer[j] + w * 4, S[w * L + j]);
+        }
+        outer[j][32] = 0b10000000;
+        store_be64(outer[j] + block_size - 8, 32 * 8);
+        ptr[j] = outer[j];
+      }
+      reset();
+      kernel.compress(S, ptr);
+    }
+
+    for (std::size_t j = 0; j < m; j++) {
+      for (std::size_t w = 0; w < 8; w++) {
+        store_be32(&M[first + j][w * 4], S[w * L + j]);
+      }
+    }
+    statistics.add(statistics.bytes, m * (twice ? 96 : 64));
+    statistics.add_blocks(batch_backend(), L * (twice ? 3 : 2));
+    first += m;
+  }
+}
+
+/**
+ * @brief  ちょうど64byteのメッセージのSHA256
+ * @note   例: Merkle木の節 sha256_64(left || right)
+ */
+inline SHA256::digest_type sha256_64(const void *data) {
+  return SHA256::hash_64(data);
+}
+
+/**
+ * @brief  SHA256(SHA256(data))
+ */
+inline SHA256::digest_type sha256d(const void *data, std::size_t len) {
+  return SHA256::hash_d(data, len);
+}
+
+/**
+ * @brief  ちょうど64byteのメッセージのSHA256(SHA256(data))
+ */
+inline SHA256::digest_type sha256d_64(const void *data) {
+  return SHA256::hash_d64(data);
+}
+
+/**
+ * @brief  64byteのメッセージn個のSHA256をまとめて計算する
+ * @note   例: Merkle木の1段(ダイジェスト2n個)から上の段(n個)を求める
+ *         sha256_64_many(n, level.data(), parent.data())
+ */
+inline void sha256_64_many(std::size_t n, const void *data,
+                           SHA256::digest_type *M) {
+  SHA256::hash_64_many(n, data, M);
+}
+
+/**
+ * @brief  64byteのメッセージn個のSHA256(SHA256(data))をまとめて計算する
+ */
+inline void sha256d_64_many(std::size_t n, const void *data,
+                            SHA256::digest_type *M) {
+  SHA256::hash_d64_many(n, data, M);
+}
+
+#endif // end of SHA256_FIXED_HPP
@@ -0,0 +1,186 @@
+/**
+ * @brief AVX2/AVX-512によるSHA256の複数メッセージ同時圧縮(multi-buffer)
+ * @note  sha256.hppからincludeされる
+ *        各レーンが別々のメッセージを受け持ち、ラウンド関数をベクトル演算で計算する
+ */
+
+#ifndef SHA256_MB_HPP
+#define SHA256_MB_HPP
+
+#include "sha256.hpp"
+
+/**
+ * @brief 8レーンの32-bit wordを一斉に右ローテーションする
+ * @note  AVX2には回転命令がないので、2つのシフトとORで代用する
+ */
+template <int N>
+__attribute__((target("avx2"))) inline __m256i mm256_rotr_epi32(__m256i x) {
+  return _mm256_or_si256(_mm256_srli_epi32(x, N), _mm256_slli_epi32(x, 32 - N));
+}
+
+/**
+ * @brief 16レーンの32-bit wordを一斉に右ローテーション/右シフトする
+ * @note  GCC 12では_mm512_ror_epi32などが未初期化変数の誤検知を起こすので、
+ *        全レーン有効のマスク付き命令で代用する(生成される命令は同じ)
+ */
+template <int N>
+__attribute__((target("avx512f"))) inline __m512i mm512_ror_epi32(__m512i x) {
+  return _mm512_maskz_ror_epi32(0xffff, x, N);
+}
+
+template <int N>
+__attribute__((target("avx512f"))) inline __m512i mm512_srli_epi32(__m512i x) {
+  return _mm512_maskz_srli_epi32(0xffff, x, N);
+}
+
+/**
+ * @note  message scheduleはW[t][lane]の配置(SoA)に転置してから読み込む
+ */
+__attribute__((target("avx2"))) inline void
+SHA256::compress_x8_avx2(std::uint32_t *S, const std::uint8_t *const *blocks) {
+  constexpr std::size_t L = 8;
+
+  // 8つのブロックを転置し、W[t]の8レーン分を1つのレジスタで扱えるようにする
+  alignas(32) std::uint32_t X[16 * L];
+  for (std::size_t t = 0; t < 16; t++) {
+    for (std::size_t l = 0; l < L; l++) {
+      X[t * L + l] = load_be32(blocks[l] + t * 4);
+    }
+  }
+
+  __m256i v[8];
+  for (std::size_t i = 0; i < 8; i++) {
+    v[i] = _mm256_load_si256(reinterpret_cast<const __m256i *>(S + i * L));
+  }
+  __m256i a = v[0], b = v[1], c = v[2], d = v[3];
+  __m256i e = v[4], f = v[5], g = v[6], h = v[7];
+
+  // W[t - 16], ..., W[t - 1]を保持するリングバッファ
+  __m256i W[16];
+
+  for (std::size_t t = 0; t < 64; t++) {
+    if (t < 16) {
+      W[t] = _mm256_load_si256(reinterpret_cast<const __m256i *>(X + t * L));
+    } else {
+      const __m256i w2 = W[(t - 2) % 16];
+      const __m256i w15 = W[(t - 15) % 16];
+      const __m256i s1 =
+          _mm256_xor_si256(_mm256_xor_si256(mm256_rotr_epi32<17>(w2),
+                                            mm256_rotr_epi32<19>(w2)),
+                           _mm256_srli_epi32(w2, 10));
+      const __m256i s0 =
+          _mm256_xor_si256(_mm256_xor_si256(mm256_rotr_epi32<7>(w15),
+                                            mm256_rotr_epi32<18>(w15)),
+                           _mm256_srli_epi32(w15, 3));
+      W[t % 16] = _mm256_add_epi32(_mm256_add_epi32(s1, W[(t - 7) % 16]),
+                                   _mm256_add_epi32(s0, W[t % 16]));
+    }
+
+    const __m256i S1 = _mm256_xor_si256(
+        _mm256_xor_si256(mm256_rotr_epi32<6>(e), mm256_rotr_epi32<11>(e)),
+        mm256_rotr_epi32<25>(e));
+    const __m256i CH = _mm256_xor_si256(_mm256_and_si256(e, f),
+                                        _mm256_andnot_si256(e, g));
+    const __m256i T1 = _mm256_add_epi32(
+        _mm256_add_epi32(_mm256_add_epi32(h, S1), CH),
+        _mm256_add_epi32(_mm256_set1_epi32(static_cast<int>(K[t])),
+                         W[t % 16]));
+    const __m256i S0 = _mm256_xor_si256(
+        _mm256_xor_si256(mm256_rotr_epi32<2>(a), mm256_rotr_epi32<13>(a)),
+        mm256_rotr_epi32<22>(a));
+    const __m256i MAJ = _mm256_or_si256(
+        _mm256_and_si256(a, b), _mm256_and_si256(c, _mm256_or_si256(a, b)));
+    const __m256i T2 = _mm256_add_epi32(S0, MAJ);
+
+    h = g;
+    g = f;
+    f = e;
+    e = _mm256_add_epi32(d, T1);
+    d = c;
+    c = b;
+    b = a;
+    a = _mm256_add_epi32(T1, T2);
+  }
+
+  // ハッシュ値の更新
+  const __m256i r[8] = {a, b, c, d, e, f, g, h};
+  for (std::size_t i = 0; i < 8; i++) {
+    _mm256_store_si256(reinterpret_cast<__m256i *>(S + i * L),
+                       _mm256_add_epi32(v[i], r[i]));
+  }
+}
+
+/**
+ * @note  AVX-512では回転命令(vprord)と3入力論理演算(vpternlogd)でCh, Majを1命令にする
+ */
+__attribute__((target("avx512f"))) inline void
+SHA256::compress_x16_avx512(std::uint32_t *S,
+                            const std::uint8_t *const *blocks) {
+  constexpr std::size_t L = 16;
+
+  // 16のブロックを転置し、W[t]の16レーン分を1つのレジスタで扱えるようにする
+  alignas(64) std::uint32_t X[16 * L];
+  for (std::size_t t = 0; t < 16; t++) {
+    for (std::size_t l = 0; l < L; l++) {
+      X[t * L + l] = load_be32(blocks[l] + t * 4);
+    }
+  }
+
+  __m512i v[8];
+  for (std::size_t i = 0; i < 8; i++) {
+    v[i] = _mm512_load_si512(S + i * L);
+  }
+  __m512i a = v[0], b = v[1], c = v[2], d = v[3];
+  __m512i e = v[4], f = v[5], g = v[6], h = v[7];
+
+  // W[t - 16], ..., W[t - 1]を保持するリングバッファ
+  __m512i W[16];
+
+  for (std::size_t t = 0; t < 64; t++) {
+    if (t < 16) {
+      W[t] = _mm512_load_si512(X + t * L);
+    } else {
+      const __m512i w2 = W[(t - 2) % 16];
+      const __m512i w15 = W[(t - 15) % 16];
+      const __m512i s1 = _mm512_ternarylogic_epi32(
+          mm512_ror_epi32<17>(w2), mm512_ror_epi32<19>(w2),
+          mm512_srli_epi32<10>(w2), 0x96);
+      const __m512i s0 = _mm512_ternarylogic_epi32(
+          mm512_ror_epi32<7>(w15), mm512_ror_epi32<18>(w15),
+          mm512_srli_epi32<3>(w15), 0x96);
+      W[t % 16] = _mm512_add_epi32(_mm512_add_epi32(s1, W[(t - 7) % 16]),
+                                   _mm512_add_epi32(s0, W[t % 16]));
+    }
+
+    const __m512i S1 =
+        _mm512_ternarylogic_epi32(mm512_ror_epi32<6>(e), mm512_ror_epi32<11>(e),
+                                  mm512_ror_epi32<25>(e), 0x96);
+    const __m512i CH = _mm512_ternarylogic_epi32(e, f, g, 0xca);
+    const __m512i T1 = _mm512_add_epi32(
+        _mm512_add_epi32(_mm512_add_epi32(h, S1), CH),
+        _mm512_add_epi32(_mm512_set1_epi32(static_cast<int>(K[t])),
+                         W[t % 16]));
+    const __m512i S0 =
+        _mm512_ternarylogic_epi32(mm512_ror_epi32<2>(a), mm512_ror_epi32<13>(a),
+                                  mm512_ror_epi32<22>(a), 0x96);
+    const __m512i MAJ = _mm512_ternarylogic_epi32(a, b, c, 0xe8);
+    const __m512i T2 = _mm512_add_epi32(S0, MAJ);
+
+    h = g;
+    g = f;
+    f = e;
+    e = _mm512_add_epi32(d, T1);
+    d = c;
+    c = b;
+    b = a;
+    a = _mm512_add_epi32(T1, T2);
+  }
+
+  // ハッシュ値の更新
+  const __m512i r[8] = {a, b, c, d, e, f, g, h};
+  for (std::size_t i = 0; i < 8; i++) {
+    _mm512_store_si512(S + i * L, _mm512_add_epi32(v[i], r[i]));
+  }
+}
+
+#endif // end of SHA256_MB_HPP
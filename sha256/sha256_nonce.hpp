@@ -0,0 +1,88 @@
+/**
+ * @brief ナンスのwordだけが変わるブロックの圧縮(proof-of-workの探索用)
+ * @note  sha256.hppからincludeされる
+ *        ナンスがk番目(と次)のwordにあれば、W0, ..., W{k-1}とラウンド0, ..., k-1は
+ *        ナンスによらない。W16以降もWt = σ1(W{t-2}) + W{t-7} + σ0(W{t-15}) + W{t-16}
+ *        の右辺がどれもナンスによらなければ定数なので、前計算したKt + Wtを使う
+ *        (例: k = 3ならW16, W17は定数)
+ */
+
+#ifndef SHA256_NONCE_HPP
+#define SHA256_NONCE_HPP
+
+#include "sha256.hpp"
+
+inline SHA256::NonceSchedule SHA256::nonce_schedule(const std::uint32_t *H,
+                                                    const std::uint8_t *block,
+                                                    std::size_t word) {
+  NonceSchedule s{};
+  std::copy(H, H + 8, s.H.begin());
+  s.word = word;
+  for (std::size_t t = 0; t < 64; t++) {
+    s.W[t] = t < 16 ? load_be32(block + t * 4)
+                    : small_sigma1(s.W[t - 2]) + s.W[t - 7] +
+                          small_sigma0(s.W[t - 15]) + s.W[t - 16];
+    s.KW[t] = K[t] + s.W[t];
+  }
+
+  // ナンスより前のラウンドを済ませておく
+  s.v = s.H;
+  unroll<0, 16>([&](auto t) {
+    constexpr std::size_t i = decltype(t)::value;
+    if (i < word) {
+      round<i>(s.v.data(), s.KW[i]);
+    }
+  });
+  return s;
+}
+
+template <std::size_t k>
+inline void SHA256::compress_nonce_at(const NonceSchedule &s, std::uint32_t w0,
+                                      std::uint32_t w1, std::uint32_t *H) {
+  static constexpr std::array<bool, 64> dep = nonce_dependency(k);
+
+  // ナンスに依存するWtだけを書き込み、それ以外はsから読む
+  std::uint32_t W[64];
+  W[k] = w0;
+  if constexpr (k + 1 < 16) {
+    W[k + 1] = w1;
+  }
+  const auto word = [&](auto j) {
+    constexpr std::size_t i = decltype(j)::value;
+    if constexpr (dep[i]) {
+      return W[i];
+    } else {
+      return s.W[i];
+    }
+  };
+
+  std::uint32_t v[8];
+  std::copy(s.v.begin(), s.v.end(), v);
+  unroll<k, 64>([&](auto t) {
+    constexpr std::size_t i = decltype(t)::value;
+    if constexpr (!dep[i]) {
+      round<i>(v, s.KW[i]);
+    } else {
+      if constexpr (i >= 16) {
+        W[i] = small_sigma1(word(index_constant<i - 2>{})) +
+               word(index_constant<i - 7>{}) +
+               small_sigma0(word(index_constant<i - 15>{})) +
+               word(index_constant<i - 16>{});
+      }
+      round<i>(v, K[i] + W[i]);
+    }
+  });
+  for (std::size_t i = 0; i < 8; i++) {
+    H[i] = s.H[i] + v[i];
+  }
+}
+
+inline void SHA256::compress_nonce(const NonceSchedule &s, std::uint32_t w0,
+                                   std::uint32_t w1, std::uint32_t *H) {
+  static constexpr std::array<compress_nonce_fn, 16> kernels =
+      nonce_kernels(std::make_index_sequence<16>{});
+  kernels[s.word](s, w0, w1, H);
+  statistics.add_blocks(Backend::Scalar, 1);
+}
+
+#endif // end of SHA256_NONCE_HPP
@@ -0,0 +1,116 @@
+/**
+ * @brief SHA extensions(SHA-NI)によるSHA256の圧縮関数
+ * @note  sha256.hppからincludeされる
+ *        ターゲット属性を付けているので、-mshaなしでビルドしても実行時に選択できる
+ */
+
+#ifndef SHA256_SHANI_HPP
+#define SHA256_SHANI_HPP
+
+#include "sha256.hpp"
+
+/**
+ * @note  sha256rnds2は状態を(A, B, E, F)と(C, D, G, H)の2つのレジスタに分けて持つ
+ *        1命令で2ラウンド進むので、4ラウンド分のW + Kを上位/下位に分けて2回呼び出す
+ *        メッセージスケジュールはsha256msg1/sha256msg2で4 wordsずつ計算する
+ */
+__attribute__((target("sha,sse4.1"))) inline void
+SHA256::compress_shani(std::uint32_t *H, const std::uint8_t *blocks,
+                       std::size_t n) {
+  // 各32-bit word内のbyte順を反転させ、ビッグエンディアンとして読み込むためのマスク
+  const __m128i MASK =
+      _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+
+  // H0, ..., H7を(A, B, E, F)と(C, D, G, H)の並びに組み替える
+  __m128i tmp = _mm_loadu_si128(reinterpret_cast<const __m128i *>(&H[0]));
+  __m128i state1 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(&H[4]));
+  tmp = _mm_shuffle_epi32(tmp, 0xb1);               // C D A B
+  state1 = _mm_shuffle_epi32(state1, 0x1b);         // E F G H
+  __m128i state0 = _mm_alignr_epi8(tmp, state1, 8); // A B E F
+  state1 = _mm_blend_epi16(state1, tmp, 0xf0);      // C D G H
+
+  for (; n > 0; n--, blocks += block_size) {
+    const __m128i abef = state0;
+    const __m128i cdgh = state1;
+
+    // W[4i], ..., W[4i + 3]を保持するリングバッファ
+    __m128i M[4];
+
+    for (std::size_t i = 0; i < 16; i++) {
+      // 0 <= t <= 15 : メッセージをそのまま読み込む
+      if (i < 4) {
+        M[i] = _mm_shuffle_epi8(
+            _mm_loadu_si128(
+                reinterpret_cast<const __m128i *>(blocks + i * 16)),
+            MASK);
+      }
+
+      __m128i msg = _mm_add_epi32(
+          M[i % 4],
+          _mm_loadu_si128(reinterpret_cast<const __m128i *>(&K[i * 4])));
+      state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+
+      // 16 <= t <= 63 : W[t - 7]を加えてσ1の計算を完了させる
+      if (3 <= i && i <= 14) {
+        const __m128i w7 = _mm_alignr_epi8(M[i % 4], M[(i + 3) % 4], 4);
+        M[(i + 1) % 4] = _mm_add_epi32(M[(i + 1) % 4], w7);
+        M[(i + 1) % 4] = _mm_sha256msg2_epu32(M[(i + 1) % 4], M[i % 4]);
+      }
+
+      msg = _mm_shuffle_epi32(msg, 0x0e);
+      state0 = _mm_sha256rnds2_epu32(state0, state1, msg);
+
+      // 3グループ後に使う4 wordsについて、σ0の計算を先に済ませておく
+      if (1 <= i && i <= 12) {
+        M[(i + 3) % 4] = _mm_sha256msg1_epu32(M[(i + 3) % 4], M[i % 4]);
+      }
+    }
+
+    // ハッシュ値の更新
+    state0 = _mm_add_epi32(state0, abef);
+    state1 = _mm_add_epi32(state1, cdgh);
+  }
+
+  // (A, B, E, F), (C, D, G, H)をH0, ..., H7の並びに戻す
+  tmp = _mm_shuffle_epi32(state0, 0x1b);            // F E B A
+  state1 = _mm_shuffle_epi32(state1, 0xb1);         // D C H G
+  state0 = _mm_blend_epi16(tmp, state1, 0xf0);      // D C B A
+  state1 = _mm_alignr_epi8(state1, tmp, 8);         // H G F E
+  _mm_storeu_si128(reinterpret_cast<__m128i *>(&H[0]), state0);
+  _mm_storeu_si128(reinterpret_cast<__m128i *>(&H[4]), state1);
+}
+
+/**
+ * @note  Kt + Wtを4 wordsずつ読み込んでsha256rnds2に渡すだけで、
+ *        sha256msg1/sha256msg2によるmessage scheduleは行わない
+ */
+__attribute__((target("sha,sse4.1"))) inline void
+SHA256::compress_kw_shani(std::uint32_t *H, const std::uint32_t *KW) {
+  __m128i tmp = _mm_loadu_si128(reinterpret_cast<const __m128i *>(&H[0]));
+  __m128i state1 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(&H[4]));
+  tmp = _mm_shuffle_epi32(tmp, 0xb1);               // C D A B
+  state1 = _mm_shuffle_epi32(state1, 0x1b);         // E F G H
+  __m128i state0 = _mm_alignr_epi8(tmp, state1, 8); // A B E F
+  state1 = _mm_blend_epi16(state1, tmp, 0xf0);      // C D G H
+  const __m128i abef = state0;
+  const __m128i cdgh = state1;
+
+  for (std::size_t i = 0; i < 16; i++) {
+    __m128i msg =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(&KW[i * 4]));
+    state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+    msg = _mm_shuffle_epi32(msg, 0x0e);
+    state0 = _mm_sha256rnds2_epu32(state0, state1, msg);
+  }
+  state0 = _mm_add_epi32(state0, abef);
+  state1 = _mm_add_epi32(state1, cdgh);
+
+  tmp = _mm_shuffle_epi32(state0, 0x1b);            // F E B A
+  state1 = _mm_shuffle_epi32(state1, 0xb1);         // D C H G
+  state0 = _mm_blend_epi16(tmp, state1, 0xf0);      // D C B A
+  state1 = _mm_alignr_epi8(state1, tmp, 8);         // H G F E
+  _mm_storeu_si128(reinterpret_cast<__m128i *>(&H[0]), state0);
+  _mm_storeu_si128(reinterpret_cast<__m128i *>(&H[4]), state1);
+}
+
+#endif // end of SHA256_SHANI_HPP
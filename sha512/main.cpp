@@ -5,6 +5,7 @@
 
 #define CATCH_CONFIG_MAIN // This tells Catch to provide a main() - only do this
                           // in one cpp file
+#include "../alloc_counter.hpp"
 #include "../matcher.hpp"
 #include "sha512.hpp"
 
@@ -35,3 +36,187 @@ TEST_CASE("SHA512-Example") {
                       "eb009c5c2c49aa2e 4eadb217ad8cc09b"));
   }
 }
+
+TEST_CASE("SHA512-Streaming") {
+  SECTION("Split Message") {
+    SHA512 ctx;
+    ctx.update("a", 1);
+    ctx.update("bc", 2);
+    CHECK_THAT(ctx.finalize(),
+               expect("ddaf35a193617aba cc417349ae204131 12e6fa4e89a97ea2 "
+                      "0a9eeee64b55d39a 2192992a274fc1a8 36ba3c23a3feebbd "
+                      "454d4423643ce80e 2a9ac94fa54ca49f"));
+  }
+  SECTION("Empty Message") {
+    SHA512 ctx;
+    CHECK_THAT(ctx.finalize(),
+               expect("cf83e1357eefb8bd f1542850d66d8007 d620e4050b5715dc "
+                      "83f4a921d36ce9ce 47d0d13c5d85f2b0 ff8318d2877eec2f "
+                      "63b931bd47417a81 a538327af927da3e"));
+  }
+  SECTION("Long Message") {
+    const std::vector<std::uint8_t> msg(1000000, 0x61);
+    for (std::size_t chunk : {1, 111, 127, 128, 129, 1000, 4096}) {
+      SHA512 ctx;
+      for (std::size_t i = 0; i < msg.size(); i += chunk) {
+        ctx.update(msg.data() + i, std::min(chunk, msg.size() - i));
+      }
+      CHECK_THAT(ctx.finalize(),
+                 expect("e718483d0ce76964 4e2e42c7bc15b463 8e1f98b13b204428 "
+                        "5632a803afa973eb de0ff244877ea60a 4cb0432ce577c31b "
+                        "eb009c5c2c49aa2e 4eadb217ad8cc09b"));
+    }
+  }
+}
+
+TEST_CASE("SHA512-Zero-Allocation") {
+  const std::string msg(1000, 'a');
+  const std::size_t before = allocation_count.load();
+  const auto bytes = SHA512().hash(msg.data(), msg.size());
+  const std::size_t after = allocation_count.load();
+  CHECK(after == before);
+  CHECK_THAT(bytes,
+             expect("67ba5535a46e3f86 dbfbed8cbbaf0125 c76ed549ff8b0b9e "
+                    "03e0c88cf90fa634 fa7b12b47d77b694 de488ace8d9a6596 "
+                    "7dc96df599727d32 92a8d9d447709c97"));
+}
+
+TEST_CASE("SHA512-Prefix") {
+  std::vector<std::uint8_t> msg(500);
+  for (std::size_t i = 0; i < msg.size(); i++) {
+    msg[i] = static_cast<std::uint8_t>(i * 7 + 3);
+  }
+
+  // ブロック境界にない接頭辞も含め、接頭辞を一度だけ取り込んで使い回す
+  for (std::size_t plen : {0, 1, 55, 64, 100, 128, 200, 300}) {
+    INFO("prefix = " << plen);
+    SHA512 prefix;
+    prefix.update(msg.data(), plen);
+    const SHA512::state_type saved = prefix.state();
+    for (std::size_t len = 0; plen + len <= msg.size(); len += 37) {
+      const auto expected = SHA512().hash(msg.data(), plen + len);
+      CHECK(prefix.hash_suffix(msg.data() + plen, len) == expected);
+
+      SHA512 ctx(saved);
+      ctx.update(msg.data() + plen, len);
+      CHECK(ctx.finalize() == expected);
+    }
+
+    // restore()で同じオブジェクトを接頭辞の状態に戻せる
+    SHA512 ctx;
+    ctx.update("junk", 4);
+    ctx.restore(saved);
+    CHECK(ctx.finalize() == SHA512().hash(msg.data(), plen));
+  }
+}
+
+TEST_CASE("SHA512-Constexpr") {
+  // コンパイル時に評価されること
+  constexpr auto abc = sha512("abc");
+  constexpr auto two =
+      sha512("abcdefghbcdefghicdefghijdefghijkefghijklfghijklmghijklmn"
+             "hijklmnoijklmnopjklmnopqklmnopqrlmnopqrsmnopqrstnopqrstu");
+  constexpr auto bytes = sha512(std::array<std::uint8_t, 3>{0x61, 0x62, 0x63});
+  static_assert(digest_is(abc,
+                          "ddaf35a193617aba cc417349ae204131 12e6fa4e89a97ea2 "
+                          "0a9eeee64b55d39a 2192992a274fc1a8 36ba3c23a3feebbd "
+                          "454d4423643ce80e 2a9ac94fa54ca49f"));
+  static_assert(digest_is(two,
+                          "8e959b75dae313da 8cf4f72814fc143f 8f7779c6eb9f7fa1 "
+                          "7299aeadb6889018 501d289e4900f7e4 331b99dec4b5433a "
+                          "c7d329eeb6dd2654 5e96e55b874be909"));
+  static_assert(digest_is(bytes,
+                          "ddaf35a193617aba cc417349ae204131 12e6fa4e89a97ea2 "
+                          "0a9eeee64b55d39a 2192992a274fc1a8 36ba3c23a3feebbd "
+                          "454d4423643ce80e 2a9ac94fa54ca49f"));
+
+  // ダイジェストをテンプレート引数に使う
+  using First = std::integral_constant<std::uint8_t, sha512("abc")[0]>;
+  CHECK(First::value == 0xdd);
+
+  // 実行時に呼び出しても、通常の計算と一致すること
+  std::vector<std::uint8_t> msg(300);
+  for (std::size_t i = 0; i < msg.size(); i++) {
+    msg[i] = static_cast<std::uint8_t>(i * 7 + 3);
+  }
+  for (std::size_t len = 0; len <= msg.size(); len++) {
+    CHECK(SHA512::hash_constexpr(msg.data(), len) ==
+          SHA512().hash(msg.data(), len));
+  }
+}
+
+TEST_CASE("SHA512-Backends") {
+  // スカラー実装の結果を基準にして、各バックエンドの結果と突き合わせる
+  std::vector<std::uint8_t> msg(2000);
+  for (std::size_t i = 0; i < msg.size(); i++) {
+    msg[i] = static_cast<std::uint8_t>(i * 7 + 3);
+  }
+  const Backend original = SHA512::backend();
+  REQUIRE(SHA512::set_backend(Backend::Scalar));
+  std::vector<SHA512::digest_type> expected;
+  for (std::size_t len = 0; len <= msg.size(); len += 29) {
+    expected.push_back(SHA512().hash(msg.data(), len));
+  }
+
+  for (Backend b : {Backend::Scalar, Backend::AVX2}) {
+    if (!SHA512::set_backend(b)) {
+      WARN("backend " << backend_name(b) << " is not supported");
+      continue;
+    }
+    INFO("backend = " << backend_name(b));
+    CHECK(SHA512::backend() == b);
+    CHECK_THAT(SHA512().hash("abc"),
+               expect("ddaf35a193617aba cc417349ae204131 12e6fa4e89a97ea2 "
+                      "0a9eeee64b55d39a 2192992a274fc1a8 36ba3c23a3feebbd "
+                      "454d4423643ce80e 2a9ac94fa54ca49f"));
+    for (std::size_t len = 0, i = 0; len <= msg.size(); len += 29, i++) {
+      CHECK(SHA512().hash(msg.data(), len) == expected[i]);
+    }
+  }
+  SHA512::set_backend(original);
+}
+
+TEST_CASE("SHA512-Batch") {
+  // 長さの異なるメッセージを用意し、1つずつ計算した結果と突き合わせる
+  std::vector<std::vector<std::uint8_t>> msgs;
+  for (std::size_t i = 0; i < 100; i++) {
+    msgs.emplace_back((i * 37) % 600, static_cast<std::uint8_t>(i));
+  }
+  std::vector<const void *> data;
+  std::vector<std::size_t> len;
+  std::vector<SHA512::digest_type> expected;
+  for (auto &&m : msgs) {
+    data.push_back(m.data());
+    len.push_back(m.size());
+    expected.push_back(SHA512().hash(m.data(), m.size()));
+  }
+
+  const Backend original = SHA512::batch_backend();
+  for (Backend b : {Backend::Scalar, Backend::AVX2, Backend::AVX512}) {
+    if (!SHA512::set_batch_backend(b)) {
+      WARN("batch backend " << backend_name(b) << " is not supported");
+      continue;
+    }
+    INFO("batch backend = " << backend_name(b));
+    for (std::size_t n : {0, 1, 3, 4, 5, 8, 9, 100}) {
+      std::vector<SHA512::digest_type> M(n);
+      SHA512::hash_many(n, data.data(), len.data(), M.data());
+      CHECK(std::equal(M.cbegin(), M.cend(), expected.cbegin()));
+    }
+
+    const std::vector<std::uint8_t> msg(1000000, 0x61);
+    const void *p[] = {"abc", msg.data()};
+    const std::size_t l[] = {3, msg.size()};
+    SHA512::digest_type M[2];
+    SHA512::hash_many(2, p, l, M);
+    CHECK_THAT(M[0],
+               expect("ddaf35a193617aba cc417349ae204131 12e6fa4e89a97ea2 "
+                      "0a9eeee64b55d39a 2192992a274fc1a8 36ba3c23a3feebbd "
+                      "454d4423643ce80e 2a9ac94fa54ca49f"));
+    CHECK_THAT(M[1],
+               expect("e718483d0ce76964 4e2e42c7bc15b463 8e1f98b13b204428 "
+                      "5632a803afa973eb de0ff244877ea60a 4cb0432ce577c31b "
+                      "eb009c5c2c49aa2e 4eadb217ad8cc09b"));
+  }
+  SHA512::set_batch_backend(original);
+}
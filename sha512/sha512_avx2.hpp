@@ -0,0 +1,94 @@
+/**
+ * @brief AVX2/BMI2によるSHA-512の圧縮関数(単一メッセージ)
+ * @note  sha512.hppからincludeされる
+ *        message scheduleだけをベクトル化し、ラウンドはスカラーで計算する
+ */
+
+#ifndef SHA512_AVX2_HPP
+#define SHA512_AVX2_HPP
+
+#include "sha512.hpp"
+#include "sha512_mb.hpp"
+
+/**
+ * @brief 2つの64-bit wordにσ0, σ1を施す(128-bitレーンごと)
+ * @note  回転はsha512_mb.hppのmm256_rotr_epi64を使う
+ */
+template <int R1, int R2, int S>
+__attribute__((target("avx2"))) inline __m256i sha512_avx2_sigma(__m256i x) {
+  return _mm256_xor_si256(
+      _mm256_xor_si256(mm256_rotr_epi64<R1>(x), mm256_rotr_epi64<R2>(x)),
+      _mm256_srli_epi64(x, S));
+}
+
+/**
+ * @note  2つのブロックをYMMレジスタの下位/上位128-bitに1つずつ載せ、
+ *        message scheduleを2 wordsずつ同時に計算してW + Kを書き出す
+ *        SHA-512ではW[t - 2]が2 words前にあるので、σ1を分割せずに計算できる
+ *        ブロック数が奇数のときは、最後のブロックを上位にも複製して結果を捨てる
+ */
+__attribute__((target("avx2,bmi2"))) inline void
+SHA512::compress_avx2(std::uint64_t *H, const std::uint8_t *blocks,
+                      std::size_t n) {
+  // 各64-bit word内のbyte順を反転させ、ビッグエンディアンとして読み込むためのマスク
+  const __m256i MASK = _mm256_broadcastsi128_si256(
+      _mm_set_epi64x(0x08090a0b0c0d0e0fULL, 0x0001020304050607ULL));
+
+  // 2ブロック分のW[t] + K[t]
+  alignas(32) std::uint64_t WK[2][80];
+
+  while (n > 0) {
+    const std::uint8_t *lo = blocks;
+    const std::uint8_t *hi = n > 1 ? blocks + block_size : blocks;
+
+    // W[2i], W[2i + 1]を保持するリングバッファ
+    __m256i X[8];
+
+    for (std::size_t i = 0; i < 40; i++) {
+      if (i < 8) {
+        // 0 <= t <= 15 : メッセージをそのまま読み込む
+        const __m128i x0 =
+            _mm_loadu_si128(reinterpret_cast<const __m128i *>(lo + i * 16));
+        const __m128i x1 =
+            _mm_loadu_si128(reinterpret_cast<const __m128i *>(hi + i * 16));
+        X[i] = _mm256_shuffle_epi8(
+            _mm256_inserti128_si256(_mm256_castsi128_si256(x0), x1, 1), MASK);
+      } else {
+        // 16 <= t <= 79 : σ1(W[t - 2]) + W[t - 7] + σ0(W[t - 15]) + W[t - 16]
+        const __m256i w15 = _mm256_alignr_epi8(X[(i + 1) % 8], X[i % 8], 8);
+        const __m256i w7 =
+            _mm256_alignr_epi8(X[(i + 5) % 8], X[(i + 4) % 8], 8);
+        X[i % 8] = _mm256_add_epi64(
+            _mm256_add_epi64(sha512_avx2_sigma<19, 61, 6>(X[(i + 7) % 8]), w7),
+            _mm256_add_epi64(sha512_avx2_sigma<1, 8, 7>(w15), X[i % 8]));
+      }
+
+      const __m256i wk = _mm256_add_epi64(
+          X[i % 8], _mm256_broadcastsi128_si256(_mm_loadu_si128(
+                        reinterpret_cast<const __m128i *>(&K[i * 2]))));
+      _mm_store_si128(reinterpret_cast<__m128i *>(&WK[0][i * 2]),
+                      _mm256_castsi256_si128(wk));
+      _mm_store_si128(reinterpret_cast<__m128i *>(&WK[1][i * 2]),
+                      _mm256_extracti128_si256(wk, 1));
+    }
+
+    const std::size_t m = n > 1 ? 2 : 1;
+    for (std::size_t j = 0; j < m; j++) {
+      std::uint64_t v[8] = {H[0], H[1], H[2], H[3], H[4], H[5], H[6], H[7]};
+      unroll<0, 80>([&](auto t) {
+        constexpr std::size_t i = decltype(t)::value;
+        round<i>(v, WK[j][i]);
+      });
+
+      // ハッシュ値の更新
+      for (std::size_t i = 0; i < 8; i++) {
+        H[i] += v[i];
+      }
+    }
+
+    blocks += m * block_size;
+    n -= m;
+  }
+}
+
+#endif // end of SHA512_AVX2_HPP
@@ -0,0 +1,298 @@
+/**
+ * @brief sha1sum -c/sha256sum -cと同じ形式の検証リストに従い、ファイルを検証する
+ * @note  リストは最初に一度だけ読み、16進数のハッシュ値をbyte列に変換して
+ *        (hex.hppのfrom_hex())1つの配列に詰めておく
+ *        計算したハッシュ値は16進数にせず、byte列のまま比べる
+ *        ファイルはスレッドプールで並列に計算し、結果はリストの順に、
+ *        先頭から揃った分をすぐに報告する
+ */
+
+#ifndef SHASUM_CHECK_HPP
+#define SHASUM_CHECK_HPP
+
+#include "shasum.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <limits>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * @brief 検証リストを読み込んだもの
+ */
+struct CheckList {
+  /**< @brief ハッシュ値のbyte数 */
+  std::size_t digest_size = 0;
+
+  /**< @brief i番目のハッシュ値は[i * digest_size, (i + 1) * digest_size) */
+  std::vector<std::uint8_t> digests;
+
+  /**< @brief i番目のファイルのパス */
+  std::vector<std::string> paths;
+
+  /**< @brief 形式が誤っていた行の数 */
+  std::size_t invalid = 0;
+
+  std::size_t size() const { return paths.size(); }
+
+  const std::uint8_t *digest(std::size_t i) const {
+    return digests.data() + i * digest_size;
+  }
+};
+
+/**
+ * @brief 1つのファイルの検証結果
+ */
+enum class CheckStatus {
+  Pending,    /**< まだ計算していない */
+  OK,         /**< ハッシュ値が一致した */
+  Failed,     /**< ハッシュ値が一致しなかった */
+  Unreadable, /**< 開けない、あるいは読めなかった */
+};
+
+/**
+ * @brief 検証の集計
+ */
+struct CheckSummary {
+  std::size_t ok = 0;
+  std::size_t failed = 0;
+  std::size_t unreadable = 0;
+
+  /**< @brief 開始から最初の失敗(不一致か読めない)が見つかるまでの秒数(なければ負) */
+  double first_failure = -1;
+
+  /**< @brief 検証にかかった時間(秒) */
+  double seconds = 0;
+};
+
+/**
+ * @brief  アルゴリズムのハッシュ値のbyte数
+ * @param  int bits 1, 224, 256, 384, 512, 512224, 512256のいずれか
+ * @return 未対応のアルゴリズムであれば0
+ */
+inline std::size_t check_digest_size(int bits) {
+  switch (bits) {
+  case 1:
+    return SHA1::digest_size;
+  case 224:
+  case 512224:
+    return 28;
+  case 256:
+  case 512256:
+    return 32;
+  case 384:
+    return 48;
+  case 512:
+    return 64;
+  default:
+    return 0;
+  }
+}
+
+/**
+ * @brief  検証リストの1行を読み込む
+ * @note   "<hex>  <path>"または"<hex> *<path>"(バイナリモード)
+ *         '\\'で始まる行では、パス中の"\\\\"と"\\n"を'\\'と改行に戻す
+ * @return 形式が誤っていればfalse
+ */
+inline bool parse_check_line(std::string_view line, CheckList &list) {
+  const bool escaped = !line.empty() && line[0] == '\\';
+  if (escaped) {
+    line.remove_prefix(1);
+  }
+  const std::size_t hex = 2 * list.digest_size;
+  if (line.size() < hex + 3 || line[hex] != ' ' ||
+      (line[hex + 1] != ' ' && line[hex + 1] != '*')) {
+    return false;
+  }
+
+  std::string path;
+  const std::string_view name = line.substr(hex + 2);
+  if (escaped) {
+    for (std::size_t i = 0; i < name.size(); i++) {
+      if (name[i] != '\\') {
+        path += name[i];
+      } else if (i + 1 < name.size() && name[i + 1] == '\\') {
+        path += '\\';
+        i++;
+      } else if (i + 1 < name.size() && name[i + 1] == 'n') {
+        path += '\n';
+        i++;
+      } else {
+        return false;
+      }
+    }
+  } else {
+    path = name;
+  }
+
+  const std::size_t n = list.digests.size();
+  list.digests.resize(n + list.digest_size);
+  if (!from_hex(line.data(), list.digest_size, list.digests.data() + n)) {
+    list.digests.resize(n);
+    return false;
+  }
+  list.paths.push_back(std::move(path));
+  return true;
+}
+
+/**
+ * @brief  検証リスト全体を読み込む
+ * @param  std::size_t digest_size ハッシュ値のbyte数
+ * @note   '#'で始まる行は読み飛ばす。行末の'\r'は取り除く
+ */
+inline CheckList parse_check_list(std::string_view text,
+                                  std::size_t digest_size) {
+  CheckList list;
+  list.digest_size = digest_size;
+  while (!text.empty()) {
+    const std::size_t eol = std::min(text.find('\n'), text.size());
+    std::string_view line = text.substr(0, eol);
+    text.remove_prefix(std::min(eol + 1, text.size()));
+    if (!line.empty() && line.back() == '\r') {
+      line.remove_suffix(1);
+    }
+    if (!line.empty() && line[0] == '#') {
+      continue;
+    }
+    if (!parse_check_line(line, list)) {
+      list.invalid++;
+    }
+  }
+  return list;
+}
+
+/**
+ * @brief  検証リストのファイルを読み込む
+ * @param  const std::string& path ファイルのパス("-"なら標準入力)
+ * @note   開けない、あるいは読めなければstd::system_errorを送出する
+ */
+inline CheckList read_check_list(const std::string &path,
+                                 std::size_t digest_size) {
+  // 文字列に読み込んでから解析する(大きなリストはfeed_stream()がmmapで読む)
+  struct Text {
+    void update(const void *data, std::size_t len) {
+      s.append(static_cast<const char *>(data), len);
+    }
+    std::string s;
+  } text;
+  if (path == "-") {
+    feed_stream(text, STDIN_FILENO, thread_stream_buffer(), path);
+    return parse_check_list(text.s, digest_size);
+  }
+  const MappedFile file(path, std::numeric_limits<std::size_t>::max());
+  feed_stream(text, file.descriptor(), thread_stream_buffer(), path);
+  return parse_check_list(text.s, digest_size);
+}
+
+/**
+ * @brief  検証リストの形式で出力するためにパスをエスケープする
+ * @param  bool& escaped '\\'と改行を含んでいたか(行頭に'\\'を付けること)
+ */
+inline std::string escape_check_path(const std::string &path, bool &escaped) {
+  escaped = path.find_first_of("\\\n") != std::string::npos;
+  if (!escaped) {
+    return path;
+  }
+  std::string s;
+  for (char c : path) {
+    if (c == '\\') {
+      s += "\\\\";
+    } else if (c == '\n') {
+      s += "\\n";
+    } else {
+      s += c;
+    }
+  }
+  return s;
+}
+
+/**
+ * @brief  検証リストの全てのファイルを並列に計算し、ハッシュ値と比べる
+ * @param  Report&& report 結果を受け取る関数 report(std::size_t i, CheckStatus)
+ *         リストの順に、1つのスレッドずつ呼び出す(例外を送出してはならない)
+ * @param  const PipelineConfig* pipeline 先行読み込みの設定(nullptrならmmap)
+ * @param  DigestCache* cache 記録したハッシュ値のキャッシュ(nullptrなら使わない)
+ * @note   i番目の結果は、0, ..., i - 1番目が全て揃った時点ですぐに報告する
+ */
+template <class Hasher, class Report>
+CheckSummary check_files(const CheckList &list, ThreadPool &pool,
+                         Report &&report,
+                         const PipelineConfig *pipeline = nullptr,
+                         DigestCache *cache = nullptr) {
+  const auto start = std::chrono::steady_clock::now();
+  const auto elapsed = [&] {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                         start)
+        .count();
+  };
+
+  CheckSummary summary;
+  std::vector<CheckStatus> status(list.size(), CheckStatus::Pending);
+  std::size_t reported = 0;
+  std::mutex mutex;
+  pool.parallel_for(list.size(), [&](std::size_t i) {
+    CheckStatus s;
+    try {
+      const auto digest = hash_file<Hasher>(list.paths[i], pipeline, cache);
+      s = std::memcmp(digest.data(), list.digest(i), digest.size()) == 0
+              ? CheckStatus::OK
+              : CheckStatus::Failed;
+    } catch (const std::system_error &) {
+      s = CheckStatus::Unreadable;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    status[i] = s;
+    if (s == CheckStatus::OK) {
+      summary.ok++;
+    } else {
+      summary.failed += s == CheckStatus::Failed;
+      summary.unreadable += s == CheckStatus::Unreadable;
+      if (summary.first_failure < 0) {
+        summary.first_failure = elapsed();
+      }
+    }
+    for (; reported < status.size() && status[reported] != CheckStatus::Pending;
+         reported++) {
+      report(reported, status[reported]);
+    }
+  });
+  summary.seconds = elapsed();
+  return summary;
+}
+
+/**
+ * @brief  アルゴリズムを指定して検証リストのファイルを検証する
+ * @param  int bits 1, 224, 256, 384, 512, 512224, 512256のいずれか
+ *         (リストのdigest_sizeはcheck_digest_size(bits)であること)
+ */
+template <class Report>
+CheckSummary check_files(int bits, const CheckList &list, ThreadPool &pool,
+                         Report &&report,
+                         const PipelineConfig *pipeline = nullptr,
+                         DigestCache *cache = nullptr) {
+  switch (bits) {
+  case 1:
+    return check_files<SHA1>(list, pool, report, pipeline, cache);
+  case 224:
+    return check_files<SHA224>(list, pool, report, pipeline, cache);
+  case 256:
+    return check_files<SHA256>(list, pool, report, pipeline, cache);
+  case 384:
+    return check_files<SHA384>(list, pool, report, pipeline, cache);
+  case 512:
+    return check_files<SHA512>(list, pool, report, pipeline, cache);
+  case 512224:
+    return check_files<SHA512_224>(list, pool, report, pipeline, cache);
+  case 512256:
+    return check_files<SHA512_256>(list, pool, report, pipeline, cache);
+  default:
+    return CheckSummary();
+  }
+}
+
+#endif // end of SHASUM_CHECK_HPP
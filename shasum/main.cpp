@@ -0,0 +1,761 @@
+/**
+ * @brief shasumのテストプログラム
+ * @note  疎(sparse)ファイルを使い、実際にディスクを消費せずに数GBのファイルを試す
+ */
+
+#define CATCH_CONFIG_MAIN // This tells Catch to provide a main() - only do this
+                          // in one cpp file
+#include "../alloc_counter.hpp"
+#include "../matcher.hpp"
+#include "check.hpp"
+#include <cstdlib>
+#include <sstream>
+
+/**
+ * @brief テスト用の一時ファイル(スコープを抜けると削除される)
+ */
+class TempFile {
+public:
+  TempFile() {
+    const char *dir = std::getenv("TMPDIR");
+    path = std::string(dir != nullptr ? dir : "/tmp") + "/shasum.XXXXXX";
+    fd = ::mkstemp(&path[0]);
+    REQUIRE(fd >= 0);
+  }
+
+  ~TempFile() {
+    ::close(fd);
+    ::unlink(path.c_str());
+  }
+
+  void write(const std::string &s) const {
+    REQUIRE(::write(fd, s.data(), s.size()) ==
+            static_cast<ssize_t>(s.size()));
+  }
+
+  // 末尾にholeを作って大きさをsizeにする(ディスクは消費しない)
+  void extend(off_t size) const { REQUIRE(::ftruncate(fd, size) == 0); }
+
+  void seek_end() const { REQUIRE(::lseek(fd, 0, SEEK_END) >= 0); }
+
+  std::string path;
+  int fd;
+};
+
+/**
+ * @brief i * 7 + 3 (mod 256)をn byte生成する入力(全体をメモリに置かない)
+ */
+class PatternBuf : public std::streambuf {
+public:
+  explicit PatternBuf(std::uint64_t n, bool fail = false) : n(n), fail(fail) {}
+
+protected:
+  int_type underflow() override {
+    if (pos >= n) {
+      if (fail) {
+        throw std::runtime_error("read error");
+      }
+      return traits_type::eof();
+    }
+    const auto m = static_cast<std::size_t>(
+        std::min<std::uint64_t>(sizeof(block), n - pos));
+    for (std::size_t i = 0; i < m; i++) {
+      block[i] = static_cast<char>((pos + i) * 7 + 3);
+    }
+    pos += m;
+    setg(block, block, block + m);
+    return traits_type::to_int_type(block[0]);
+  }
+
+private:
+  std::uint64_t n;
+  bool fail;
+  std::uint64_t pos = 0;
+  char block[4093];
+};
+
+/**
+ * @brief  PatternBufと同じn byteのハッシュ値を直接求める
+ */
+template <class Hasher>
+typename Hasher::digest_type pattern_hash(std::size_t n) {
+  std::vector<std::uint8_t> msg(n);
+  for (std::size_t i = 0; i < n; i++) {
+    msg[i] = static_cast<std::uint8_t>(i * 7 + 3);
+  }
+  return Hasher().hash(msg.data(), msg.size());
+}
+
+TEST_CASE("Shasum-Small-Files") {
+  TempFile file;
+
+  SECTION("Empty File") {
+    CHECK(hash_file_hex(1, file.path) ==
+          "da39a3ee5e6b4b0d3255bfef95601890afd80709");
+    CHECK(hash_file_hex(256, file.path) ==
+          "e3b0c44298fc1c149afbf4c8996fb924"
+          "27ae41e4649b934ca495991b7852b855");
+  }
+
+  SECTION("SHA-2 Variants") {
+    file.write("abc");
+    CHECK(hash_file_hex(224, file.path) ==
+          "23097d223405d8228642a477bda255b32aadbce4bda0b3f7e36c9da7");
+    CHECK(hash_file_hex(384, file.path) ==
+          "cb00753f45a35e8bb5a03d699ac65007272c32ab0eded163"
+          "1a8b605a43ff5bed8086072ba1e7cc2358baeca134c825a7");
+    CHECK(hash_file_hex(512224, file.path) ==
+          "4634270f707b6a54daae7530460842e20e37ed265ceee9a43e8924aa");
+    CHECK(hash_file_hex(512256, file.path) ==
+          "53048e2681941ef99b2e29b76b4c7dab"
+          "e4c2d0c634fc6d46e0e2f13107e7af23");
+    CHECK(hash_file_hex(128, file.path).empty());
+  }
+
+  SECTION("One-Block Message") {
+    file.write("abc");
+    CHECK_THAT(hash_file<SHA1>(file.path),
+               expect("a9993e36 4706816a ba3e2571 7850c26c 9cd0d89d"));
+    CHECK_THAT(hash_file<SHA256>(file.path),
+               expect("ba7816bf 8f01cfea 414140de 5dae2223 b00361a3 "
+                      "96177a9c b410ff61 f20015ad"));
+    CHECK_THAT(hash_file<SHA512>(file.path),
+               expect("ddaf35a193617aba cc417349ae204131 12e6fa4e89a97ea2 "
+                      "0a9eeee64b55d39a 2192992a274fc1a8 36ba3c23a3feebbd "
+                      "454d4423643ce80e 2a9ac94fa54ca49f"));
+  }
+
+  SECTION("Missing File") {
+    CHECK_THROWS_AS(hash_file<SHA256>(file.path + ".missing"),
+                    std::system_error);
+  }
+}
+
+TEST_CASE("Shasum-Sparse-Files") {
+  // 4GiBのholeの後に"abc"を置く
+  // ビット長の下位32-bitしか書き込まない実装では誤ったダイジェストになる
+  TempFile file;
+  file.extend(off_t(1) << 32);
+  file.seek_end();
+  file.write("abc");
+
+  SECTION("SHA1") {
+    CHECK(hash_file_hex(1, file.path) ==
+          "eee321e1de4be0ec5d7943620e0b079b7537c6fd");
+  }
+
+  SECTION("SHA256") {
+    CHECK(hash_file_hex(256, file.path) ==
+          "493aa9f5af1e681d1bcc8db0c96a2ae4"
+          "b5e6b3e51cefddb7efe24bdc7bdefa91");
+  }
+
+  SECTION("SHA512") {
+    CHECK(hash_file_hex(512, file.path) ==
+          "1ace1917615758323a4a9a30248dda743c677efef5bb1cf0d7b8863dc3e072e2"
+          "504672d40ce447cad1b9d310d134349fb6ad8b74915efb6690c521abb088b727");
+  }
+}
+
+TEST_CASE("Shasum-Truncated-While-Mapped") {
+  // マップした後で切り詰められたファイルは、SIGBUSで終了せずに例外となる
+  TempFile file;
+  file.extend(off_t(4) << 20);
+  const MappedFile mapped(file.path);
+  REQUIRE(mapped.mapped());
+  file.extend(0);
+
+  SECTION("feed()") {
+    SHA256 hasher;
+    CHECK_THROWS_AS(mapped.feed(hasher), std::system_error);
+  }
+
+  SECTION("Tree Hash") {
+    ThreadPool pool(4);
+    TreeHash<SHA256> tree(pool, 4096);
+    CHECK_THROWS_AS(tree.update(mapped.data(), mapped.size()),
+                    std::system_error);
+  }
+
+  SECTION("Exception") {
+    // f()が例外を送出しても、戻り先は元に戻る(入れ子の内側でも)
+    sigjmp_buf *const before = mapped_file_detail::sigbus_target;
+    CHECK_THROWS_AS(guard_sigbus("outer",
+                                 [] {
+                                   guard_sigbus("inner", [] {
+                                     throw std::runtime_error("inner");
+                                   });
+                                 }),
+                    std::runtime_error);
+    CHECK(mapped_file_detail::sigbus_target == before);
+
+    ThreadPool pool(4);
+    TreeHash<SHA256> tree(pool, 4096);
+    CHECK_THROWS_AS(tree.update(mapped.data(), mapped.size()),
+                    std::system_error);
+    CHECK(mapped_file_detail::sigbus_target == before);
+  }
+
+  // 捕まえた後も、通常どおり計算できる
+  file.write("abc");
+  CHECK(hash_file_hex(256, file.path) ==
+        "ba7816bf8f01cfea414140de5dae2223"
+        "b00361a396177a9cb410ff61f20015ad");
+}
+
+TEST_CASE("Shasum-Stream") {
+  const std::size_t n = (std::size_t(5) << 20) + 11;
+
+  SECTION("istream") {
+    PatternBuf pattern(n);
+    std::istream in(&pattern);
+    CHECK(hash_stream<SHA256>(in) == pattern_hash<SHA256>(n));
+
+    // 入力の長さによらず、バッファを確保し直さない
+    PatternBuf longer(4 * n);
+    std::istream in2(&longer);
+    SHA1 hasher;
+    const std::size_t before = allocation_count.load();
+    CHECK(feed_stream(hasher, in2, thread_stream_buffer()) == 4 * n);
+    CHECK(allocation_count.load() == before);
+  }
+
+  SECTION("istream error") {
+    PatternBuf broken(1000, true);
+    std::istream in(&broken);
+    CHECK_THROWS_AS(hash_stream<SHA256>(in), std::system_error);
+  }
+
+  SECTION("Pipe") {
+    int fds[2];
+    REQUIRE(::pipe(fds) == 0);
+    bool written = true;
+    std::thread writer([&] {
+      std::vector<std::uint8_t> msg(n);
+      for (std::size_t i = 0; i < n; i++) {
+        msg[i] = static_cast<std::uint8_t>(i * 7 + 3);
+      }
+      for (std::size_t off = 0; off < n; off += 1000) {
+        const std::size_t m = std::min<std::size_t>(1000, n - off);
+        written &= ::write(fds[1], msg.data() + off, m) ==
+                   static_cast<ssize_t>(m);
+      }
+      ::close(fds[1]);
+    });
+    CHECK(hash_stream<SHA512>(fds[0], "pipe") == pattern_hash<SHA512>(n));
+    writer.join();
+    CHECK(written);
+    CHECK(::fcntl(fds[0], F_GETPIPE_SZ) >= 65536);
+    ::close(fds[0]);
+  }
+
+  SECTION("Redirected File") {
+    // shasum - < FILEのように、標準入力が通常のファイルの場合
+    TempFile file;
+    file.write("xyzabc");
+    REQUIRE(::lseek(file.fd, 0, SEEK_SET) == 0);
+    CHECK_THAT(hash_stream<SHA1>(file.fd, file.path),
+               expect("cc7938a3 c6de8b7f aadc8c3d f3c951ae c10ef487"));
+    CHECK(::lseek(file.fd, 0, SEEK_CUR) == 6);
+
+    // 途中まで読まれていれば、続きから読む
+    REQUIRE(::lseek(file.fd, 3, SEEK_SET) == 3);
+    CHECK_THAT(hash_stream<SHA1>(file.fd, file.path),
+               expect("a9993e36 4706816a ba3e2571 7850c26c 9cd0d89d"));
+  }
+}
+
+TEST_CASE("Shasum-Pipeline") {
+  // バッファの境界の前後とO_DIRECTの境界(4096)の前後を試す
+  // 結果はmmapで読んだものと一致すること
+  PipelineConfig config;
+  config.buffer_size = 8192;
+  config.depth = 3;
+  config.engine = GENERATE(ReadEngine::IoUring, ReadEngine::Thread);
+  config.direct = GENERATE(false, true);
+  INFO("engine = " << engine_name(config.engine)
+                   << ", direct = " << config.direct);
+
+  for (std::size_t n : {0, 1, 4095, 4096, 4097, 8192, 3 * 8192 + 5, 100000}) {
+    TempFile file;
+    std::string data(n, '\0');
+    for (std::size_t i = 0; i < n; i++) {
+      data[i] = static_cast<char>(i * 31 + 7);
+    }
+    file.write(data);
+    INFO("size = " << n);
+    CHECK(hash_file<SHA256>(file.path, &config) ==
+          hash_file<SHA256>(file.path));
+    CHECK(hash_file_hex(512, file.path, &config) ==
+          hash_file_hex(512, file.path));
+
+    // io_uringが使えない環境では読み込み用のスレッドになる
+    FilePipeline pipeline(file.path, config);
+    if (!IoUring::supported()) {
+      CHECK(pipeline.engine() == ReadEngine::Thread);
+    }
+    SHA1 hasher;
+    CHECK(pipeline.feed(hasher) == n);
+  }
+
+  // 大きさが0と報告される/procのファイルも、終端まで読む
+  {
+    struct Text {
+      void update(const void *data, std::size_t len) {
+        s.append(static_cast<const char *>(data), len);
+      }
+      std::string s;
+    } text;
+    FilePipeline pipeline("/proc/self/status", config);
+    const std::uint64_t n = pipeline.feed(text);
+    CHECK(n == text.s.size());
+    CHECK(text.s.compare(0, 5, "Name:") == 0);
+    CHECK(hash_file<SHA256>("/proc/self/cmdline", &config) ==
+          hash_file<SHA256>("/proc/self/cmdline"));
+  }
+
+  // fstat()の後に伸びたファイルも、終端まで読む
+  {
+    TempFile file;
+    file.write(std::string(5000, 'a'));
+    FilePipeline pipeline(file.path, config);
+    file.write(std::string(3 * 8192, 'b'));
+    SHA256 hasher;
+    CHECK(pipeline.feed(hasher) == 5000 + 3 * 8192);
+    CHECK(hasher.finalize() == hash_file<SHA256>(file.path));
+  }
+
+  CHECK_THROWS_AS(FilePipeline("/nonexistent/shasum", config),
+                  std::system_error);
+}
+
+TEST_CASE("Shasum-Pipeline-Short-Read") {
+  // O_DIRECTと同じく境界に揃っていない読み込みはEINVALとし、1回に高々1000 byte
+  // しか返さない読み込み関数で、短く返った後の残りの読み方を試す
+  std::string data(10000, '\0');
+  for (std::size_t i = 0; i < data.size(); i++) {
+    data[i] = static_cast<char>(i * 31 + 7);
+  }
+  constexpr std::size_t align = FilePipeline::alignment;
+  std::size_t direct_calls = 0;
+  std::size_t unaligned_calls = 0;
+  const auto source = [&](std::size_t &calls, bool direct) {
+    return [&, direct](std::uint8_t *p, std::size_t n,
+                       std::uint64_t off) -> long long {
+      calls++;
+      if (direct && (reinterpret_cast<std::uintptr_t>(p) % align != 0 ||
+                     n % align != 0 || off % align != 0)) {
+        return -EINVAL;
+      }
+      if (off >= data.size()) {
+        return 0;
+      }
+      const std::size_t m =
+          std::min<std::size_t>({n, 1000, data.size() - off});
+      std::memcpy(p, data.data() + off, m);
+      return static_cast<long long>(m);
+    };
+  };
+  const auto direct = source(direct_calls, true);
+  const auto unaligned = source(unaligned_calls, false);
+
+  std::unique_ptr<std::uint8_t, decltype(&std::free)> buf(
+      static_cast<std::uint8_t *>(std::aligned_alloc(align, 2 * align)),
+      &std::free);
+
+  // 先頭は揃っているのでO_DIRECTで読み、短く返った残りは揃えずに読む
+  CHECK(read_range(direct, unaligned, buf.get(), 2 * align, 0, 0, align) ==
+        static_cast<long long>(2 * align));
+  CHECK(std::memcmp(buf.get(), data.data(), 2 * align) == 0);
+  CHECK(direct_calls == 1);    // 先頭の1000 byte
+  CHECK(unaligned_calls == 8); // 1000 byte目から残りの7192 byte
+
+  // io_uringで一部(1000 byte)を読み込み済みのバッファを、終端まで埋める
+  std::memcpy(buf.get(), data.data() + 2 * align, 1000);
+  CHECK(read_range(direct, unaligned, buf.get(), 2 * align, 2 * align, 1000,
+                   align) == static_cast<long long>(data.size() - 2 * align));
+  CHECK(std::memcmp(buf.get(), data.data() + 2 * align,
+                    data.size() - 2 * align) == 0);
+
+  // 揃っていない位置をO_DIRECTで読めば、EINVALとなる
+  CHECK(read_range(direct, direct, buf.get(), 2 * align, 0, 1000, align) ==
+        -EINVAL);
+}
+
+TEST_CASE("Shasum-Pipeline-FIFO") {
+  // 通常のファイルでなければ、読み込み用のスレッドがread()で読む
+  TempFile file;
+  const std::string fifo = file.path + ".fifo";
+  REQUIRE(::mkfifo(fifo.c_str(), 0600) == 0);
+  const std::string data(100000, 'x');
+  bool written = true;
+  std::thread writer([&] {
+    const int fd = ::open(fifo.c_str(), O_WRONLY);
+    for (std::size_t off = 0; off < data.size(); off += 777) {
+      const std::size_t n = std::min<std::size_t>(777, data.size() - off);
+      written &= ::write(fd, data.data() + off, n) == static_cast<ssize_t>(n);
+    }
+    ::close(fd);
+  });
+  PipelineConfig config;
+  config.buffer_size = 4096;
+  FilePipeline pipeline(fifo, config);
+  CHECK(pipeline.engine() == ReadEngine::Thread);
+  SHA256 hasher;
+  CHECK(pipeline.feed(hasher) == data.size());
+  writer.join();
+  CHECK(written);
+  ::unlink(fifo.c_str());
+  CHECK(hasher.finalize() == SHA256().hash(data.data(), data.size()));
+}
+
+TEST_CASE("Shasum-Tree-Hash") {
+  // テストベクタはtree_hash.hppの出力形式をPython(hashlib)で計算したもの
+  const auto message = [](std::size_t n) {
+    std::vector<std::uint8_t> msg(n);
+    for (std::size_t i = 0; i < n; i++) {
+      msg[i] = static_cast<std::uint8_t>(i * 7 + 3);
+    }
+    return msg;
+  };
+  const std::vector<std::uint8_t> msg = message((std::size_t(3) << 20) + 5);
+
+  // スレッド数や入力の区切り方によらず、同じ値になること
+  const std::size_t threads = GENERATE(1, 4);
+  ThreadPool pool(threads);
+  INFO("threads = " << threads);
+
+  SECTION("Leaf Boundaries") {
+    TreeHash<SHA256> tree(pool, 1024);
+    CHECK_THAT(tree.hash(msg.data(), 0),
+               expect("01eed15d0edf5c23afbec79e87050cd9"
+                      "47f823236418c13f89a84e31e082fdc8"));
+    CHECK_THAT(tree.hash(msg.data(), 1000),
+               expect("d229245123e69d659b410c01d2f77965"
+                      "1e6e4b84602cb0157f87ab84c2056c6c"));
+    CHECK_THAT(tree.hash(msg.data(), 5 * 1024 + 17),
+               expect("1a9b913417add950954154e3bc12dd82"
+                      "47940cae1ccb0f8d1ee8f8b7330658bc"));
+
+    TreeHash<SHA512> tree512(pool, 1024);
+    CHECK_THAT(tree512.hash(msg.data(), 5 * 1024 + 17),
+               expect("4cb0d966d90d2a94460e14c9274f030c"
+                      "7805fbd1b05df8305b67371644b43775"
+                      "54374134fc636cd4c89210daa4d4b324"
+                      "1ff5a5ed7199f0b2b55f98f1f003799c"));
+  }
+
+  SECTION("Streaming") {
+    TreeHash<SHA256> tree(pool);
+    for (std::size_t off = 0, n = 1; off < msg.size(); n = n * 3 + 1) {
+      n = std::min(n, msg.size() - off);
+      tree.update(msg.data() + off, n);
+      off += n;
+    }
+    CHECK_THAT(tree.finalize(),
+               expect("1c5b93a441a1dc59b55916e8d5d0cf64"
+                      "25f4e7c1eb9b385484cb29c93e4df0a3"));
+  }
+
+  SECTION("File") {
+    TempFile file;
+    REQUIRE(::write(file.fd, msg.data(), msg.size()) ==
+            static_cast<ssize_t>(msg.size()));
+    CHECK(hash_file_tree_hex(512, file.path, pool) ==
+          "11ed24a2a4dfd39b05c2bfe0137b3474d95cdbed916d56adc0eec2f240090315"
+          "7e5cf33a0522676adeba71e2783ead8aaa9e2b4926881f313a03f4d899b44bf2");
+  }
+}
+
+TEST_CASE("Shasum-Hex") {
+  // AVX2版(32文字ずつ)とスカラー版(端数)の境界の前後を試す
+  std::string hex;
+  std::vector<std::uint8_t> bytes;
+  for (std::size_t n : {0, 1, 15, 16, 17, 20, 28, 32, 48, 64, 65}) {
+    INFO("n = " << n);
+    hex.resize(2 * n);
+    bytes.resize(n);
+    for (std::size_t i = 0; i < n; i++) {
+      bytes[i] = static_cast<std::uint8_t>(i * 37 + n);
+      std::snprintf(&hex[2 * i], 3, i % 3 == 0 ? "%02X" : "%02x", bytes[i]);
+    }
+    std::vector<std::uint8_t> out(n);
+    CHECK(from_hex(hex.data(), n, out.data()));
+    CHECK(out == bytes);
+    CHECK(from_hex_scalar(hex.data(), n, out.data()));
+    CHECK(out == bytes);
+
+    // どの位置の不正な文字も見逃さない
+    for (std::size_t i = 0; i < 2 * n; i++) {
+      for (char c : {'/', ':', '@', 'G', '`', 'g', ' ', '\0', '\x80', '\xb0'}) {
+        const char saved = hex[i];
+        hex[i] = c;
+        CHECK_FALSE(from_hex(hex.data(), n, out.data()));
+        CHECK_FALSE(from_hex_scalar(hex.data(), n, out.data()));
+        hex[i] = saved;
+      }
+    }
+  }
+
+  SHA256::digest_type digest;
+  CHECK(from_hex("ba7816bf8f01cfea414140de5dae2223"
+                 "b00361a396177a9cb410ff61f20015ad",
+                 digest));
+  CHECK_THAT(digest, expect("ba7816bf 8f01cfea 414140de 5dae2223 b00361a3 "
+                            "96177a9c b410ff61 f20015ad"));
+  CHECK_FALSE(from_hex("ba7816bf", digest));
+}
+
+TEST_CASE("Shasum-Check") {
+  TempFile abc;
+  abc.write("abc");
+  TempFile empty;
+  const std::string sha1_abc = "a9993e364706816aba3e25717850c26c9cd0d89d";
+  const std::string sha1_empty = "da39a3ee5e6b4b0d3255bfef95601890afd80709";
+
+  SECTION("Parse") {
+    const CheckList list = parse_check_list(
+        "# comment\n" + sha1_abc + "  " + abc.path + "\n" +
+            "DA39A3EE5E6B4B0D3255BFEF95601890AFD80709 *binary name\r\n" +
+            "\\" + sha1_abc + "  a\\\\b\\nc\n" + sha1_abc + "  \n" +
+            sha1_abc + " x\n" + "\\" + sha1_abc + "  bad\\escape\n" +
+            "xyz" + sha1_abc.substr(3) + "  xyz\n" + sha1_abc + "  last",
+        SHA1::digest_size);
+    REQUIRE(list.size() == 4);
+    CHECK(list.invalid == 4);
+    CHECK(list.paths[0] == abc.path);
+    CHECK(list.paths[1] == "binary name");
+    CHECK(list.paths[2] == "a\\b\nc");
+    CHECK(list.paths[3] == "last");
+    CHECK(std::equal(list.digest(1), list.digest(2),
+                     SHA1().hash("", 0).begin()));
+
+    bool escaped;
+    CHECK(escape_check_path(list.paths[2], escaped) == "a\\\\b\\nc");
+    CHECK(escaped);
+    CHECK(escape_check_path(list.paths[1], escaped) == "binary name");
+    CHECK_FALSE(escaped);
+  }
+
+  SECTION("Verify") {
+    // 一致、不一致、読めないファイルを並べ、結果がリストの順に届くこと
+    std::string text;
+    for (std::size_t i = 0; i < 50; i++) {
+      text += (i % 7 == 3 ? sha1_empty : sha1_abc) + "  " +
+              (i % 11 == 5 ? abc.path + ".missing" : abc.path) + "\n";
+    }
+    text += sha1_empty + "  " + empty.path + "\n";
+    TempFile list_file;
+    list_file.write(text);
+    const CheckList list =
+        read_check_list(list_file.path, check_digest_size(1));
+    REQUIRE(list.size() == 51);
+
+    const std::size_t threads = GENERATE(1, 4);
+    INFO("threads = " << threads);
+    ThreadPool pool(threads);
+    std::vector<std::pair<std::size_t, CheckStatus>> reports;
+    const CheckSummary summary =
+        check_files(1, list, pool, [&](std::size_t i, CheckStatus s) {
+          reports.emplace_back(i, s);
+        });
+    REQUIRE(reports.size() == list.size());
+    std::size_t failed = 0, unreadable = 0;
+    for (std::size_t i = 0; i < reports.size(); i++) {
+      CHECK(reports[i].first == i);
+      const CheckStatus expected = i == 50       ? CheckStatus::OK
+                                   : i % 11 == 5 ? CheckStatus::Unreadable
+                                   : i % 7 == 3  ? CheckStatus::Failed
+                                                 : CheckStatus::OK;
+      CHECK(reports[i].second == expected);
+      failed += expected == CheckStatus::Failed;
+      unreadable += expected == CheckStatus::Unreadable;
+    }
+    CHECK(summary.failed == failed);
+    CHECK(summary.unreadable == unreadable);
+    CHECK(summary.ok == list.size() - failed - unreadable);
+    CHECK(summary.first_failure >= 0);
+    CHECK(summary.first_failure <= summary.seconds);
+
+    // 全て一致すれば、最初の失敗はない
+    const CheckList ok =
+        parse_check_list(sha1_abc + "  " + abc.path + "\n", SHA1::digest_size);
+    const CheckSummary none =
+        check_files<SHA1>(ok, pool, [](std::size_t, CheckStatus) {});
+    CHECK(none.ok == 1);
+    CHECK(none.first_failure < 0);
+  }
+}
+
+TEST_CASE("Shasum-Digest-Cache") {
+  TempFile file;
+  file.write("abc");
+  const std::string cache_path = file.path + ".cache";
+  const auto cleanup = [&] { ::unlink(cache_path.c_str()); };
+  cleanup();
+
+  // 更新時刻がracy_windowより古いファイルだけが記録される
+  const auto set_mtime = [&](time_t sec, long nsec) {
+    const struct timespec ts[2] = {{sec, nsec}, {sec, nsec}};
+    REQUIRE(::futimens(file.fd, ts) == 0);
+  };
+  const time_t past = ::time(nullptr) - 3600;
+  set_mtime(past, 123);
+
+  // キーだけを指定したstat
+  const auto key = [](std::uint64_t ino, std::int64_t mtime_ns) {
+    struct stat st {};
+    st.st_dev = 1;
+    st.st_ino = ino;
+    st.st_size = 100;
+    st.st_mtim.tv_sec = mtime_ns / 1000000000;
+    st.st_mtim.tv_nsec = mtime_ns % 1000000000;
+    return st;
+  };
+  const std::uint8_t digest[32] = {1, 2, 3};
+  std::uint8_t out[32];
+
+  SECTION("Hit And Miss") {
+    const SHA256::digest_type abc = SHA256().hash("abc", 3);
+    {
+      DigestCache cache(cache_path);
+      CHECK(hash_file<SHA256>(file.path, nullptr, &cache) == abc);
+      CHECK(cache.misses() == 1);
+    }
+    {
+      DigestCache cache(cache_path);
+      CHECK(cache.size() == 1);
+      CHECK(hash_file<SHA256>(file.path, nullptr, &cache) == abc);
+      CHECK(hash_file_hex(1, file.path, nullptr, &cache) ==
+            "a9993e364706816aba3e25717850c26c9cd0d89d");
+      CHECK(cache.hits() == 1);
+      CHECK(cache.misses() == 1);
+    }
+
+    // 大きさと更新時刻を戻すと、書き換えても記録が使われる(キーの定義どおり)
+    REQUIRE(::pwrite(file.fd, "xyz", 3, 0) == 3);
+    set_mtime(past, 123);
+    {
+      DigestCache cache(cache_path);
+      CHECK(hash_file<SHA256>(file.path, nullptr, &cache) == abc);
+    }
+    // 計算し直しを強制すれば正しい値になり、その値が記録される
+    const SHA256::digest_type xyz = SHA256().hash("xyz", 3);
+    {
+      DigestCache cache(cache_path, true);
+      CHECK(hash_file<SHA256>(file.path, nullptr, &cache) == xyz);
+      CHECK(cache.hits() == 0);
+    }
+    {
+      DigestCache cache(cache_path);
+      CHECK(hash_file<SHA256>(file.path, nullptr, &cache) == xyz);
+      CHECK(cache.hits() == 1);
+    }
+
+    // 更新時刻が変われば計算し直す
+    set_mtime(past, 456);
+    DigestCache cache(cache_path);
+    CHECK(hash_file<SHA256>(file.path, nullptr, &cache) == xyz);
+    CHECK(cache.hits() == 0);
+  }
+
+  SECTION("Racy Files") {
+    const time_t now = ::time(nullptr);
+    set_mtime(now, 0);
+    {
+      DigestCache cache(cache_path);
+      hash_file<SHA256>(file.path, nullptr, &cache);
+    }
+    CHECK(DigestCache(cache_path).size() == 0);
+  }
+
+  SECTION("Check Mode") {
+    const CheckList list = parse_check_list(
+        "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad  " +
+            file.path + "\n",
+        SHA256::digest_size);
+    ThreadPool pool(2);
+    const auto ignore = [](std::size_t, CheckStatus) {};
+    {
+      DigestCache cache(cache_path);
+      CHECK(check_files(256, list, pool, ignore, nullptr, &cache).ok == 1);
+    }
+    DigestCache cache(cache_path);
+    CHECK(check_files(256, list, pool, ignore, nullptr, &cache).ok == 1);
+    CHECK(cache.hits() == 1);
+  }
+
+  SECTION("Compaction") {
+    // 10個のファイルを200回ずつ更新した記録は、開いたときに整理される
+    {
+      DigestCache cache(cache_path);
+      for (std::int64_t t = 1; t <= 200; t++) {
+        for (std::uint64_t ino = 0; ino < 10; ino++) {
+          cache.insert(key(ino, t * 1000), 256, digest, 32);
+        }
+      }
+    }
+    struct stat st;
+    REQUIRE(::stat(cache_path.c_str(), &st) == 0);
+    CHECK(st.st_size == 64 + 2000 * 112);
+
+    DigestCache cache(cache_path);
+    CHECK(cache.size() == 10);
+    REQUIRE(::stat(cache_path.c_str(), &st) == 0);
+    CHECK(st.st_size == 64 + 10 * 112);
+    CHECK(cache.lookup(key(3, 200000), 256, out, 32));
+    CHECK(std::equal(out, out + 32, digest));
+    CHECK_FALSE(cache.lookup(key(3, 199000), 256, out, 32));
+    CHECK_FALSE(cache.lookup(key(3, 200000), 1, out, 20));
+  }
+
+  SECTION("Torn And Foreign Files") {
+    {
+      DigestCache cache(cache_path);
+      cache.insert(key(1, 1000), 256, digest, 32);
+    }
+    // 書きかけのレコードを読み飛ばし、次の追記は境界を揃えて書く
+    {
+      const int fd = ::open(cache_path.c_str(), O_WRONLY | O_APPEND);
+      REQUIRE(::write(fd, digest, 30) == 30);
+      ::close(fd);
+      DigestCache cache(cache_path);
+      CHECK(cache.size() == 1);
+      cache.insert(key(2, 1000), 256, digest, 32);
+    }
+    CHECK(DigestCache(cache_path).size() == 2);
+
+    // 形式の異なるファイルは空とみなし、次の追記で置き換える
+    {
+      const int fd = ::open(cache_path.c_str(), O_WRONLY | O_TRUNC);
+      REQUIRE(::write(fd, "not a cache\n", 12) == 12);
+      ::close(fd);
+      DigestCache cache(cache_path);
+      CHECK(cache.size() == 0);
+      cache.insert(key(3, 1000), 256, digest, 32);
+    }
+    DigestCache cache(cache_path);
+    CHECK(cache.size() == 1);
+    CHECK(cache.lookup(key(3, 1000), 256, out, 32));
+  }
+
+  SECTION("Concurrent Writers") {
+    // 一方が整理して置き換えた後も、もう一方の追記は新しいファイルに届く
+    DigestCache a(cache_path);
+    DigestCache b(cache_path);
+    a.insert(key(1, 1000), 256, digest, 32);
+    REQUIRE(a.flush());
+    b.insert(key(2, 1000), 256, digest, 32);
+    REQUIRE(b.flush());
+    a.compact();
+    b.insert(key(3, 1000), 256, digest, 32);
+    REQUIRE(b.flush());
+
+    // 開いた時点の記録は、置き換えられた後も読める
+    CHECK_FALSE(a.lookup(key(1, 1000), 256, out, 32));
+    DigestCache c(cache_path);
+    CHECK(c.size() == 3);
+  }
+
+  cleanup();
+}
@@ -0,0 +1,224 @@
+/**
+ * @brief sha1sum/sha256sum/sha512sumと同じ形式でファイルのハッシュ値を表示する
+ * @note  使い方: shasum [-a 1|224|256|384|512|512224|512256] [-t] [-p] [-d]
+ *                       [FILE]...
+ *        FILEを省略するか"-"を指定すると標準入力を読む
+ *        -tを指定すると木モード(SHA256/SHA512のみ)で全てのコアを使う
+ *        -pを指定するとmmapの代わりに先行読み込み(io_uring)で読む
+ *        -dは-pに加えてO_DIRECTでページキャッシュを経由せずに読む
+ *        sha256sumなどの名前で起動した場合は、その名前からアルゴリズムを決める
+ *        -cを指定するとFILEを検証リスト(sha256sumなどの出力)として読み、
+ *        記載されたファイルを-jのスレッド数(既定は全てのコア)で並列に検証する
+ *        -qを指定すると一致したファイルを表示しない
+ *        -C CACHEを指定すると、ハッシュ値をCACHEに記録し、次回から変わっていない
+ *        ファイル(デバイス, inode, 大きさ, 更新時刻が同じ)の計算を省く
+ *        -fは-Cに加えて記録を使わずに計算し直す(結果は記録する)
+ */
+
+#include "check.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+
+namespace {
+
+int usage(const char *prog) {
+  std::fprintf(stderr,
+               "usage: %s [-a 1|224|256|384|512|512224|512256] [-t] [-p] "
+               "[-d] [-C CACHE [-f]] [FILE]...\n"
+               "       %s -c [-a ...] [-j THREADS] [-q] [-p] [-d] "
+               "[-C CACHE [-f]] [FILE]...\n",
+               prog, prog);
+  return 2;
+}
+
+int bits_from_name(const char *prog) {
+  const char *base = std::strrchr(prog, '/');
+  base = base != nullptr ? base + 1 : prog;
+  if (std::strncmp(base, "sha1sum", 7) == 0) {
+    return 1;
+  }
+  if (std::strncmp(base, "sha224sum", 9) == 0) {
+    return 224;
+  }
+  if (std::strncmp(base, "sha384sum", 9) == 0) {
+    return 384;
+  }
+  if (std::strncmp(base, "sha512sum", 9) == 0) {
+    return 512;
+  }
+  return 256;
+}
+
+/**
+ * @brief  検証リストのファイルを検証し、結果を表示する
+ * @return 全て一致すればtrue
+ */
+bool check(const char *prog, int bits, const std::string &path,
+           ThreadPool &pool, bool quiet, const PipelineConfig *read,
+           DigestCache *cache) {
+  const CheckList list = read_check_list(path, check_digest_size(bits));
+  if (list.size() == 0) {
+    std::fprintf(stderr, "%s: %s: no properly formatted checksum lines found\n",
+                 prog, path.c_str());
+    return false;
+  }
+
+  const auto report = [&](std::size_t i, CheckStatus s) {
+    if (quiet && s == CheckStatus::OK) {
+      return;
+    }
+    bool escaped;
+    const std::string name = escape_check_path(list.paths[i], escaped);
+    std::printf("%s%s: %s\n", escaped ? "\\" : "", name.c_str(),
+                s == CheckStatus::OK       ? "OK"
+                : s == CheckStatus::Failed ? "FAILED"
+                                           : "FAILED open or read");
+  };
+  const CheckSummary summary =
+      check_files(bits, list, pool, report, read, cache);
+  std::fflush(stdout);
+
+  if (list.invalid > 0) {
+    std::fprintf(stderr, "%s: WARNING: %zu line(s) improperly formatted\n",
+                 prog, list.invalid);
+  }
+  if (summary.unreadable > 0) {
+    std::fprintf(stderr, "%s: WARNING: %zu listed file(s) could not be read\n",
+                 prog, summary.unreadable);
+  }
+  if (summary.failed > 0) {
+    std::fprintf(stderr,
+                 "%s: WARNING: %zu computed checksum(s) did NOT match\n", prog,
+                 summary.failed);
+  }
+  if (summary.first_failure >= 0) {
+    std::fprintf(stderr, "%s: first failure after %.3f s\n", prog,
+                 summary.first_failure);
+  }
+  std::fprintf(stderr, "%s: %zu file(s) checked in %.3f s\n", prog,
+               list.size(), summary.seconds);
+  return summary.failed == 0 && summary.unreadable == 0;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  int bits = bits_from_name(argv[0]);
+  bool tree = false;
+  bool checking = false;
+  bool quiet = false;
+  std::size_t threads = 0;
+  const char *cache_path = nullptr;
+  bool rehash = false;
+  PipelineConfig config;
+  bool pipeline = false;
+  int i = 1;
+  for (; i < argc && argv[i][0] == '-' && argv[i][1] != '\0'; i++) {
+    if (std::strcmp(argv[i], "--") == 0) {
+      i++;
+      break;
+    }
+    if (std::strcmp(argv[i], "-t") == 0) {
+      tree = true;
+      continue;
+    }
+    if (std::strcmp(argv[i], "-c") == 0) {
+      checking = true;
+      continue;
+    }
+    if (std::strcmp(argv[i], "-q") == 0) {
+      quiet = true;
+      continue;
+    }
+    if (std::strcmp(argv[i], "-C") == 0 && i + 1 < argc) {
+      cache_path = argv[++i];
+      continue;
+    }
+    if (std::strcmp(argv[i], "-f") == 0) {
+      rehash = true;
+      continue;
+    }
+    if (std::strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+      threads = std::strtoul(argv[++i], nullptr, 10);
+      continue;
+    }
+    if (std::strcmp(argv[i], "-p") == 0 || std::strcmp(argv[i], "-d") == 0) {
+      pipeline = true;
+      config.direct = config.direct || argv[i][1] == 'd';
+      continue;
+    }
+    if (std::strcmp(argv[i], "-a") != 0 || i + 1 == argc) {
+      return usage(argv[0]);
+    }
+    bits = std::atoi(argv[++i]);
+    switch (bits) {
+    case 1:
+    case 224:
+    case 256:
+    case 384:
+    case 512:
+    case 512224:
+    case 512256:
+      break;
+    default:
+      return usage(argv[0]);
+    }
+  }
+
+  if (tree && (checking || pipeline || cache_path != nullptr ||
+               (bits != 256 && bits != 512))) {
+    return usage(argv[0]);
+  }
+  if (rehash && cache_path == nullptr) {
+    return usage(argv[0]);
+  }
+
+  std::vector<std::string> files(argv + i, argv + argc);
+  if (files.empty()) {
+    files.push_back("-");
+  }
+
+  const PipelineConfig *read = pipeline ? &config : nullptr;
+  std::unique_ptr<DigestCache> cache;
+  if (cache_path != nullptr) {
+    try {
+      cache = std::make_unique<DigestCache>(cache_path, rehash);
+    } catch (const std::system_error &e) {
+      std::fprintf(stderr, "%s: %s\n", argv[0], e.what());
+      return EXIT_FAILURE;
+    }
+  }
+
+  ThreadPool pool(tree || checking ? threads : 1);
+  int status = EXIT_SUCCESS;
+  for (auto &&path : files) {
+    try {
+      if (checking) {
+        if (!check(argv[0], bits, path, pool, quiet, read, cache.get())) {
+          status = EXIT_FAILURE;
+        }
+        continue;
+      }
+      const std::string hex = tree ? hash_file_tree_hex(bits, path, pool)
+                                   : hash_file_hex(bits, path, read,
+                                                   cache.get());
+      std::printf("%s  %s\n", hex.c_str(), path.c_str());
+    } catch (const std::system_error &e) {
+      std::fprintf(stderr, "%s: %s\n", argv[0], e.what());
+      status = EXIT_FAILURE;
+    }
+  }
+  if (cache != nullptr) {
+    std::fflush(stdout);
+    std::fprintf(stderr, "%s: cache: %llu hit(s), %llu miss(es)\n", argv[0],
+                 static_cast<unsigned long long>(cache->hits()),
+                 static_cast<unsigned long long>(cache->misses()));
+    if (!cache->flush()) {
+      std::fprintf(stderr, "%s: %s: could not update the cache\n", argv[0],
+                   cache_path);
+    }
+  }
+  return status;
+}
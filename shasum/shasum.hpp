@@ -0,0 +1,130 @@
+/**
+ * @brief sha1sum/sha256sum/sha512sumに相当するファイルのハッシュ計算
+ * @note  通常のファイルはmmapしてコピーせずに圧縮し(小さなファイルはread())、
+ *        パイプや標準入力は固定長のバッファに少しずつ読み込む(stream_hasher.hpp)
+ *        PipelineConfigを渡すと、mmapの代わりに複数のバッファを先行して読み込む
+ *        (file_pipeline.hpp, io_uringとO_DIRECT)
+ *        木モード(tree_hash.hpp)では1つのファイルを全てのコアで計算する
+ *        DigestCacheを渡すと、変わっていないファイルは記録したハッシュ値を使う
+ *        (digest_cache.hpp)
+ */
+
+#ifndef SHASUM_HPP
+#define SHASUM_HPP
+
+#include "../digest_cache.hpp"
+#include "../file_pipeline.hpp"
+#include "../hex.hpp"
+#include "../mapped_file.hpp"
+#include "../sha1/sha1.hpp"
+#include "../sha2/sha2.hpp"
+#include "../stream_hasher.hpp"
+#include "../tree_hash.hpp"
+#include <string>
+
+/**
+ * @brief  ファイルのハッシュ値を求める
+ * @param  const std::string& path ファイルのパス("-"なら標準入力)
+ * @param  const PipelineConfig* pipeline 先行読み込みの設定(nullptrならmmap)
+ * @param  DigestCache* cache 記録したハッシュ値のキャッシュ(nullptrなら使わない)
+ * @note   開けない、あるいは読めなければstd::system_errorを送出する
+ */
+template <class Hasher>
+typename Hasher::digest_type hash_file(const std::string &path,
+                                       const PipelineConfig *pipeline = nullptr,
+                                       DigestCache *cache = nullptr) {
+  if (cache != nullptr && path != "-") {
+    return hash_cached<Hasher>(
+        cache, path, [&] { return hash_file<Hasher>(path, pipeline); });
+  }
+  Hasher hasher;
+  if (path == "-") {
+    feed_stream(hasher, STDIN_FILENO, thread_stream_buffer(), path);
+    return hasher.finalize();
+  }
+  if (pipeline != nullptr) {
+    feed_pipeline(hasher, path, *pipeline);
+    return hasher.finalize();
+  }
+  StreamBuffer &buffer = thread_stream_buffer();
+  const MappedFile file(path, buffer.size() + 1);
+  if (file.mapped()) {
+    file.feed(hasher);
+  } else {
+    feed_stream(hasher, file.descriptor(), buffer, path);
+  }
+  return hasher.finalize();
+}
+
+/**
+ * @brief  ファイルの木モードのハッシュ値を求める
+ * @note   マップしたファイル全体を一度に渡し、全ての葉を並列に計算させる
+ */
+template <class Hasher>
+typename Hasher::digest_type hash_file_tree(const std::string &path,
+                                            ThreadPool &pool) {
+  TreeHash<Hasher> tree(pool);
+  if (path == "-") {
+    feed_stream(tree, STDIN_FILENO, thread_stream_buffer(), path);
+    return tree.finalize();
+  }
+  const MappedFile file(path);
+  if (file.mapped()) {
+    try {
+      tree.update(file.data(), file.size());
+    } catch (const std::system_error &e) {
+      throw std::system_error(e.code(), path + " (truncated while mapped)");
+    }
+  } else {
+    feed_stream(tree, file.descriptor(), thread_stream_buffer(), path);
+  }
+  return tree.finalize();
+}
+
+/**
+ * @brief  アルゴリズムを指定してファイルのハッシュ値を16進数文字列で求める
+ * @param  int bits 1, 224, 256, 384, 512, 512224, 512256のいずれか
+ *         (512224, 512256はSHA-512/224, SHA-512/256, shasum(1)と同じ表記)
+ * @return 未対応のアルゴリズムであれば空文字列
+ */
+inline std::string hash_file_hex(int bits, const std::string &path,
+                                 const PipelineConfig *pipeline = nullptr,
+                                 DigestCache *cache = nullptr) {
+  switch (bits) {
+  case 1:
+    return to_hex(hash_file<SHA1>(path, pipeline, cache));
+  case 224:
+    return to_hex(hash_file<SHA224>(path, pipeline, cache));
+  case 256:
+    return to_hex(hash_file<SHA256>(path, pipeline, cache));
+  case 384:
+    return to_hex(hash_file<SHA384>(path, pipeline, cache));
+  case 512:
+    return to_hex(hash_file<SHA512>(path, pipeline, cache));
+  case 512224:
+    return to_hex(hash_file<SHA512_224>(path, pipeline, cache));
+  case 512256:
+    return to_hex(hash_file<SHA512_256>(path, pipeline, cache));
+  default:
+    return std::string();
+  }
+}
+
+/**
+ * @brief  ファイルの木モードのハッシュ値を16進数文字列で求める
+ * @param  int bits 256, 512のいずれか
+ * @return 未対応のアルゴリズムであれば空文字列
+ */
+inline std::string hash_file_tree_hex(int bits, const std::string &path,
+                                      ThreadPool &pool) {
+  switch (bits) {
+  case 256:
+    return to_hex(hash_file_tree<SHA256>(path, pool));
+  case 512:
+    return to_hex(hash_file_tree<SHA512>(path, pool));
+  default:
+    return std::string();
+  }
+}
+
+#endif // end of SHASUM_HPP
@@ -0,0 +1,271 @@
+/**
+ * @brief ハッシュ計算の統計(圧縮したブロック数、取り込んだbyte数、バックエンド、
+ *        圧縮とパディング/コピーにかかった時間、呼び出しの長さごとの遅延)
+ * @note  コンパイル時にSHA_STATSで有効にする
+ *          SHA_STATS=0 (既定) 何も記録しない。計測のコードは生成されない
+ *          SHA_STATS=1        カウンタと時間を記録する
+ *          SHA_STATS=2        加えて、hash()の遅延をメッセージ長ごとの
+ *                             ヒストグラムに記録する
+ *        カウンタはrelaxedなatomicなので、計算中の他のスレッドから
+ *        いつでもstats_json()で書き出せる
+ *        時間の単位はTSC(x86のrdtsc)、それ以外ではnsとする
+ */
+
+#ifndef STATS_HPP
+#define STATS_HPP
+
+#include "cpu.hpp"
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+#ifndef SHA_STATS
+#define SHA_STATS 0
+#endif
+
+/**< @brief カウンタと時間を記録するか */
+inline constexpr bool stats_enabled = SHA_STATS >= 1;
+
+/**< @brief hash()の遅延のヒストグラムを記録するか */
+inline constexpr bool stats_histogram_enabled = SHA_STATS >= 2;
+
+/**
+ * @brief  時間の計測に使う刻み(x86ではTSC、それ以外ではns)を読む
+ */
+inline std::uint64_t stats_ticks() {
+#ifdef SHA_X86
+  return __rdtsc();
+#else
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+#endif
+}
+
+/**
+ * @brief  ヒストグラムの階級(0なら0、それ以外は2進数の桁数)を求める
+ * @note   階級kには[2^(k-1), 2^k)の値が入り、上限を超えた値は最後の階級に入る
+ */
+inline std::size_t stats_bucket(std::uint64_t x, std::size_t buckets) {
+  std::size_t k = 0;
+  for (; x > 0; x >>= 1) {
+    k++;
+  }
+  return k < buckets ? k : buckets - 1;
+}
+
+/**
+ * @brief 1つのアルゴリズムの統計
+ * @note  各ハッシュクラスが静的に1つずつ持つ(SHA-2の派生版はコアのものに記録する)
+ *        定数で初期化されるので、無効なときも起動時のコストはない
+ */
+struct HashStats {
+  using Counter = std::atomic<std::uint64_t>;
+
+  /**< @brief ヒストグラムのメッセージ長の階級数(最後の階級は1 GiB以上) */
+  static constexpr std::size_t size_buckets = 32;
+
+  /**< @brief ヒストグラムの遅延の階級数 */
+  static constexpr std::size_t latency_buckets = 48;
+
+  constexpr explicit HashStats(const char *name) : name(name) {}
+
+  /**< @brief アルゴリズム名 */
+  const char *name;
+
+  /**< @brief 最後に選択されたcompress()のバックエンド */
+  std::atomic<int> backend{static_cast<int>(Backend::Scalar)};
+
+  /**< @brief update()で取り込んだbyte数 */
+  Counter bytes{0};
+
+  /**< @brief 圧縮したブロック数(バックエンドごと) */
+  std::array<Counter, 4> blocks{};
+
+  /**< @brief compress()にかかった時間 */
+  Counter compress_ticks{0};
+
+  /**< @brief update()のバッファへのコピーとfinalize()のパディングにかかった時間 */
+  Counter copy_ticks{0};
+
+  /**< @brief hash()の呼び出し回数と遅延(latency[メッセージ長の階級][遅延の階級]) */
+  std::array<std::array<Counter, latency_buckets>,
+             stats_histogram_enabled ? size_buckets : 0>
+      latency{};
+
+  /**
+   * @brief  カウンタに加える(統計が無効なら何もしない)
+   * @note   記録する関数は全てこれを通すので、無効なときは呼び出しごと消える
+   */
+  void add(Counter &c, std::uint64_t x) {
+    if constexpr (stats_enabled) {
+      c.fetch_add(x, std::memory_order_relaxed);
+    }
+  }
+
+  /**
+   * @brief  選択されたバックエンドを記録する
+   */
+  void select(Backend b) {
+    if constexpr (stats_enabled) {
+      backend.store(static_cast<int>(b), std::memory_order_relaxed);
+    }
+  }
+
+  /**
+   * @brief  圧縮したブロック数を記録する
+   */
+  void add_blocks(Backend b, std::uint64_t n) {
+    add(blocks[static_cast<std::size_t>(b)], n);
+  }
+
+  /**
+   * @brief  hash()の遅延をヒストグラムに記録する
+   */
+  void add_latency(std::uint64_t len, std::uint64_t ticks) {
+    if constexpr (stats_histogram_enabled) {
+      add(latency[stats_bucket(len, size_buckets)]
+                 [stats_bucket(ticks, latency_buckets)],
+          1);
+    }
+  }
+
+  /**
+   * @brief  全てのカウンタを0に戻す
+   * @note   他のスレッドが計算中なら、その分は残ることがある
+   */
+  void reset() {
+    bytes = 0;
+    for (auto &&c : blocks) {
+      c = 0;
+    }
+    compress_ticks = 0;
+    copy_ticks = 0;
+    for (auto &&row : latency) {
+      for (auto &&c : row) {
+        c = 0;
+      }
+    }
+  }
+
+  /**
+   * @brief  全てのバックエンドで圧縮したブロック数
+   */
+  std::uint64_t total_blocks() const {
+    std::uint64_t n = 0;
+    for (auto &&c : blocks) {
+      n += c.load(std::memory_order_relaxed);
+    }
+    return n;
+  }
+
+  /**
+   * @brief  統計をJSONのオブジェクト1つにする
+   * @note   ヒストグラムは0でない階級だけを
+   *         {"size": 階級, "latency": 階級, "count": 回数}の配列で書き出す
+   */
+  std::string json() const {
+    const auto get = [](const Counter &c) {
+      return static_cast<unsigned long long>(
+          c.load(std::memory_order_relaxed));
+    };
+    char buf[512];
+    std::snprintf(buf, sizeof(buf),
+                  "{\"algorithm\": \"%s\", \"backend\": \"%s\", "
+                  "\"bytes\": %llu, \"blocks\": {",
+                  name, backend_name(static_cast<Backend>(backend.load())),
+                  get(bytes));
+    std::string s = buf;
+    for (std::size_t b = 0; b < blocks.size(); b++) {
+      std::snprintf(buf, sizeof(buf), "%s\"%s\": %llu", b > 0 ? ", " : "",
+                    backend_name(static_cast<Backend>(b)), get(blocks[b]));
+      s += buf;
+    }
+    std::snprintf(buf, sizeof(buf),
+                  "}, \"compress_ticks\": %llu, \"copy_ticks\": %llu, "
+                  "\"latency\": [",
+                  get(compress_ticks), get(copy_ticks));
+    s += buf;
+    bool first = true;
+    for (std::size_t i = 0; i < latency.size(); i++) {
+      for (std::size_t j = 0; j < latency[i].size(); j++) {
+        if (get(latency[i][j]) == 0) {
+          continue;
+        }
+        std::snprintf(buf, sizeof(buf),
+                      "%s{\"size\": %zu, \"latency\": %zu, \"count\": %llu}",
+                      first ? "" : ", ", i, j, get(latency[i][j]));
+        s += buf;
+        first = false;
+      }
+    }
+    return s + "]}";
+  }
+};
+
+/**
+ * @brief 区間の時間をカウンタに加えるタイマ(スコープを抜けると記録する)
+ * @note  統計が無効ならStatsTimer<false>となり、何も計測しない
+ */
+template <bool Enabled = stats_enabled> class StatsTimer {
+public:
+  StatsTimer(HashStats &s, HashStats::Counter HashStats::*c)
+      : s(s), c(c), start(stats_ticks()) {}
+
+  ~StatsTimer() { s.add(s.*c, stats_ticks() - start); }
+
+  StatsTimer(const StatsTimer &) = delete;
+  StatsTimer &operator=(const StatsTimer &) = delete;
+
+private:
+  HashStats &s;
+  HashStats::Counter HashStats::*c;
+  std::uint64_t start;
+};
+
+template <> class StatsTimer<false> {
+public:
+  StatsTimer(HashStats &, HashStats::Counter HashStats::*) {}
+};
+
+/**
+ * @brief  統計を持つアルゴリズムの一覧
+ * @note   各ハッシュクラスが静的初期化の際に登録する(無効なときは登録しない)
+ */
+struct StatsRegistry {
+  static constexpr std::size_t capacity = 8;
+  std::array<HashStats *, capacity> entries{};
+  std::atomic<std::size_t> size{0};
+};
+
+inline StatsRegistry stats_registry;
+
+/**
+ * @brief  統計を一覧に登録する
+ */
+inline bool stats_register(HashStats &s) {
+  const std::size_t i = stats_registry.size.load();
+  if (i < StatsRegistry::capacity) {
+    stats_registry.entries[i] = &s;
+    stats_registry.size = i + 1;
+  }
+  return true;
+}
+
+/**
+ * @brief  登録された全てのアルゴリズムの統計をJSONの配列にする
+ * @note   実行中のプロセスから、任意のスレッドでいつでも呼び出せる
+ */
+inline std::string stats_json() {
+  std::string s = "[";
+  for (std::size_t i = 0; i < stats_registry.size.load(); i++) {
+    s += (i > 0 ? ",\n " : "") + stats_registry.entries[i]->json();
+  }
+  return s + "]\n";
+}
+
+#endif // end of STATS_HPP
@@ -0,0 +1,152 @@
+/**
+ * @brief ハッシュ計算の統計のテストプログラム
+ * @note  SHA_STATS=2(カウンタとヒストグラム)でコンパイルする
+ */
+
+#define CATCH_CONFIG_MAIN // This tells Catch to provide a main() - only do this
+                          // in one cpp file
+#include "../alloc_counter.hpp"
+#include "../matcher.hpp"
+#include "../sha1/sha1.hpp"
+#include "../sha2/sha2.hpp"
+#include "../sha256/sha256.hpp"
+#include "../sha512/sha512.hpp"
+#include <numeric>
+
+namespace {
+
+/**
+ * @brief  メッセージ長の階級sizeで記録されたhash()の回数
+ */
+std::uint64_t latency_count(const HashStats &s, std::size_t size) {
+  std::uint64_t n = 0;
+  for (auto &&c : s.latency[size]) {
+    n += c.load();
+  }
+  return n;
+}
+
+} // namespace
+
+TEST_CASE("Stats-Bucket") {
+  STATIC_REQUIRE(stats_enabled);
+  STATIC_REQUIRE(stats_histogram_enabled);
+  CHECK(stats_bucket(0, 32) == 0);
+  CHECK(stats_bucket(1, 32) == 1);
+  CHECK(stats_bucket(63, 32) == 6);
+  CHECK(stats_bucket(64, 32) == 7);
+  CHECK(stats_bucket(std::uint64_t(1) << 40, 32) == 31);
+}
+
+TEMPLATE_TEST_CASE("Stats-Counters", "", SHA1, SHA256, SHA512) {
+  auto &s = TestType::stats();
+  const Backend original = TestType::backend();
+  const std::string msg(1000, 'a');
+  for (Backend b :
+       {Backend::Scalar, Backend::SHANI, Backend::AVX2, Backend::AVX512}) {
+    if (!TestType::set_backend(b)) {
+      continue;
+    }
+    s.reset();
+    CHECK(s.backend == static_cast<int>(b));
+
+    // 1000 = 7 + 993 byteに分けて取り込み、端数のコピーとパディングを通す
+    TestType ctx;
+    ctx.update(msg.data(), 7);
+    ctx.update(msg.data() + 7, msg.size() - 7);
+    ctx.finalize();
+
+    const std::size_t length_size = TestType::block_size / 8;
+    CHECK(s.bytes == 1000);
+    CHECK(s.blocks[static_cast<std::size_t>(b)] ==
+          (1000 + length_size) / TestType::block_size + 1);
+    CHECK(s.total_blocks() == s.blocks[static_cast<std::size_t>(b)]);
+    CHECK(s.compress_ticks > 0);
+    CHECK(s.copy_ticks > 0);
+  }
+  TestType::set_backend(original);
+}
+
+TEMPLATE_TEST_CASE("Stats-Latency", "", SHA1, SHA256, SHA512) {
+  auto &s = TestType::stats();
+  s.reset();
+  const std::string msg(100, 'a');
+  for (int i = 0; i < 5; i++) {
+    TestType().hash(msg.data(), msg.size());
+  }
+  TestType().hash(msg.data(), 0);
+
+  // 100 byteは階級7([64, 128))、0 byteは階級0に入る
+  CHECK(latency_count(s, stats_bucket(100, HashStats::size_buckets)) == 5);
+  CHECK(latency_count(s, 0) == 1);
+  std::uint64_t total = 0;
+  for (std::size_t i = 0; i < HashStats::size_buckets; i++) {
+    total += latency_count(s, i);
+  }
+  CHECK(total == 6);
+
+  // 統計を記録してもヒープは確保しない
+  const std::size_t before = allocation_count.load();
+  TestType().hash(msg.data(), msg.size());
+  CHECK(allocation_count.load() == before);
+}
+
+TEST_CASE("Stats-Batch") {
+  const Backend original = SHA256::batch_backend();
+  std::vector<std::string> msgs;
+  for (std::size_t i = 0; i < 37; i++) {
+    msgs.push_back(std::string(i * 13, 'x'));
+  }
+  std::vector<const void *> data;
+  std::vector<std::size_t> len;
+  for (auto &&m : msgs) {
+    data.push_back(m.data());
+    len.push_back(m.size());
+  }
+  const std::uint64_t bytes =
+      std::accumulate(len.begin(), len.end(), std::uint64_t(0));
+  std::uint64_t blocks = 0;
+  for (auto n : len) {
+    blocks += (n + 8) / SHA256::block_size + 1;
+  }
+
+  std::vector<SHA256::digest_type> M(msgs.size());
+  for (Backend b : {Backend::Scalar, Backend::AVX2, Backend::AVX512}) {
+    if (!SHA256::set_batch_backend(b)) {
+      continue;
+    }
+    SHA256::stats().reset();
+    SHA256::hash_many(msgs.size(), data.data(), len.data(), M.data());
+    CHECK(SHA256::stats().bytes == bytes);
+    CHECK(SHA256::stats().total_blocks() == blocks);
+    // 残りが少なくなったレーンはcompress()で仕上げるので、一部は
+    // compress()のバックエンドに記録される
+    if (b != Backend::Scalar) {
+      CHECK(SHA256::stats().blocks[static_cast<std::size_t>(b)] > 0);
+    }
+  }
+  SHA256::set_batch_backend(original);
+}
+
+TEST_CASE("Stats-Variants") {
+  // SHA-2の派生版はコアの統計に記録する
+  SHA256::stats().reset();
+  SHA512::stats().reset();
+  SHA224().hash("abc");
+  SHA512_256().hash("abc");
+  CHECK(SHA256::stats().bytes == 3);
+  CHECK(SHA512::stats().bytes == 3);
+}
+
+TEST_CASE("Stats-JSON") {
+  SHA256::stats().reset();
+  SHA256().hash("abc");
+  const std::string json = stats_json();
+  CHECK(json.front() == '[');
+  for (const char *name : {"\"sha1\"", "\"sha256\"", "\"sha512\""}) {
+    CHECK(json.find(name) != std::string::npos);
+  }
+  const std::string s = SHA256::stats().json();
+  CHECK(s.find("\"bytes\": 3,") != std::string::npos);
+  CHECK(s.find("\"latency\": [{\"size\": 2, ") != std::string::npos);
+}
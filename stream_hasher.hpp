@@ -0,0 +1,151 @@
+/**
+ * @brief 長さのわからない入力(標準入力、パイプ、std::istream)を一定のメモリで
+ *        ハッシュ化する
+ * @note  4096byte境界に揃えた固定長のバッファを1つだけ確保して使い回すので、
+ *        入力がどれだけ長くてもメモリの使用量は変わらない
+ *        ディスクリプタの種類に応じて、コピーとシステムコールを減らす
+ *          通常のファイル(shasum - < FILEなど): mmapしてコピーせずに渡す
+ *                  (バッファに収まる小さなファイルは、1回のread()で読む)
+ *          パイプ: 容量をpipe_size(F_SETPIPE_SZ)まで広げ、1回のread()で
+ *                  読める量を増やして書き手との切り替えを減らす
+ * @note  splice/vmspliceはパイプのページを別のパイプやファイルへ移すもので、
+ *        ユーザ空間で読むにはどこかで1回のコピーが必要になる
+ *        (memfdへspliceしてmmapで読む方法は、read()より2割ほど遅かった)
+ *        そのため使わず、コピーが1回で済むread()を使う
+ */
+
+#ifndef STREAM_HASHER_HPP
+#define STREAM_HASHER_HPP
+
+#include "mapped_file.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <istream>
+#include <memory>
+#include <new>
+#include <string>
+#include <system_error>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/**
+ * @brief 読み込みに使い回す、境界を揃えた固定長のバッファ
+ */
+class StreamBuffer {
+public:
+  /**< @brief バッファの境界と大きさの単位 */
+  static constexpr std::size_t alignment = 4096;
+
+  /**< @brief 既定の大きさ */
+  static constexpr std::size_t default_size = std::size_t(1) << 18;
+
+  /**
+   * @param  std::size_t size バッファのbyte数(alignmentの倍数に切り上げる)
+   */
+  explicit StreamBuffer(std::size_t size = default_size)
+      : len(size == 0 ? alignment
+                      : (size + alignment - 1) / alignment * alignment),
+        buf(static_cast<std::uint8_t *>(std::aligned_alloc(alignment, len))) {
+    if (buf == nullptr) {
+      throw std::bad_alloc();
+    }
+  }
+
+  std::uint8_t *data() { return buf.get(); }
+  std::size_t size() const { return len; }
+
+private:
+  struct Free {
+    void operator()(std::uint8_t *p) const { std::free(p); }
+  };
+
+  std::size_t len;
+  std::unique_ptr<std::uint8_t, Free> buf;
+};
+
+/**
+ * @brief  呼び出したスレッドのStreamBuffer(初回に確保し、以後は使い回す)
+ */
+inline StreamBuffer &thread_stream_buffer() {
+  thread_local StreamBuffer buffer;
+  return buffer;
+}
+
+/**< @brief 入力のパイプの容量をここまで広げる(byte) */
+inline constexpr int pipe_size = 1 << 20;
+
+/**
+ * @brief  std::istreamから終端まで読み込み、hasherに渡す
+ * @return 読み込んだbyte数
+ * @note   読み込みに失敗(badbit)するとstd::system_error(EIO)を送出する
+ */
+template <class Hasher>
+std::uint64_t feed_stream(Hasher &hasher, std::istream &in,
+                          StreamBuffer &buffer) {
+  std::uint64_t total = 0;
+  while (in) {
+    in.read(reinterpret_cast<char *>(buffer.data()),
+            static_cast<std::streamsize>(buffer.size()));
+    const auto n = static_cast<std::size_t>(in.gcount());
+    hasher.update(buffer.data(), n);
+    total += n;
+  }
+  if (in.bad()) {
+    throw std::system_error(EIO, std::generic_category(), "istream");
+  }
+  return total;
+}
+
+/**
+ * @brief  ファイルディスクリプタの現在位置から終端まで読み込み、hasherに渡す
+ * @param  const std::string& name エラーメッセージに使う名前
+ * @return 読み込んだbyte数
+ * @note   先頭にある通常のファイルは、バッファより大きければmmapしてコピーせずに渡す
+ *         読み込みに失敗するとstd::system_errorを送出する
+ */
+template <class Hasher>
+std::uint64_t feed_stream(Hasher &hasher, int fd, StreamBuffer &buffer,
+                          const std::string &name) {
+  struct stat st;
+  if (::fstat(fd, &st) == 0) {
+    if (S_ISREG(st.st_mode) &&
+        static_cast<std::uint64_t>(st.st_size) > buffer.size() &&
+        ::lseek(fd, 0, SEEK_CUR) == 0) {
+      const MappedFile file(fd, name);
+      if (file.mapped()) {
+        file.feed(hasher);
+        ::lseek(fd, 0, SEEK_END);
+        return file.size();
+      }
+    } else if (S_ISFIFO(st.st_mode)) {
+      // 広げられなければ(上限を超える、権限がないなど)そのまま読む
+      ::fcntl(fd, F_SETPIPE_SZ, pipe_size);
+    }
+  }
+  return feed_descriptor(hasher, fd, name, buffer.data(), buffer.size());
+}
+
+/**
+ * @brief  std::istreamの終端までのハッシュ値を求める
+ */
+template <class Hasher>
+typename Hasher::digest_type hash_stream(std::istream &in) {
+  Hasher hasher;
+  feed_stream(hasher, in, thread_stream_buffer());
+  return hasher.finalize();
+}
+
+/**
+ * @brief  ファイルディスクリプタの現在位置から終端までのハッシュ値を求める
+ */
+template <class Hasher>
+typename Hasher::digest_type hash_stream(int fd, const std::string &name) {
+  Hasher hasher;
+  feed_stream(hasher, fd, thread_stream_buffer(), name);
+  return hasher.finalize();
+}
+
+#endif // end of STREAM_HASHER_HPP
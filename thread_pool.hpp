@@ -0,0 +1,129 @@
+/**
+ * @brief 並列計算のための固定数のスレッドプール
+ * @note  parallel_for()の呼び出し元のスレッドも計算に参加する
+ */
+
+#ifndef THREAD_POOL_HPP
+#define THREAD_POOL_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class ThreadPool {
+public:
+  /**
+   * @brief  スレッドを起動する
+   * @param  std::size_t threads 呼び出し元を含めたスレッド数
+   *         0ならstd::thread::hardware_concurrency()に従う
+   */
+  explicit ThreadPool(std::size_t threads = 0) {
+    if (threads == 0) {
+      threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    for (std::size_t i = 1; i < threads; i++) {
+      workers.emplace_back([this] { worker(); });
+    }
+  }
+
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool &operator=(const ThreadPool &) = delete;
+
+  ~ThreadPool() {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      stop = true;
+    }
+    wake.notify_all();
+    for (auto &&t : workers) {
+      t.join();
+    }
+  }
+
+  /**
+   * @brief  呼び出し元を含めたスレッド数を返す
+   */
+  std::size_t size() const { return workers.size() + 1; }
+
+  /**
+   * @brief  f(0), f(1), ..., f(n - 1)を並列に呼び出し、全て終わるまで待つ
+   * @note   添字は空いたスレッドから順に1つずつ割り当てる
+   *         fは例外を送出してはならない
+   */
+  template <class F> void parallel_for(std::size_t n, F &&f) {
+    if (workers.empty() || n <= 1) {
+      for (std::size_t i = 0; i < n; i++) {
+        f(i);
+      }
+      return;
+    }
+
+    const std::function<void(std::size_t)> fn = [&f](std::size_t i) { f(i); };
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      task = &fn;
+      count = n;
+      next = 0;
+      generation++;
+    }
+    wake.notify_all();
+    run(fn, n);
+
+    // 起床が間に合わなかったスレッドが、終わった仕事を参照しないようにする
+    std::unique_lock<std::mutex> lock(mutex);
+    done.wait(lock, [this] { return running == 0; });
+    task = nullptr;
+  }
+
+private:
+  void worker() {
+    std::uint64_t seen = 0;
+    std::unique_lock<std::mutex> lock(mutex);
+    for (;;) {
+      wake.wait(lock, [&] { return stop || generation != seen; });
+      if (stop) {
+        return;
+      }
+      seen = generation;
+      if (task == nullptr) {
+        continue;
+      }
+      const auto *fn = task;
+      const std::size_t n = count;
+      running++;
+      lock.unlock();
+      run(*fn, n);
+      lock.lock();
+      if (--running == 0) {
+        done.notify_all();
+      }
+    }
+  }
+
+  void run(const std::function<void(std::size_t)> &fn, std::size_t n) {
+    for (std::size_t i = next++; i < n; i = next++) {
+      fn(i);
+    }
+  }
+
+  std::vector<std::thread> workers;
+  std::mutex mutex;
+  std::condition_variable wake;
+  std::condition_variable done;
+
+  /**< @brief 実行中の仕事(なければnullptr) */
+  const std::function<void(std::size_t)> *task = nullptr;
+  std::size_t count = 0;
+  std::atomic<std::size_t> next{0};
+  std::size_t running = 0;
+  std::uint64_t generation = 0;
+  bool stop = false;
+};
+
+#endif // end of THREAD_POOL_HPP
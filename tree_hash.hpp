@@ -0,0 +1,208 @@
+/**
+ * @brief 1つの巨大な入力を葉に分割し、並列にハッシュ化するMerkle木モード
+ * @note  通常のSHA256, SHA512とは異なる値になる(互換性はない)
+ *        生成側と検証側の双方でこのモードを使う用途に限る
+ *
+ * 出力形式(H = SHA256またはSHA512, ||は連結, be64は64-bitビッグエンディアン)
+ *   葉     : L(D)    = H(0x00 || D)
+ *            入力をleaf_size byteずつの葉D0, D1, ...に分割する
+ *            最後の葉は短くてもよく、空の入力は空の葉1つとみなす
+ *   内部節 : N(x, y) = H(0x01 || x || y)
+ *            隣り合う2つを左から順にまとめ、余った1つはそのまま上の段へ送る
+ *            (RFC 6962のMerkle Tree Hashと同じ形の木になる)
+ *   根     : T       = H(0x02 || be64(leaf_size) || be64(入力のbyte数) || R)
+ *            Rは木の根で、葉の大きさと入力長を束縛する
+ */
+
+#ifndef TREE_HASH_HPP
+#define TREE_HASH_HPP
+
+#include "bit.hpp"
+#include "mapped_file.hpp"
+#include "thread_pool.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * @tparam Hasher SHA256, SHA512などのハッシュクラス
+ *         digest_type, update(), finalize()を持つこと
+ */
+template <class Hasher> class TreeHash {
+public:
+  using digest_type = typename Hasher::digest_type;
+
+  /**< @brief 既定の葉の大きさ(byte) */
+  static constexpr std::size_t default_leaf_size = std::size_t(1) << 20;
+
+  /**< @brief ノードの種類を区別する先頭の1byte */
+  static constexpr std::uint8_t leaf_tag = 0x00;
+  static constexpr std::uint8_t node_tag = 0x01;
+  static constexpr std::uint8_t root_tag = 0x02;
+
+  /**
+   * @param  ThreadPool& pool       葉の計算に使うスレッドプール
+   * @param  std::size_t leaf_size 葉の大きさ(byte, 出力形式の一部)
+   */
+  explicit TreeHash(ThreadPool &pool,
+                    std::size_t leaf_size = default_leaf_size)
+      : pool(pool), leaf_size(leaf_size),
+        buffer(leaf_size * std::max<std::size_t>(pool.size(), 1)) {
+    init();
+  }
+
+  /**
+   * @brief  葉とバッファを初期状態に戻す
+   */
+  void init() {
+    leaves.clear();
+    buflen = 0;
+    msglen = 0;
+  }
+
+  /**
+   * @brief  入力の続きを取り込む
+   * @note   揃った葉はコピーせずに並列に計算する
+   *         細かく渡された入力はスレッド数分の葉が溜まるまでバッファに退避する
+   */
+  void update(const void *data, std::size_t len) {
+    const auto *p = static_cast<const std::uint8_t *>(data);
+    msglen += len;
+
+    // バッファの最後の葉に端数があれば、先に埋める
+    if (buflen % leaf_size != 0) {
+      const std::size_t n = std::min(len, leaf_size - buflen % leaf_size);
+      std::copy(p, p + n, buffer.begin() + buflen);
+      buflen += n;
+      p += n;
+      len -= n;
+    }
+
+    // 揃っている葉は入力から直接計算する
+    if (len >= leaf_size) {
+      flush();
+      const std::size_t n = len / leaf_size * leaf_size;
+      hash_leaves(p, n);
+      p += n;
+      len -= n;
+    }
+
+    // 残りはバッファに退避し、満杯になったらまとめて計算する
+    while (len > 0) {
+      const std::size_t n = std::min(len, buffer.size() - buflen);
+      std::copy(p, p + n, buffer.begin() + buflen);
+      buflen += n;
+      p += n;
+      len -= n;
+      if (buflen == buffer.size()) {
+        flush();
+      }
+    }
+  }
+
+  /**
+   * @brief  残りの葉を計算し、木の根から最終的なハッシュ値を求める
+   */
+  digest_type finalize() {
+    if (buflen > 0 || msglen == 0) {
+      hash_leaves(buffer.data(), buflen);
+      buflen = 0;
+    }
+
+    // 隣り合う2つをまとめ、根が1つになるまで繰り返す
+    std::vector<digest_type> level;
+    level.swap(leaves);
+    while (level.size() > 1) {
+      const std::size_t n = level.size() / 2;
+      for (std::size_t i = 0; i < n; i++) {
+        Hasher h;
+        h.update(&node_tag, 1);
+        h.update(level[2 * i].data(), level[2 * i].size());
+        h.update(level[2 * i + 1].data(), level[2 * i + 1].size());
+        level[i] = h.finalize();
+      }
+      if (level.size() % 2 != 0) {
+        level[n] = level.back();
+        level.resize(n + 1);
+      } else {
+        level.resize(n);
+      }
+    }
+
+    std::uint8_t params[17];
+    params[0] = root_tag;
+    store_be64(params + 1, leaf_size);
+    store_be64(params + 9, msglen);
+    Hasher h;
+    h.update(params, sizeof(params));
+    h.update(level[0].data(), level[0].size());
+    return h.finalize();
+  }
+
+  /**
+   * @brief  入力全体を木モードでハッシュ化する
+   */
+  digest_type hash(const void *data, std::size_t len) {
+    init();
+    update(data, len);
+    return finalize();
+  }
+
+private:
+  /**
+   * @brief  バッファに溜まった葉(全て揃っていること)を計算する
+   */
+  void flush() {
+    hash_leaves(buffer.data(), buflen);
+    buflen = 0;
+  }
+
+  /**
+   * @brief  len byteを葉に分割し、並列に計算して末尾に追加する
+   * @note   最後の葉だけはleaf_sizeより短くてもよい
+   *         入力がマップしたファイルで、計算中に切り詰められた場合(SIGBUS)は
+   *         全ての葉を終えてからstd::system_error(EIO)を送出する
+   */
+  void hash_leaves(const std::uint8_t *p, std::size_t len) {
+    const std::size_t n =
+        msglen == 0 ? 1 : (len + leaf_size - 1) / leaf_size;
+    const std::size_t first = leaves.size();
+    leaves.resize(first + n);
+    std::atomic<bool> truncated{false};
+    pool.parallel_for(n, [&](std::size_t i) {
+      const std::size_t off = i * leaf_size;
+      try {
+        guard_sigbus("leaf", [&] {
+          Hasher h;
+          h.update(&leaf_tag, 1);
+          h.update(p + off, std::min(leaf_size, len - off));
+          leaves[first + i] = h.finalize();
+        });
+      } catch (const std::system_error &) {
+        truncated = true;
+      }
+    });
+    if (truncated) {
+      throw std::system_error(EIO, std::generic_category(),
+                              "input truncated while mapped");
+    }
+  }
+
+  ThreadPool &pool;
+  const std::size_t leaf_size;
+
+  /**< @brief 計算済みの葉 */
+  std::vector<digest_type> leaves;
+
+  /**< @brief 細かく渡された入力を退避するバッファ(スレッド数分の葉) */
+  std::vector<std::uint8_t> buffer;
+  std::size_t buflen;
+
+  /**< @brief これまでに取り込んだ入力長(byte) */
+  std::uint64_t msglen;
+};
+
+#endif // end of TREE_HASH_HPP
@@ -0,0 +1,34 @@
+/**
+ * @brief コンパイル時のループ展開
+ * @note  圧縮関数のラウンドのように、回数が定数で添字ごとに処理が変わるループを
+ *        std::index_sequenceで展開し、添字を定数としてラウンドに渡す
+ */
+
+#ifndef UNROLL_HPP
+#define UNROLL_HPP
+
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+
+/**< @brief 展開したループの添字(decltype(t)::valueで定数として取り出す) */
+template <std::size_t I>
+using index_constant = std::integral_constant<std::size_t, I>;
+
+template <std::size_t First, class F, std::size_t... I>
+constexpr void unroll_impl(F &f, std::index_sequence<I...>) {
+  (f(index_constant<First + I>{}), ...);
+}
+
+/**
+ * @brief  f(First), f(First + 1), ..., f(Last - 1)を順に展開して呼び出す
+ * @note   添字はindex_constantとして渡すので、fの中でif constexprや
+ *         配列の定数添字に使える
+ */
+template <std::size_t First, std::size_t Last, class F>
+constexpr void unroll(F &&f) {
+  static_assert(First <= Last);
+  unroll_impl<First>(f, std::make_index_sequence<Last - First>{});
+}
+
+#endif // end of UNROLL_HPP
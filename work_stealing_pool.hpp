@@ -0,0 +1,176 @@
+/**
+ * @brief 大きさの揃わない仕事を分配するワークスティーリング方式のスレッドプール
+ * @note  各スレッドが自分の両端キューを持ち、自分の仕事は末尾から(LIFO)取り出す
+ *        自分のキューが空になったら、他のスレッドのキューの先頭から(FIFO)盗む
+ *        仕事の中から新しい仕事を投入してもよい(ディレクトリの走査など)
+ */
+
+#ifndef WORK_STEALING_POOL_HPP
+#define WORK_STEALING_POOL_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class WorkStealingPool {
+public:
+  using task_type = std::function<void()>;
+
+  /**< @brief プール外のスレッドを表すworker_index() */
+  static constexpr std::size_t npos = static_cast<std::size_t>(-1);
+
+  /**
+   * @brief  スレッドを起動する
+   * @param  std::size_t threads スレッド数
+   *         0ならstd::thread::hardware_concurrency()に従う
+   */
+  explicit WorkStealingPool(std::size_t threads = 0) {
+    if (threads == 0) {
+      threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    for (std::size_t i = 0; i < threads; i++) {
+      queues.emplace_back(new Queue);
+    }
+    for (std::size_t i = 0; i < threads; i++) {
+      workers.emplace_back([this, i] { worker(i); });
+    }
+  }
+
+  WorkStealingPool(const WorkStealingPool &) = delete;
+  WorkStealingPool &operator=(const WorkStealingPool &) = delete;
+
+  ~WorkStealingPool() {
+    wait();
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      stop = true;
+    }
+    wake.notify_all();
+    for (auto &&t : workers) {
+      t.join();
+    }
+  }
+
+  /**
+   * @brief  スレッド数を返す
+   */
+  std::size_t size() const { return workers.size(); }
+
+  /**
+   * @brief  呼び出し元がこのプールの何番目のスレッドかを返す
+   * @return プール外のスレッドであればnpos
+   */
+  std::size_t worker_index() const {
+    return current_pool == this ? current_index : npos;
+  }
+
+  /**
+   * @brief  仕事を投入する
+   * @note   プールのスレッドからは自分のキューに、外からは順番に各キューに積む
+   *         仕事は例外を送出してはならない
+   */
+  void submit(task_type task) {
+    std::size_t i = worker_index();
+    if (i == npos) {
+      i = next_queue++ % queues.size();
+    }
+    pending++;
+    queued++;
+    {
+      std::lock_guard<std::mutex> lock(queues[i]->mutex);
+      queues[i]->tasks.push_back(std::move(task));
+    }
+
+    // 待機に入りかけたスレッドが通知を取りこぼさないよう、一度ロックを通す
+    { std::lock_guard<std::mutex> lock(mutex); }
+    wake.notify_one();
+  }
+
+  /**
+   * @brief  投入された仕事(仕事から投入されたものも含む)が全て終わるまで待つ
+   * @note   プールのスレッドから呼び出してはならない
+   */
+  void wait() {
+    std::unique_lock<std::mutex> lock(mutex);
+    idle.wait(lock, [this] { return pending == 0; });
+  }
+
+private:
+  /**< @brief スレッドごとの両端キュー */
+  struct Queue {
+    std::mutex mutex;
+    std::deque<task_type> tasks;
+  };
+
+  void worker(std::size_t index) {
+    current_pool = this;
+    current_index = index;
+    for (;;) {
+      task_type task;
+      if (!pop(index, task)) {
+        std::unique_lock<std::mutex> lock(mutex);
+        wake.wait(lock, [this] { return stop || queued > 0; });
+        if (stop) {
+          return;
+        }
+        continue;
+      }
+      task();
+      task = nullptr;
+      if (--pending == 0) {
+        std::lock_guard<std::mutex> lock(mutex);
+        idle.notify_all();
+      }
+    }
+  }
+
+  /**
+   * @brief  自分のキューの末尾、なければ他のキューの先頭から仕事を取り出す
+   */
+  bool pop(std::size_t index, task_type &task) {
+    for (std::size_t k = 0; k < queues.size(); k++) {
+      Queue &q = *queues[(index + k) % queues.size()];
+      std::lock_guard<std::mutex> lock(q.mutex);
+      if (q.tasks.empty()) {
+        continue;
+      }
+      if (k == 0) {
+        task = std::move(q.tasks.back());
+        q.tasks.pop_back();
+      } else {
+        task = std::move(q.tasks.front());
+        q.tasks.pop_front();
+      }
+      queued--;
+      return true;
+    }
+    return false;
+  }
+
+  std::vector<std::unique_ptr<Queue>> queues;
+  std::vector<std::thread> workers;
+  std::mutex mutex;
+  std::condition_variable wake;
+  std::condition_variable idle;
+
+  /**< @brief 投入されてまだ終わっていない仕事の数 */
+  std::atomic<std::size_t> pending{0};
+
+  /**< @brief キューに積まれている仕事の数 */
+  std::atomic<std::size_t> queued{0};
+
+  std::atomic<std::size_t> next_queue{0};
+  bool stop = false;
+
+  inline static thread_local const WorkStealingPool *current_pool = nullptr;
+  inline static thread_local std::size_t current_index = npos;
+};
+
+#endif // end of WORK_STEALING_POOL_HPP